@@ -0,0 +1,153 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "bench.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <map>
+#include <vector>
+
+// Count heap activity by wrapping the glibc allocator. operator new
+// goes through malloc, so C++ allocations are included.
+extern "C" {
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t n, size_t size);
+    void* __libc_realloc(void* ptr, size_t size);
+    void __libc_free(void* ptr);
+}
+
+static uint64_t alloc_count = 0;
+static uint64_t alloc_bytes = 0;
+
+extern "C" void* malloc(size_t size) {
+    alloc_count++;
+    alloc_bytes += size;
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t n, size_t size) {
+    alloc_count++;
+    alloc_bytes += n * size;
+    return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+    alloc_count++;
+    alloc_bytes += size;
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void free(void* ptr) {
+    __libc_free(ptr);
+}
+
+uint64_t benchAllocCount() {
+    return alloc_count;
+}
+
+uint64_t benchAllocBytes() {
+    return alloc_bytes;
+}
+
+typedef struct {
+    std::string name;
+    double ns;
+    double allocs;
+    double bytes;
+} BenchResult;
+
+static std::vector<BenchResult> results;
+static std::map<std::string, BenchResult> baseline;
+static int regressions = 0;
+
+void benchRun(const std::string& name, BenchFunc fn) {
+    typedef std::chrono::steady_clock clock;
+    fn(); // Warm up caches and lazily grown buffers
+
+    uint64_t count0 = alloc_count;
+    uint64_t bytes0 = alloc_bytes;
+    uint64_t iterations = 0;
+    clock::time_point start = clock::now();
+    clock::duration elapsed;
+    do {
+        fn();
+        iterations++;
+        elapsed = clock::now() - start;
+    } while(iterations < BENCH_MIN_ITERATIONS || elapsed < std::chrono::milliseconds(BENCH_MIN_TIME_MS));
+
+    BenchResult r;
+    r.name = name;
+    r.ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / iterations;
+    r.allocs = (double)(alloc_count - count0) / iterations;
+    r.bytes = (double)(alloc_bytes - bytes0) / iterations;
+    results.push_back(r);
+
+    printf("%-40s %12.0f %10.2f %10.0f", name.c_str(), r.ns, r.allocs, r.bytes);
+    std::map<std::string, BenchResult>::const_iterator base = baseline.find(name);
+    if(base != baseline.end()) {
+        double change = (r.ns / base->second.ns - 1.0) * 100.0;
+        // A new allocation in every op is a regression regardless of time
+        bool regressed = change > BENCH_REGRESSION_PCT || r.allocs >= base->second.allocs + 1.0;
+        printf(" %+7.1f%%%s", change, regressed ? "  REGRESSION" : "");
+        if(regressed) {
+            regressions++;
+        }
+    }
+    printf("\n");
+}
+
+// Baseline files hold one "name ns allocs bytes" line per benchmark
+bool benchLoadBaseline(const char* path) {
+    FILE* f = fopen(path, "r");
+    if(!f) {
+        return false;
+    }
+    char name[128];
+    BenchResult r;
+    while(fscanf(f, "%127s %lf %lf %lf", name, &r.ns, &r.allocs, &r.bytes) == 4) {
+        r.name = name;
+        baseline[r.name] = r;
+    }
+    fclose(f);
+    return true;
+}
+
+bool benchSave(const char* path) {
+    FILE* f = fopen(path, "w");
+    if(!f) {
+        return false;
+    }
+    for(size_t i=0; i<results.size(); i++) {
+        fprintf(f, "%s %.1f %.2f %.1f\n", results[i].name.c_str(), results[i].ns, results[i].allocs, results[i].bytes);
+    }
+    fclose(f);
+    return true;
+}
+
+int benchRegressions() {
+    return regressions;
+}
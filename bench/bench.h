@@ -0,0 +1,54 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Benchmark harness for the native environment
+
+Each benchmark is run repeatedly for at least BENCH_MIN_TIME_MS of host
+time and reported as ns/op, heap allocations/op and bytes allocated/op.
+Results can be saved and compared against a saved baseline to catch
+regressions before flashing.
+*/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <inttypes.h>
+#include <functional>
+#include <string>
+
+#define BENCH_MIN_TIME_MS       200
+#define BENCH_MIN_ITERATIONS    10
+#define BENCH_REGRESSION_PCT    10      // Slowdown reported as a regression
+
+typedef std::function<void(void)> BenchFunc;
+
+void benchRun(const std::string& name, BenchFunc fn);
+bool benchLoadBaseline(const char* path);
+bool benchSave(const char* path);
+int benchRegressions();
+
+// Heap activity since startup, counted by the malloc hooks
+uint64_t benchAllocCount();
+uint64_t benchAllocBytes();
+
+#endif
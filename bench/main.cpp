@@ -0,0 +1,1157 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Arduino.h>
+#include <Ticker.h>
+#include "bench.h"
+#include "native_hal.h"
+#include "LoopbackClient.h"
+#include "lcd2004.h"
+#include "lyrics.h"
+#include "http_stream.h"
+#include "text_layout.h"
+#include "profiler.h"
+#include "json_fields.h"
+#include "lyric_provider.h"
+#include "event_scheduler.h"
+#include "lyric_display.h"
+#include "lyric_feed.h"
+#include "trace.h"
+#include "replay.h"
+#include "lyric_link.h"
+#include "inflate.h"
+#include <WiFiUdp.h>
+
+#include <inttypes.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// The filter path is only benchmarked when ArduinoJson is available
+// (lib_deps of the native environment)
+#if __has_include(<ArduinoJson.h>)
+#include <ArduinoJson.h>
+#define BENCH_ARDUINOJSON
+#endif
+
+// gzip responses are made with zlib, when linked (-lz in the native
+// environment)
+#if __has_include(<zlib.h>)
+#include <zlib.h>
+#define BENCH_ZLIB
+#endif
+
+#define BENCH_CORPUS_DIR        "bench/corpus"
+#define BENCH_SYNTH_LINES       200
+#define BENCH_CHUNK_SIZE        2048    // Chunk size of the stand-in lyric response
+#define BENCH_PLAYBACK_FILE     "currently_playing.json"
+
+typedef struct {
+    std::string name;
+    std::string lrc;
+    std::string response;   // Musixmatch-style HTTP response carrying the LRC
+    std::string gzip_response;
+} CorpusFile;
+
+// What updatePlayback() keeps from a currently-playing response
+typedef struct {
+    unsigned int progress;
+    unsigned int duration;
+    char track_name[128];
+    char album_name[128];
+    char artist_name[96];
+    char artists[96];
+    char track_id[24];
+    bool playing;
+} BenchPlayback;
+
+static BenchPlayback polled;
+static const JsonField playback_fields[] = {
+    { "progress_ms", JSON_FIELD_UINT, &polled.progress, 0 },
+    { "is_playing", JSON_FIELD_BOOL, &polled.playing, 0 },
+    { "item.id", JSON_FIELD_STRING, polled.track_id, sizeof(polled.track_id) },
+    { "item.name", JSON_FIELD_STRING, polled.track_name, sizeof(polled.track_name) },
+    { "item.duration_ms", JSON_FIELD_UINT, &polled.duration, 0 },
+    { "item.album.name", JSON_FIELD_STRING, polled.album_name, sizeof(polled.album_name) },
+    { "item.artists[].name", JSON_FIELD_STRING, polled.artist_name, sizeof(polled.artist_name) },
+    { "item.artists[].name", JSON_FIELD_LIST, polled.artists, sizeof(polled.artists) }
+};
+
+LCD2004 lcd(NATIVE_LCD_RS_PIN);
+Ticker displayTicker;
+
+static bool readFile(const std::string& path, std::string& out) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if(!f) {
+        return false;
+    }
+    char buf[512];
+    size_t n;
+    while((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        out.append(buf, n);
+    }
+    fclose(f);
+    return true;
+}
+
+#ifdef BENCH_ZLIB
+// Compress at zlib's default level with a 2^window_bits byte window, as a
+// server would with 15
+static std::string gzipString(const std::string& data, int window_bits) {
+    z_stream z = {};
+    deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + window_bits, 8, Z_DEFAULT_STRATEGY);
+    std::string out(deflateBound(&z, data.size()), '\0');
+    z.next_in = (Bytef*)data.data();
+    z.avail_in = data.size();
+    z.next_out = (Bytef*)&out[0];
+    z.avail_out = out.size();
+    deflate(&z, Z_FINISH);
+    out.resize(z.total_out);
+    deflateEnd(&z);
+    return out;
+}
+#endif
+
+// Wrap the LRC in a chunked response the way the macro.subtitles.get
+// endpoint returns it, gzip compressed with a window of 2^gzip_bits bytes
+// if gzip_bits is set
+static std::string makeResponse(const std::string& lrc, int gzip_bits = 0) {
+    std::string json = "{\"message\":{\"header\":{\"status_code\":200},\"body\":{\"macro_calls\":{"
+                       "\"track.subtitles.get\":{\"message\":{\"body\":{\"subtitle_list\":[{\"subtitle\":{"
+                       "\"subtitle_id\":1,\"subtitle_language\":\"en\",\"subtitle_body\":\"";
+    for(size_t i=0; i<lrc.size(); i++) {
+        char c = lrc[i];
+        if(c == '\n') {
+            json += "\\n";
+        } else if(c == '"' || c == '\\' || c == '/') {
+            json += '\\';
+            json += c;
+        } else if(c != '\r') {
+            json += c;
+        }
+    }
+    json += "\"}}]}}}}}}}";
+
+    std::string response = "HTTP/1.1 200 OK\r\n"
+                           "Content-Type: application/json\r\n"
+                           "Transfer-Encoding: chunked\r\n"
+                           "Connection: close\r\n";
+#ifdef BENCH_ZLIB
+    if(gzip_bits) {
+        json = gzipString(json, gzip_bits);
+        response += "Content-Encoding: gzip\r\n";
+    }
+#endif
+    response += "\r\n";
+    char size_line[16];
+    for(size_t pos=0; pos<json.size(); pos+=BENCH_CHUNK_SIZE) {
+        size_t len = std::min((size_t)BENCH_CHUNK_SIZE, json.size() - pos);
+        snprintf(size_line, sizeof(size_line), "%zx\r\n", len);
+        response += size_line;
+        response.append(json, pos, len);
+        response += "\r\n";
+    }
+    response += "0\r\n\r\n";
+    return response;
+}
+
+// Long lyrics with lines of every length, including some that don't fit
+// on the display
+static std::string makeSynthetic() {
+    static const char* words[] = {
+        "la", "love", "tonight", "dancing", "heart", "forever", "we", "are",
+        "never", "going", "back", "again", "oh", "yeah", "the", "unbelievable"
+    };
+    std::string lrc;
+    uint32_t seed = 12345;
+    char stamp[16];
+    for(unsigned int i=0; i<BENCH_SYNTH_LINES; i++) {
+        unsigned int ms = i * 2750;
+        snprintf(stamp, sizeof(stamp), "[%02u:%02u.%02u]", ms / 60000, ms / 1000 % 60, ms / 10 % 100);
+        lrc += stamp;
+        seed = seed * 1103515245 + 12345;
+        unsigned int nwords = (seed >> 16) % 24;
+        for(unsigned int w=0; w<nwords; w++) {
+            seed = seed * 1103515245 + 12345;
+            if(w) {
+                lrc += ' ';
+            }
+            lrc += words[(seed >> 16) % 16];
+        }
+        lrc += '\n';
+    }
+    return lrc;
+}
+
+static void loadCorpus(const char* dir, std::vector<CorpusFile>& corpus) {
+    DIR* d = opendir(dir);
+    if(d) {
+        struct dirent* ent;
+        while((ent = readdir(d)) != NULL) {
+            std::string name = ent->d_name;
+            if(name.size() < 5 || name.compare(name.size() - 4, 4, ".lrc")) {
+                continue;
+            }
+            CorpusFile file;
+            file.name = name.substr(0, name.size() - 4);
+            if(readFile(std::string(dir) + "/" + name, file.lrc)) {
+                corpus.push_back(file);
+            }
+        }
+        closedir(d);
+    } else {
+        printf("Corpus directory %s not found\n", dir);
+    }
+    std::sort(corpus.begin(), corpus.end(), [](const CorpusFile& a, const CorpusFile& b) {
+        return a.name < b.name;
+    });
+
+    CorpusFile synth;
+    synth.name = "synthetic";
+    synth.lrc = makeSynthetic();
+    corpus.push_back(synth);
+
+    for(size_t i=0; i<corpus.size(); i++) {
+        corpus[i].response = makeResponse(corpus[i].lrc);
+#ifdef BENCH_ZLIB
+        corpus[i].gzip_response = makeResponse(corpus[i].lrc, 15);
+#endif
+    }
+}
+
+// Wrap a JSON body in a kept-alive response, as api.spotify.com sends it,
+// gzip compressed with a window of 2^gzip_bits bytes if gzip_bits is set
+static std::string makeJsonResponse(const std::string& json, int gzip_bits = 0) {
+    std::string body = json;
+#ifdef BENCH_ZLIB
+    if(gzip_bits) {
+        body = gzipString(json, gzip_bits);
+    }
+#endif
+    char header[160];
+    snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\n"
+             "Content-Type: application/json; charset=utf-8\r\n"
+             "%s"
+             "Content-Length: %zu\r\n\r\n", gzip_bits ? "Content-Encoding: gzip\r\n" : "", body.size());
+    return header + body;
+}
+
+static GzipInflater inflater;
+
+// Read a response into sink, inflating the body if it is gzip, as
+// AsyncHttp does. Returns the HTTP status, or 0 if the body couldn't be
+// inflated.
+static int readResponse(HttpBodyStream& body, Print& sink) {
+    int code = body.readHeaders(1000);
+    Print* out = &sink;
+    if(body.gzipped()) {
+        inflater.begin(&sink);
+        out = &inflater;
+    }
+    int c;
+    while((c = body.read()) >= 0) {
+        out->write((uint8_t)c);
+    }
+    if(body.gzipped() && !inflater.finish()) {
+        return 0;
+    }
+    return code;
+}
+
+// Records the events run by the scheduler check
+static std::string events_run;
+static void onEvent(uint8_t type, uint16_t arg) {
+    events_run += (char)('A' + type);
+    events_run += std::to_string(arg);
+    if(type == 2) {
+        lcd.cursor(arg % LCD_COLS, arg / LCD_COLS);
+    }
+}
+
+// Collects a composed request
+class StringPrint : public Print
+{
+    public:
+        size_t write(uint8_t c) override { str += (char)c; return 1; }
+        using Print::write;
+        std::string str;
+};
+
+// Prometheus rejects a scrape with any line not ending in a bare '\n'
+static bool metricLines(const std::string& text) {
+    return !text.empty() && text.back() == '\n' && text.find('\r') == std::string::npos;
+}
+
+// Trace written to memory, as TraceLog writes it to flash
+class StringTrace : public TraceWriter
+{
+    public:
+        StringTrace() {
+            uint32_t magic = TRACE_MAGIC;
+            out.write((const uint8_t*)&magic, sizeof(magic));
+        }
+        StringPrint out;
+    protected:
+        Print* reserve(size_t) override { return &out; }
+};
+
+// Datagrams between objects in this process. Every drop_every'th packet
+// sent is lost.
+class LoopbackUdp : public UDP
+{
+    public:
+        LoopbackUdp(unsigned int drop_every) : drop_every(drop_every), sent(0), pos(0) {}
+        uint8_t begin(uint16_t) override { return 1; }
+        void stop() override {}
+        int beginPacket(IPAddress, uint16_t) override { tx.clear(); return 1; }
+        int endPacket() override {
+            if(drop_every && ++sent % drop_every == 0) {
+                return 1;
+            }
+            queue.push_back(tx);
+            return 1;
+        }
+        size_t write(uint8_t c) override { tx += (char)c; return 1; }
+        size_t write(const uint8_t* buf, size_t size) override { tx.append((const char*)buf, size); return size; }
+        int parsePacket() override {
+            if(queue.empty()) {
+                rx.clear();
+                return 0;
+            }
+            rx = queue.front();
+            queue.erase(queue.begin());
+            pos = 0;
+            return rx.size();
+        }
+        int available() override { return rx.size() - pos; }
+        int read() override { return pos < rx.size() ? (uint8_t)rx[pos++] : -1; }
+        int read(uint8_t* buf, size_t len) override {
+            len = std::min(len, rx.size() - pos);
+            memcpy(buf, rx.data() + pos, len);
+            pos += len;
+            return len;
+        }
+        int peek() override { return pos < rx.size() ? (uint8_t)rx[pos] : -1; }
+        using Print::write;
+    private:
+        unsigned int drop_every;
+        unsigned int sent;
+        std::string tx;
+        std::vector<std::string> queue;
+        std::string rx;
+        size_t pos;
+};
+
+// Multicast an LRC file on loopback as the firmware does, looping it
+static int runHub(const char* path) {
+    std::string lrc;
+    LyricTimeline lyrics;
+    if(!readFile(path, lrc) || !lyrics.load(lrc.c_str())) {
+        printf("Can't load %s\n", path);
+        return 2;
+    }
+    uint32_t length_ms = lyrics.page(lyrics.pages() - 1).time_ms + 5000;
+    WiFiUDP udp;
+    LyricHub hub(udp, lyrics);
+    hub.begin();
+    hub.track(path, "bench");
+    hub.lyricsChanged();
+    unsigned long start_ms = millis();
+    while(true) {
+        hub.poll((millis() - start_ms) % length_ms, true);
+        usleep(1000);
+    }
+}
+
+// Show what the hub multicasts on loopback, printing the display as it changes
+static int runFollower() {
+    WiFiUDP udp;
+    if(!udp.beginMulticast(IPAddress(), LINK_GROUP, LINK_PORT)) {
+        printf("Can't join the link group\n");
+        return 2;
+    }
+    LyricFollower follower(udp, lcd);
+    displayTicker.attach_ms(DISPLAY_TICK_MS, [&]() { follower.tick(); });
+    std::string shown;
+    while(true) {
+        follower.poll();
+        yield();
+        std::string rows;
+        for(uint8_t row=0; row<LCD_LINES; row++) {
+            rows += nativeLcdRow(row);
+            rows += '\n';
+        }
+        if(rows != shown) {
+            shown = rows;
+            printf("%lu ms, %u packets\n%s\n", millis(), (unsigned int)follower.packets(), rows.c_str());
+            fflush(stdout);
+        }
+        usleep(1000);
+    }
+}
+
+static bool replayString(const std::string& trace, ReplayReport& report) {
+    LoopbackClient in;
+    in.serve(trace.data(), trace.size());
+    in.connect("trace", 0);
+    return replayTrace(in, lcd, report);
+}
+
+// Line times and text, words and pages, to compare timelines (serialize()
+// also writes struct padding)
+static std::string describeLyrics(const LyricTimeline& lyrics) {
+    std::string out;
+    for(size_t i=0; i<lyrics.size(); i++) {
+        out += std::to_string(lyrics.time(i)) + " " + std::string(lyrics.text(i), lyrics.length(i)) + "\n";
+    }
+    for(size_t i=0; i<lyrics.wordCount(); i++) {
+        out += std::to_string(lyrics.word(i).time_ms) + " ";
+    }
+    return out + std::to_string(lyrics.pages());
+}
+
+// Run one provider lookup against a canned response, as LyricFetcher does
+static uint8_t lookupLyrics(LyricProvider& provider, const LyricQuery& query, const std::string& response,
+                            LyricTimeline& lyrics, std::string& request) {
+    StringPrint out;
+    provider.request(out, query);
+    request = out.str;
+    LoopbackClient client;
+    HttpBodyStream body(client);
+    client.serve(response.data(), response.size());
+    client.connect("localhost", 443);
+    body.begin();
+    return provider.finish(readResponse(body, *provider.begin(lyrics)));
+}
+
+// Feed a response body to the extractor, as AsyncHttp does with a sink
+static bool extractPlayback(LoopbackClient& client, HttpBodyStream& body, JsonFieldExtractor& extractor, const std::string& response) {
+    client.serve(response.data(), response.size(), 1460, false);
+    client.connect("localhost", 443);
+    extractor.begin();
+    return readResponse(body, extractor) == 200 && extractor.finish();
+}
+
+// Sanity check the pipeline so a broken change can't pass as a speedup
+static bool check(const std::vector<CorpusFile>& corpus, const std::string& playback_response) {
+    std::vector<std::string> playback_responses;
+    if(!playback_response.empty()) {
+        playback_responses.push_back(playback_response);
+#ifdef BENCH_ZLIB
+        // With a window the decoder has room for; api.spotify.com uses a
+        // larger one, so its responses are requested uncompressed
+        playback_responses.push_back(makeJsonResponse(playback_response.substr(playback_response.find("\r\n\r\n") + 4), 13));
+#endif
+    }
+    for(const std::string& response : playback_responses) {
+        LoopbackClient client;
+        HttpBodyStream body(client);
+        JsonFieldExtractor extractor(playback_fields);
+        memset(&polled, 0, sizeof(polled));
+        if(!extractPlayback(client, body, extractor, response) || polled.progress != 84213 ||
+           polled.duration != 269733 || !polled.playing || strcmp(polled.track_id, "32OlwWuMpZ6b0aN2RZOeMS") ||
+           strcmp(polled.track_name, "Uptown Funk (feat. Bruno Mars) \xe2\x80\x93 Caf\xc3\xa9 \xf0\x9f\x8e\xb5 Mix") ||
+           strcmp(polled.album_name, "Uptown Special") || strcmp(polled.artist_name, "Bruno Mars") ||
+           strcmp(polled.artists, "Bruno Mars, Mark Ronson, Rob\xc3\xa9rt \"Bobby\" D\xc3\xb8" "e")) {
+            printf("Unexpected playback fields (%s): %u %u %d [%s] [%s] [%s] [%s] [%s]\n",
+                   body.gzipped() ? "gzip" : "plain", polled.progress, polled.duration, polled.playing, polled.track_id, polled.track_name, polled.album_name, polled.artist_name, polled.artists);
+            return false;
+        }
+    }
+
+    // Chunked framing wins over a Content-Length sent with it
+    {
+        const char both[] = "HTTP/1.1 200 OK\r\nContent-Length: 100\r\nTransfer-Encoding: chunked\r\n\r\n"
+                            "5\r\nhello\r\n6\r\n world\r\n0\r\n\r\n";
+        LoopbackClient client;
+        HttpBodyStream body(client);
+        client.serve(both, sizeof(both) - 1);
+        client.connect("localhost", 443);
+        body.begin();
+        std::string text;
+        int code = body.readHeaders(1000);
+        int c;
+        while((c = body.read()) >= 0) {
+            text += (char)c;
+        }
+        if(code != 200 || text != "hello world" || !body.done()) {
+            printf("Chunked body with a Content-Length read as [%s] (HTTP %d)\n", text.c_str(), code);
+            return false;
+        }
+    }
+
+    StringPrint metrics;
+    profilePrintMetrics(metrics);
+    if(!metricLines(metrics.str)) {
+        printf("Profiler metrics lines don't end in a bare newline\n");
+        return false;
+    }
+
+    // Only the first queued track is read, the rest must not be looked at
+    char queued_id[8], queued_artist[16];
+    unsigned int queued_duration;
+    static const JsonField queue_fields[] = {
+        { "queue[].id", JSON_FIELD_STRING, queued_id, sizeof(queued_id) },
+        { "queue[].artists[].name", JSON_FIELD_STRING, queued_artist, sizeof(queued_artist) },
+        { "queue[].duration_ms", JSON_FIELD_UINT, &queued_duration, 0 },
+        { "queue[]", JSON_FIELD_END, NULL, 0 }
+    };
+    JsonFieldExtractor queue_extractor(queue_fields);
+    const char queue_json[] = "{\"currently_playing\":{\"id\":\"x\"},\"queue\":[{\"artists\":[{\"name\":\"A\"},{\"name\":\"B\"}],"
+                              "\"duration_ms\":1000,\"id\":\"one\"},{\"duration_ms\":2000,\"id\":\"two\"},{ not json";
+    queue_extractor.write((const uint8_t*)queue_json, sizeof(queue_json) - 1);
+    if(!queue_extractor.finish() || strcmp(queued_id, "one") || strcmp(queued_artist, "A") || queued_duration != 1000) {
+        printf("Unexpected queue fields: %d [%s] [%s] %u\n", queue_extractor.finish(), queued_id, queued_artist, queued_duration);
+        return false;
+    }
+
+    for(size_t i=0; i<corpus.size(); i++) {
+        LyricTimeline direct;
+        direct.load(corpus[i].lrc.c_str());
+        // Plain, as a server would gzip it, and gzip with a window the
+        // decoder always has room for. The gzip ones must match the plain one.
+        std::string plain_data;
+        std::vector<std::string> responses = { corpus[i].response };
+#ifdef BENCH_ZLIB
+        responses.push_back(corpus[i].gzip_response);
+        responses.push_back(makeResponse(corpus[i].lrc, 13));
+#endif
+        for(size_t r=0; r<responses.size(); r++) {
+            LyricTimeline streamed;
+            LyricExtractor extractor("subtitle_body");
+            LoopbackClient client;
+            HttpBodyStream body(client);
+            client.serve(responses[r].data(), responses[r].size());
+            client.connect("localhost", 443);
+            body.begin();
+            extractor.begin(streamed);
+            int code = readResponse(body, extractor);
+            if(r == 1 && !code && inflater.error() == INFLATE_ERROR_WINDOW) {
+                continue; // Would be fetched again uncompressed
+            }
+            bool finished = extractor.finish();
+            std::string streamed_data = describeLyrics(streamed);
+            if(!r) {
+                plain_data = streamed_data;
+            }
+            if(code != 200 || !finished || !direct.size() || streamed.size() != direct.size() ||
+               streamed_data != plain_data) {
+                printf("%s: parsed %u lines directly, %u streamed (HTTP %d, response %u, inflate error %u)\n",
+                       corpus[i].name.c_str(), (unsigned int)direct.size(), (unsigned int)streamed.size(), code,
+                       (unsigned int)r, inflater.error());
+                return false;
+            }
+        }
+    }
+
+    // Lyric providers: requests, responses, and reordering by results
+    LyricQuery query = { "32OlwWuMpZ6b0aN2RZOeMS", "Caf\xc3\xa9 & Bar", "Bruno Mars", "Uptown Special", 269733 };
+    MusixmatchProvider musixmatch("token");
+    LrclibProvider lrclib("lrclib.net");
+    LyricProviderList providers;
+    providers.add(lrclib);
+    providers.add(musixmatch);
+    LyricTimeline found;
+    std::string request;
+    if(!corpus.empty() && (lookupLyrics(musixmatch, query, corpus[0].response, found, request) != LYRICS_FOUND ||
+       !found.size() || request.find("&q_track=Caf%C3%A9%20%26%20Bar&q_artist=Bruno%20Mars&q_duration=269733 ") == std::string::npos)) {
+        printf("Musixmatch lookup failed (%u lines):\n%s\n", (unsigned int)found.size(), request.c_str());
+        return false;
+    }
+#ifdef BENCH_ZLIB
+    // Musixmatch compresses with a 32 KB window, which a large response
+    // needs: it can't be inflated, so Musixmatch is asked for identity
+    // bodies from the start
+    std::string large_lrc = makeSynthetic();
+    if(lookupLyrics(musixmatch, query, makeResponse(large_lrc, 15), found, request) == LYRICS_FOUND ||
+       inflater.error() != INFLATE_ERROR_WINDOW || musixmatch.gzip() ||
+       lookupLyrics(musixmatch, query, makeResponse(large_lrc), found, request) != LYRICS_FOUND || !found.size()) {
+        printf("Large Musixmatch response: inflate error %u, gzip %d, %u lines uncompressed\n",
+               inflater.error(), musixmatch.gzip(), (unsigned int)found.size());
+        return false;
+    }
+#endif
+    std::string synced = makeJsonResponse("{\"id\":1,\"plainLyrics\":\"Hello\\nWorld\",\"syncedLyrics\":\"[00:01.00] Hello\\n[00:02.50] World\"}");
+    if(lookupLyrics(lrclib, query, synced, found, request) != LYRICS_FOUND || found.size() != 2 ||
+       std::string(found.text(1), found.length(1)) != "World" ||
+       request.find("GET /api/get?track_name=Caf%C3%A9%20%26%20Bar&artist_name=Bruno%20Mars&album_name=Uptown%20Special&duration=270 ")) {
+        printf("LRCLIB lookup failed (%u lines):\n%s\n", (unsigned int)found.size(), request.c_str());
+        return false;
+    }
+    std::string unsynced = makeJsonResponse("{\"id\":1,\"plainLyrics\":\"Hello\",\"syncedLyrics\":null}");
+    if(lookupLyrics(lrclib, query, unsynced, found, request) != LYRICS_NOT_FOUND) {
+        printf("LRCLIB found lyrics in an unsynced response\n");
+        return false;
+    }
+    if(strcmp(providers.get(0).name(), "musixmatch")) {
+        printf("Unexpected provider order: %s first\n", providers.get(0).name());
+        return false;
+    }
+    for(int i=0; i<3; i++) {
+        providers.record(musixmatch, 200, false, 1200);
+        providers.record(lrclib, 200, true, 1500);
+    }
+    if(strcmp(providers.get(0).name(), "lrclib")) {
+        printf("Provider order unchanged after lookups: %s first\n", providers.get(0).name());
+        return false;
+    }
+    StringPrint provider_metrics;
+    providers.printMetrics(provider_metrics);
+    if(!metricLines(provider_metrics.str)) {
+        printf("Provider metrics lines don't end in a bare newline\n");
+        return false;
+    }
+
+    const char* text = "Amazing grace, how sweet the sound";
+    printWrap(lcd, text, strlen(text));
+    if(strcmp(nativeLcdRow(0), "Amazing grace, how  ") || strcmp(nativeLcdRow(1), "sweet the sound     ")) {
+        printf("Unexpected LCD contents:\n[%s]\n[%s]\n", nativeLcdRow(0), nativeLcdRow(1));
+        return false;
+    }
+
+    // Pages laid out at load time must look the same as wrapping on the
+    // fly, except that long lines continue on further pages
+    for(size_t i=0; i<corpus.size(); i++) {
+        LyricTimeline lyrics;
+        lyrics.load(corpus[i].lrc.c_str());
+        for(size_t p=0; p<lyrics.pages(); p++) {
+            const LyricPage& page = lyrics.page(p);
+            if(p && lyrics.page(p-1).line == page.line) {
+                continue;
+            }
+            std::string wrapped;
+            std::string paged;
+            printWrap(lcd, lyrics.text(page.line), lyrics.length(page.line));
+            for(uint8_t r=0; r<LCD_LINES; r++) {
+                wrapped += nativeLcdRow(r);
+            }
+            printPage(lcd, lyrics, p);
+            for(uint8_t r=0; r<LCD_LINES; r++) {
+                paged += nativeLcdRow(r);
+            }
+            if(wrapped != paged) {
+                printf("%s: page %u differs from printWrap()\n", corpus[i].name.c_str(), (unsigned int)p);
+                return false;
+            }
+        }
+    }
+
+    // Accented text: ROM characters, transliterations and custom glyphs,
+    // with glyph slots reused across frames
+    lcd.setGlyphs(GLYPH_BASE, GLYPH_COUNT, glyph_bitmaps, glyph_fallback);
+    LyricTimeline accented;
+    accented.load("[00:01.00] Canción \xe2\x80\x9c" "déjà vu\xe2\x80\x9d\n"
+                  "[00:02.00] Grüße aus Köln\n"
+                  "[00:03.00] áàâãéèêíìîóò\n");
+    static const char* const expected[] = { "Canci?n \"d?j? vu\"", "Gr\xf5\xe2" "e aus K\xefln", "????????????" };
+    for(size_t p=0; p<accented.pages(); p++) {
+        printPage(lcd, accented, p);
+        const char* row = nativeLcdRow(0);
+        const char* text = accented.row(p, 0);
+        for(uint8_t col=0; col<accented.page(p).len[0]; col++) {
+            uint8_t code = text[col];
+            bool ok;
+            if(code >= GLYPH_BASE && code < GLYPH_BASE + GLYPH_COUNT) {
+                // Either in a CGRAM slot with the right bitmap, or the fallback
+                ok = (uint8_t)row[col] < 8 ? !memcmp(nativeLcdCgram(row[col]), glyph_bitmaps[code - GLYPH_BASE], 8) :
+                     row[col] == glyph_fallback[code - GLYPH_BASE];
+            } else {
+                ok = expected[p][col] == '?' || row[col] == expected[p][col];
+            }
+            if(!ok || p >= 3) {
+                printf("Accented page %u, column %u: unexpected 0x%02X\n", (unsigned int)p, col, (uint8_t)row[col]);
+                return false;
+            }
+        }
+    }
+    lcd.setGlyphs(0, 0, NULL, NULL);
+
+    // Enhanced LRC word timings, and text that only looks like one
+    LyricTimeline words;
+    words.load("[00:01.00]<00:01.00>Amazing <00:01.80>grace, <00:02.50> how<00:03.00>\n"
+               "[00:04.00] I <3 you <00:04.5x> <00:05.00>\n");
+    static const struct { uint32_t time_ms; const char* text; } expected_words[] = {
+        { 1000, "Amazing" }, { 1800, "grace," }, { 2500, "how" }, { 3000, "" }, { 5000, "" }
+    };
+    bool words_ok = words.wordCount() == 5 && words.size() == 2 &&
+                    std::string(words.text(1), words.length(1)) == "I <3 you <00:04.5x> ";
+    for(size_t i=0; words_ok && i<words.wordCount(); i++) {
+        const LyricWord& w = words.word(i);
+        words_ok = w.time_ms == expected_words[i].time_ms && std::string(words.text(0) + w.offset - words.word(0).offset, w.len) ==
+                   expected_words[i].text;
+    }
+    uint8_t col, row;
+    if(!words_ok || words.findWord(2700) != 2 || !words.locate(0, words.word(2).offset, col, row) || col != 16 || row != 0) {
+        printf("Unexpected word timings: %u words, line 2 [%.*s]\n", (unsigned int)words.wordCount(),
+               (int)words.length(1), words.text(1));
+        return false;
+    }
+    LoopbackClient cache;
+    StringPrint stored;
+    words.serialize(stored);
+    cache.serve(stored.str.data(), stored.str.size());
+    cache.connect("localhost", 0);
+    LyricTimeline restored;
+    if(!restored.deserialize(cache) || restored.wordCount() != words.wordCount() || restored.word(1).offset != words.word(1).offset) {
+        printf("Word timings lost in the cache format\n");
+        return false;
+    }
+
+    // Events run in time order, including ones added out of order, and
+    // the cursor survives a redraw
+    EventScheduler events(onEvent);
+    uint32_t now = micros();
+    events.at(now + 3000, 0, 1);
+    events.at(now + 1000, 1, 2);
+    events.at(now + 2000, 2, 3 * LCD_COLS + 4);
+    events.at(now + 2000, 1, 3);
+    events.at(now + 50000, 2, 0);
+    events.poll();
+    delay(4);
+    events.poll();
+    events.cancel(2);
+    printPage(lcd, words, 0);
+    if(events_run != "B2C64B3A1" || events.pending() || !nativeLcdCursor(col, row) || col != 4 || row != 3) {
+        printf("Unexpected events: %s (%u pending), cursor at %u,%u\n", events_run.c_str(), (unsigned int)events.pending(), col, row);
+        return false;
+    }
+    lcd.clear();
+    if(nativeLcdCursor(col, row)) {
+        printf("Cursor still shown after clear()\n");
+        return false;
+    }
+
+    // The display only changes when tick() consumes posted commands
+    LyricDisplay display(lcd, words);
+    display.sync(0, true);
+    if(display.page() != -1 || strcmp(nativeLcdRow(0), "                    ")) {
+        printf("Display changed before tick()\n");
+        return false;
+    }
+    display.tick();
+    bool waiting = display.page() == -1 && !nativeLcdCursor(col, row);
+    delay(1900);
+    display.tick();
+    if(!waiting || display.page() != 0 || strcmp(nativeLcdRow(0), "Amazing grace,  how ") ||
+       !nativeLcdCursor(col, row) || col != 8 || row != 0) {
+        printf("Unexpected display: page %d [%s], cursor at %u,%u\n", display.page(), nativeLcdRow(0), col, row);
+        return false;
+    }
+    display.reset();
+    delay(3000);
+    display.tick();
+    if(display.page() != -1 || nativeLcdCursor(col, row) || strcmp(nativeLcdRow(0), "Amazing grace,  how ")) {
+        printf("Display kept running after reset()\n");
+        return false;
+    }
+    SpscRing<int, 4> ring;
+    int item = 0;
+    while(ring.push(item)) {
+        item++;
+    }
+    if(item != 4 || ring.overflows() != 1 || !ring.pop(item) || item != 0) {
+        printf("Unexpected ring behaviour\n");
+        return false;
+    }
+
+    // A client with a full send buffer gets the same stream once it drains,
+    // minus the lines that dropped out of the log meanwhile: here the first
+    // one, which the other client got before the log wrapped
+    LyricFeed feed(words);
+    LoopbackClient fast, slow;
+    fast.connect("localhost", 80);
+    fast.serve("", 0, 1460, false);
+    slow.connect("localhost", 80);
+    slow.serve("", 0, 1460, false);
+    feed.attach(feed.freeSlot(), fast);
+    feed.attach(feed.freeSlot(), slow);
+    feed.track("Amazing Grace", "John\nNewton");
+    feed.line(0);
+    slow.setWriteRoom(10);
+    feed.poll();
+    for(size_t i=0; i<FEED_LOG + 4; i++) {
+        feed.line(1 + i % (words.size() - 1));
+    }
+    for(int i=0; i<8; i++) {
+        slow.setWriteRoom(100);
+        feed.poll();
+    }
+    slow.setWriteRoom(-1);
+    feed.poll();
+    std::string track = "event: track\ndata: Amazing Grace\ndata: John Newton\n\n";
+    std::string first = "event: line\ndata: " + std::string(words.text(0), words.length(0)) + "\n\n";
+    std::string lagged = fast.request();
+    size_t first_pos = lagged.find(track + first);
+    if(first_pos != std::string::npos) {
+        lagged.erase(first_pos + track.size(), first.size());
+    }
+    size_t lines_sent = 0;
+    for(size_t pos = 0; (pos = fast.request().find("event: line", pos)) != std::string::npos; pos++) {
+        lines_sent++;
+    }
+    if(first_pos == std::string::npos || slow.request() != lagged ||
+       lines_sent != 1 + FEED_LOG || feed.clients() != 2) {
+        printf("Unexpected event stream (%u lines):\n%s\n---\n%s\n", (unsigned int)lines_sent, fast.request().c_str(), slow.request().c_str());
+        return false;
+    }
+    StringPrint feed_metrics;
+    feed.printMetrics(feed_metrics);
+    if(!metricLines(feed_metrics.str)) {
+        printf("Event stream metrics lines don't end in a bare newline\n");
+        return false;
+    }
+
+    // A captured session replays through the same parsers and display
+    StringTrace session;
+    session.lyrics(words);
+    TraceDisplay redraw = { 0, DISPLAY_REDRAW };
+    session.record(TRACE_DISPLAY, 0, &redraw, sizeof(redraw));
+    if(!playback_response.empty()) {
+        std::string body = playback_response.substr(playback_response.find("\r\n\r\n") + 4);
+        TraceHeaders hdr = { 200, (uint32_t)millis(), (uint32_t)millis() + 80 };
+        int16_t end = 200;
+        session.record(TRACE_REQUEST, TRACE_CHANNEL_SPOTIFY, "api.spotify.com", 15);
+        session.record(TRACE_HEADERS, TRACE_CHANNEL_SPOTIFY, &hdr, sizeof(hdr));
+        for(size_t pos=0; pos<body.size(); pos+=256) {
+            session.record(TRACE_BODY, TRACE_CHANNEL_SPOTIFY, body.data() + pos, std::min((size_t)256, body.size() - pos));
+        }
+        session.record(TRACE_END, TRACE_CHANNEL_SPOTIFY, &end, sizeof(end));
+    }
+    delay(3000);
+    TraceDisplay stop = { 0, DISPLAY_STOP };
+    session.record(TRACE_DISPLAY, 0, &stop, sizeof(stop));
+    uint32_t pages_due = 0;
+    while(pages_due < words.pages() && words.page(pages_due).time_ms <= 3000) {
+        pages_due++;
+    }
+    ReplayReport report;
+    if(!replayString(session.out.str, report) || report.replay.count != pages_due || report.device.count ||
+       report.replay.max_ms > 2 * DISPLAY_TICK_MS || report.playback_responses != !playback_response.empty()) {
+        printf("Unexpected replay: %u pages of %u, %u playback responses\n", report.replay.count, pages_due,
+               report.playback_responses);
+        printReplayReport(Serial, report);
+        return false;
+    }
+
+    // A follower rebuilds a multi-packet timeline from the hub's carousel
+    // despite losing packets, and starts over when the track changes
+    LyricTimeline synth;
+    synth.load(makeSynthetic().c_str());
+    LoopbackUdp link(3);
+    LyricHub hub(link, synth);
+    LyricFollower follower(link, lcd);
+    // Until begin(), the hub stays quiet
+    hub.track("Synthetic", "Bench");
+    hub.lyricsChanged();
+    hub.poll(60000, true);
+    follower.poll();
+    if(follower.packets()) {
+        printf("Hub sent %u packets before begin()\n", (unsigned int)follower.packets());
+        return false;
+    }
+    hub.begin();
+    hub.lyricsChanged();
+    uint32_t link_ms = 0;
+    for(; link_ms < 5000 && !follower.ready(); link_ms += 10) {
+        hub.poll(60000 + link_ms, true);
+        follower.poll();
+        follower.tick();
+        delay(10);
+    }
+    StringPrint sent_timeline, got_timeline;
+    synth.serialize(sent_timeline);
+    follower.timeline().serialize(got_timeline);
+    delay(100);
+    follower.tick();
+    int page_due = synth.findPage(60000 + link_ms + 100);
+    size_t line_due = page_due >= 0 ? synth.page(page_due).line : 0;
+    bool shown = page_due >= 0 && !strncmp(nativeLcdRow(0), synth.text(line_due), std::min((size_t)8, synth.length(line_due)));
+    hub.track("Next", "Track");
+    for(int i=0; i<10; i++) {
+        hub.poll(0, true);
+        follower.poll();
+        delay(LINK_CAROUSEL_FAST_MS);
+    }
+    follower.tick();
+    if(sent_timeline.str.size() <= LINK_FRAGMENT_MAX || got_timeline.str != sent_timeline.str || !shown ||
+       follower.ready() || strncmp(nativeLcdRow(0), "Next", 4)) {
+        printf("Unexpected follower state after %u ms, %u packets: timeline %u of %u bytes, [%s]\n", (unsigned int)link_ms,
+               (unsigned int)follower.packets(), (unsigned int)got_timeline.str.size(),
+               (unsigned int)sent_timeline.str.size(), nativeLcdRow(0));
+        return false;
+    }
+    return true;
+}
+
+static void benchPlayback(const std::string& response) {
+    LoopbackClient client;
+    HttpBodyStream body(client);
+    JsonFieldExtractor extractor(playback_fields);
+    benchRun("json/fields", [&]() {
+        extractPlayback(client, body, extractor, response);
+    });
+#ifdef BENCH_ZLIB
+    std::string gzip_response = makeJsonResponse(response.substr(response.find("\r\n\r\n") + 4), 13);
+    benchRun("json/fields-gzip", [&]() {
+        extractPlayback(client, body, extractor, gzip_response);
+    });
+#endif
+
+#ifdef BENCH_ARDUINOJSON
+    // What parsePlayback() did before the extractor
+    benchRun("json/filter", [&]() {
+        client.serve(response.data(), response.size(), 1460, false);
+        client.connect("localhost", 443);
+        body.readHeaders(1000);
+        StaticJsonDocument<192> filter;
+        filter["progress_ms"] = true;
+        filter["is_playing"] = true;
+        JsonObject filter_item = filter.createNestedObject("item");
+        filter_item["name"] = true;
+        filter_item["album"]["name"] = true;
+        filter_item["duration_ms"] = true;
+        filter_item["id"] = true;
+        filter_item["artists"][0]["name"] = true;
+        StaticJsonDocument<512> doc;
+        if(deserializeJson(doc, body, DeserializationOption::Filter(filter))) {
+            return;
+        }
+        JsonObject item = doc["item"];
+        polled.progress = doc["progress_ms"];
+        polled.playing = doc["is_playing"];
+        polled.duration = item["duration_ms"];
+        snprintf(polled.album_name, sizeof(polled.album_name), "%s", item["album"]["name"] | "");
+        snprintf(polled.artist_name, sizeof(polled.artist_name), "%s", item["artists"][0]["name"] | "");
+        snprintf(polled.track_id, sizeof(polled.track_id), "%s", item["id"] | "");
+        snprintf(polled.track_name, sizeof(polled.track_name), "%s", item["name"] | "");
+    });
+#endif
+}
+
+static void benchLrc(const CorpusFile& file) {
+    LyricTimeline lyrics;
+    benchRun("lrc/load/" + file.name, [&]() {
+        lyrics.load(file.lrc.c_str());
+    });
+
+    LyricExtractor extractor("subtitle_body");
+    LoopbackClient client;
+    HttpBodyStream body(client);
+    benchRun("lrc/http/" + file.name, [&]() {
+        client.serve(file.response.data(), file.response.size());
+        client.connect("localhost", 443);
+        body.begin();
+        extractor.begin(lyrics);
+        body.readHeaders(1000);
+        int c;
+        while((c = body.read()) >= 0) {
+            extractor.write((uint8_t)c);
+        }
+        extractor.finish();
+    });
+#ifdef BENCH_ZLIB
+    benchRun("lrc/gzip/" + file.name, [&]() {
+        client.serve(file.gzip_response.data(), file.gzip_response.size());
+        client.connect("localhost", 443);
+        body.begin();
+        extractor.begin(lyrics);
+        readResponse(body, extractor);
+        extractor.finish();
+    });
+#endif
+}
+
+static void benchDisplay(const CorpusFile& file) {
+    LyricTimeline lyrics;
+    lyrics.load(file.lrc.c_str());
+    if(!lyrics.size()) {
+        return;
+    }
+    uint32_t duration = lyrics.time(lyrics.size() - 1) + 5000;
+
+    size_t line = 0;
+    benchRun("wrap/" + file.name, [&]() {
+        printWrap(lcd, lyrics.text(line), lyrics.length(line));
+        line = (line + 1) % lyrics.size();
+    });
+
+    size_t page = 0;
+    benchRun("page/" + file.name, [&]() {
+        printPage(lcd, lyrics, page);
+        page = (page + 1) % lyrics.pages();
+    });
+
+    uint32_t seed = 1;
+    volatile int found = 0;
+    benchRun("resync/find/" + file.name, [&]() {
+        seed = seed * 1103515245 + 12345;
+        found = lyrics.findPage((seed >> 8) % duration);
+    });
+
+    // What startLyric() does after a seek
+    benchRun("resync/full/" + file.name, [&]() {
+        seed = seed * 1103515245 + 12345;
+        uint32_t progress = (seed >> 8) % duration;
+        int idx = lyrics.findPage(progress);
+        if(idx >= 0) {
+            printPage(lcd, lyrics, idx);
+        } else {
+            lcd.frameClear();
+            lcd.flush();
+        }
+        if((size_t)(idx + 1) < lyrics.pages()) {
+            displayTicker.once_ms(lyrics.page(idx + 1).time_ms - progress, []() {});
+        }
+    });
+    (void)found;
+}
+
+int main(int argc, char** argv) {
+    const char* corpus_dir = BENCH_CORPUS_DIR;
+    const char* save_path = NULL;
+    const char* replay_path = NULL;
+    const char* hub_path = NULL;
+    bool follow = false;
+    for(int i=1; i<argc; i++) {
+        if(!strcmp(argv[i], "--save") && i + 1 < argc) {
+            save_path = argv[++i];
+        } else if(!strcmp(argv[i], "--compare") && i + 1 < argc) {
+            if(!benchLoadBaseline(argv[++i])) {
+                printf("Can't read baseline %s\n", argv[i]);
+                return 2;
+            }
+        } else if(!strcmp(argv[i], "--replay") && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if(!strcmp(argv[i], "--hub") && i + 1 < argc) {
+            hub_path = argv[++i];
+        } else if(!strcmp(argv[i], "--follow")) {
+            follow = true;
+        } else if(argv[i][0] != '-') {
+            corpus_dir = argv[i];
+        } else {
+            printf("Usage: %s [corpus_dir] [--save file] [--compare file] [--replay trace] [--hub lrc | --follow]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if(hub_path) {
+        return runHub(hub_path);
+    }
+    if(follow) {
+        lcd.begin();
+        return runFollower();
+    }
+    if(replay_path) {
+        std::string trace;
+        ReplayReport report;
+        lcd.begin();
+        if(!readFile(replay_path, trace) || !replayString(trace, report)) {
+            printf("Can't replay %s\n", replay_path);
+            return 2;
+        }
+        printReplayReport(Serial, report);
+        return 0;
+    }
+
+    std::vector<CorpusFile> corpus;
+    loadCorpus(corpus_dir, corpus);
+    std::string playback_json;
+    std::string playback_response;
+    if(readFile(std::string(corpus_dir) + "/" BENCH_PLAYBACK_FILE, playback_json)) {
+        playback_response = makeJsonResponse(playback_json);
+    }
+    lcd.begin();
+    lcd.clear();
+    if(!check(corpus, playback_response)) {
+        return 1;
+    }
+
+#ifdef BENCH_ZLIB
+    // Response sizes on the wire, headers and chunk framing included
+    for(const CorpusFile& file : corpus) {
+        printf("gzip %-35s %6zu -> %6zu bytes\n", file.name.c_str(), file.response.size(), file.gzip_response.size());
+    }
+    if(!playback_response.empty()) {
+        std::string gzip_response = makeJsonResponse(playback_json, 15);
+        printf("gzip %-35s %6zu -> %6zu bytes\n", BENCH_PLAYBACK_FILE, playback_response.size(), gzip_response.size());
+    }
+    printf("\n");
+#endif
+    printf("%-40s %12s %10s %10s\n", "benchmark", "ns/op", "allocs/op", "bytes/op");
+    for(size_t i=0; i<corpus.size(); i++) {
+        benchLrc(corpus[i]);
+    }
+    for(size_t i=0; i<corpus.size(); i++) {
+        benchDisplay(corpus[i]);
+    }
+    if(!playback_response.empty()) {
+        benchPlayback(playback_response);
+    }
+    EventScheduler events([](uint8_t, uint16_t) {});
+    benchRun("sched/poll", [&]() {
+        events.after(0, 0, 0);
+        events.poll();
+    });
+    LyricTimeline no_lyrics;
+    LyricDisplay idle(lcd, no_lyrics);
+    benchRun("display/tick", [&]() {
+        idle.tick();
+    });
+    // One lyric line to a full house of event stream clients
+    LyricTimeline feed_lyrics;
+    feed_lyrics.load(corpus.empty() ? "[00:01.00]la la la" : corpus[0].lrc.c_str());
+    LyricFeed feed(feed_lyrics);
+    LoopbackClient feed_clients[FEED_CLIENTS_MAX];
+    for(LoopbackClient& client : feed_clients) {
+        client.connect("localhost", 80);
+        client.serve("", 0, 1460, false);
+        feed.attach(feed.freeSlot(), client);
+    }
+    feed.track("Track", "Artist");
+    size_t feed_line = 0;
+    benchRun("feed/line", [&]() {
+        feed.line(feed_line);
+        feed_line = (feed_line + 1) % feed_lyrics.size();
+        feed.poll();
+        for(LoopbackClient& client : feed_clients) {
+            client.connect("localhost", 80);
+        }
+    });
+    benchRun("profile/scope", []() {
+        ProfileScope scope(PROFILE_LYRIC_FRAME);
+    });
+
+    if(save_path && !benchSave(save_path)) {
+        printf("Can't write %s\n", save_path);
+        return 2;
+    }
+    if(benchRegressions()) {
+        printf("%d regression(s)\n", benchRegressions());
+        return 1;
+    }
+    return 0;
+}
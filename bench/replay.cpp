@@ -0,0 +1,254 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "replay.h"
+#include "trace.h"
+#include "json_fields.h"
+#include "lyrics.h"
+#include "lyric_display.h"
+#include "lyric_provider.h"
+#include "inflate.h"
+#include "LoopbackClient.h"
+
+#include <chrono>
+#include <string>
+
+// Fields updatePlayback() extracts
+static struct {
+    unsigned int progress;
+    unsigned int duration;
+    char track_name[128];
+    char album_name[128];
+    char artist_name[96];
+    char artists[96];
+    char track_id[24];
+    bool playing;
+} replayed;
+
+static const JsonField replay_fields[] = {
+    { "progress_ms", JSON_FIELD_UINT, &replayed.progress, 0 },
+    { "is_playing", JSON_FIELD_BOOL, &replayed.playing, 0 },
+    { "item.id", JSON_FIELD_STRING, replayed.track_id, sizeof(replayed.track_id) },
+    { "item.name", JSON_FIELD_STRING, replayed.track_name, sizeof(replayed.track_name) },
+    { "item.duration_ms", JSON_FIELD_UINT, &replayed.duration, 0 },
+    { "item.album.name", JSON_FIELD_STRING, replayed.album_name, sizeof(replayed.album_name) },
+    { "item.artists[].name", JSON_FIELD_STRING, replayed.artist_name, sizeof(replayed.artist_name) },
+    { "item.artists[].name", JSON_FIELD_LIST, replayed.artists, sizeof(replayed.artists) }
+};
+
+typedef std::chrono::steady_clock ReplayClock;
+
+static uint64_t elapsedNs(ReplayClock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(ReplayClock::now() - start).count();
+}
+
+static void addLateness(ReplayLateness& stat, const LyricTimeline& lyrics, uint32_t progress_ms, int page) {
+    if(page < 0 || (size_t)page >= lyrics.pages()) {
+        return;
+    }
+    int32_t late = progress_ms - lyrics.page(page).time_ms;
+    stat.count++;
+    stat.total_ms += late;
+    stat.max_ms = stat.count == 1 ? late : max(stat.max_ms, late);
+}
+
+// State of one traced connection
+typedef struct {
+    Print* sink;
+    LyricProvider* provider;    // NULL for the Spotify connection
+    TraceHeaders headers;
+    bool body_started;
+} ReplayResponse;
+
+bool replayTrace(Stream& trace, LCD2004& lcd, ReplayReport& report) {
+    TraceReader reader(trace);
+    if(!reader.begin()) {
+        return false;
+    }
+    report = ReplayReport();
+    LyricTimeline lyrics;
+    LyricTimeline fetched;
+    LyricDisplay display(lcd, lyrics);
+    JsonFieldExtractor extractor(replay_fields);
+    MusixmatchProvider musixmatch("");
+    LrclibProvider lrclib("lrclib.net");
+    LyricProvider* const providers[] = { &musixmatch, &lrclib };
+    ReplayResponse responses[2] = {};
+    GzipInflater inflaters[2];  // Bodies are traced as received
+    char last_track[sizeof(replayed.track_id)] = "";
+
+    TraceRecord rec;
+    uint32_t first_ms = 0;
+    unsigned long start = millis();
+    // Device millis() to replay millis()
+    auto local = [&](uint32_t ms) { return start + (ms - first_ms); };
+    // Run the display up to a recorded time, as its Ticker would
+    auto advance = [&](uint32_t ms) {
+        unsigned long target = local(ms);
+        for(;;) {
+            DisplayShown shown;
+            while(display.shown(shown)) {
+                addLateness(report.replay, lyrics, shown.progress_ms, shown.page);
+            }
+            long left = target - millis();
+            if(left <= 0) {
+                break;
+            }
+            delay(min(left, (long)DISPLAY_TICK_MS));
+            display.tick();
+        }
+    };
+
+    uint8_t buf[512];
+    while(reader.next(rec)) {
+        if(!report.records++) {
+            first_ms = rec.ms;
+        }
+        advance(rec.ms);
+        report.duration_ms = rec.ms - first_ms;
+        ReplayResponse* response = rec.channel < 2 ? &responses[rec.channel] : NULL;
+        switch(rec.type) {
+            case TRACE_REQUEST: {
+                size_t len = reader.read(buf, sizeof(buf) - 1);
+                buf[len] = '\0';
+                response->sink = NULL;
+                response->provider = NULL;
+                response->body_started = false;
+                if(rec.channel == TRACE_CHANNEL_SPOTIFY) {
+                    extractor.begin();
+                    response->sink = &extractor;
+                    break;
+                }
+                for(LyricProvider* p : providers) {
+                    if(!strcmp(p->host(), (const char*)buf)) {
+                        response->provider = p;
+                        response->sink = p->begin(fetched);
+                    }
+                }
+                break;
+            }
+            case TRACE_HEADERS:
+                reader.read(&response->headers, sizeof(response->headers));
+                break;
+            case TRACE_BODY: {
+                size_t len = reader.read(buf, sizeof(buf));
+                if(!response->sink) {
+                    break;
+                }
+                ReplayClock::time_point t = ReplayClock::now();
+                if(!response->body_started) {
+                    response->body_started = true;
+                    if(len >= 2 && buf[0] == 0x1F && buf[1] == 0x8B && inflaters[rec.channel].begin(response->sink)) {
+                        response->sink = &inflaters[rec.channel];
+                        report.gzip_responses++;
+                    }
+                }
+                response->sink->write(buf, len);
+                if(response->provider) {
+                    report.lyric_ns += elapsedNs(t);
+                    report.lyric_bytes += len;
+                } else {
+                    report.playback_ns += elapsedNs(t);
+                    report.playback_bytes += len;
+                }
+                break;
+            }
+            case TRACE_END: {
+                int16_t result = 0;
+                reader.read(&result, sizeof(result));
+                if(!response->sink && !response->provider) {
+                    break;
+                }
+                ReplayClock::time_point t = ReplayClock::now();
+                if(inflaters[rec.channel].active() && !inflaters[rec.channel].finish()) {
+                    result = 0; // Undecodable body, as if it never arrived
+                }
+                if(response->provider) {
+                    report.lyric_responses++;
+                    report.lyrics_found += response->provider->finish(result) == LYRICS_FOUND;
+                    report.lyric_ns += elapsedNs(t);
+                } else if(result == 200 && extractor.finish()) {
+                    // As parsePlayback() and onPlayback() do
+                    const TraceHeaders& hdr = response->headers;
+                    unsigned int latency = (hdr.first_byte_ms - hdr.sent_ms) / 2;
+                    report.clock.update(local(hdr.sent_ms + latency), replayed.progress, replayed.duration, replayed.playing,
+                                        !strcmp(replayed.track_id, last_track), latency);
+                    snprintf(last_track, sizeof(last_track), "%s", replayed.track_id);
+                    report.playback_responses++;
+                    report.playback_ns += elapsedNs(t);
+                }
+                response->sink = NULL;
+                response->provider = NULL;
+                break;
+            }
+            case TRACE_LYRICS: {
+                std::string data(rec.len, '\0');
+                reader.read(&data[0], data.size());
+                LoopbackClient in;
+                in.serve(data.data(), data.size());
+                in.connect("trace", 0);
+                display.tick();     // The device had handled the reset before the lyrics changed
+                lyrics.deserialize(in);
+                break;
+            }
+            case TRACE_DISPLAY: {
+                TraceDisplay cmd;
+                if(reader.read(&cmd, sizeof(cmd)) == sizeof(cmd)) {
+                    display.post(cmd.arg, cmd.progress_ms);
+                }
+                break;
+            }
+            case TRACE_PAGE: {
+                TraceDisplay shown;
+                if(reader.read(&shown, sizeof(shown)) == sizeof(shown)) {
+                    addLateness(report.device, lyrics, shown.progress_ms, shown.arg);
+                }
+                break;
+            }
+        }
+    }
+    // Let the last scheduled page fire
+    advance(rec.ms + 2 * DISPLAY_TICK_MS);
+    return report.records > 0;
+}
+
+static void printLateness(Print& out, const char* name, const ReplayLateness& stat) {
+    out.printf("  %-8s %5u pages, late by %.1f ms on average, %d ms at most\n", name, stat.count,
+               stat.count ? (double)stat.total_ms / stat.count : 0.0, stat.max_ms);
+}
+
+void printReplayReport(Print& out, const ReplayReport& report) {
+    out.printf("Replayed %u records, %.1f s\n", report.records, report.duration_ms / 1000.0);
+    out.printf("  playback %5u responses, %u bytes, %.1f us each (%.2f us/KB)\n", report.playback_responses,
+               report.playback_bytes, report.playback_responses ? report.playback_ns / 1000.0 / report.playback_responses : 0.0,
+               report.playback_bytes ? report.playback_ns * 1.024 / report.playback_bytes : 0.0);
+    out.printf("  lyrics   %5u responses (%u found), %u bytes, %.2f us/KB\n", report.lyric_responses, report.lyrics_found,
+               report.lyric_bytes, report.lyric_bytes ? report.lyric_ns * 1.024 / report.lyric_bytes : 0.0);
+    if(report.gzip_responses) {
+        out.printf("  %u bodies were gzip: bytes are as received, times include inflating\n", report.gzip_responses);
+    }
+    printLateness(out, "device", report.device);
+    printLateness(out, "replay", report.replay);
+    report.clock.printStats(out);
+}
@@ -0,0 +1,68 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Replay of a trace captured on the device (see trace.h)
+
+Runs the recorded response bodies through the same parsers as the
+firmware (playback field extractor, PlaybackClock, lyric providers) and
+the recorded display commands and lyrics through LyricDisplay, on the
+virtual clock at the recorded pace. Reports the parsing CPU cost and how
+late each page was shown, on the device and in the replay, so a session
+can be measured again after every change.
+*/
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <Arduino.h>
+#include <inttypes.h>
+
+#include "lcd2004.h"
+#include "playback_clock.h"
+
+typedef struct {
+    uint32_t count;
+    int64_t total_ms;
+    int32_t max_ms;
+} ReplayLateness;
+
+typedef struct {
+    uint32_t records;
+    uint32_t duration_ms;
+    uint32_t playback_responses;
+    uint32_t playback_bytes;
+    uint64_t playback_ns;       // Extractor and PlaybackClock time
+    uint32_t lyric_responses;
+    uint32_t lyrics_found;
+    uint32_t lyric_bytes;
+    uint64_t lyric_ns;          // Lyric provider parsing time
+    uint32_t gzip_responses;
+    ReplayLateness device;      // Pages shown on the device
+    ReplayLateness replay;      // Pages shown in the replay
+    PlaybackClock clock;        // Clock fed with the replayed playback responses
+} ReplayReport;
+
+bool replayTrace(Stream& trace, LCD2004& lcd, ReplayReport& report);
+void printReplayReport(Print& out, const ReplayReport& report);
+
+#endif
@@ -0,0 +1,156 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Cooperative HTTPS client
+
+Requests are advanced one step per poll() call (connect, send, wait for
+headers, stream the body) so that the main loop keeps running while a
+response is in flight. The body is pushed to a Print sink a few hundred
+bytes at a time as it arrives, so no response is ever waited for or read
+in one go. Connections are kept open for reuse when the server allows it.
+
+Requests are written into a fixed buffer with compose() before begin(),
+so polling doesn't allocate and fragment the heap.
+
+With setGzip(), requests with a body sink ask for a gzip body, which is
+inflated on its way to the sink. All clients share one decoder, allocated
+the first time there is memory for it and kept from then on; a request
+asks for gzip only if the decoder is free, or can be allocated while
+leaving HTTP_INFLATE_HEADROOM of the largest free block. A server whose
+responses need a larger window than the decoder keeps (see inflate.h) is
+asked for uncompressed bodies from then on; the failed request ends with
+HTTP_ERROR_DECODE and should be sent again.
+
+Note: the TLS handshake inside connect() still blocks; everything after it
+does not.
+*/
+
+#ifndef ASYNC_HTTP_H
+#define ASYNC_HTTP_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <functional>
+
+#include "http_stream.h"
+#include "fixed_string.h"
+#include "trace.h"
+#include "inflate.h"
+
+#define HTTP_CONNECT_TIMEOUT_MS     5000
+#define HTTP_RESPONSE_TIMEOUT_MS    3000
+#define HTTP_BODY_CHUNK             256     // Max body bytes handled per poll
+#define HTTP_MFLN_SIZE              4096    // Reduced TLS buffer size, if the server supports it
+#define HTTP_REQUEST_MAX            1536    // Request buffer size, including headers
+#define HTTP_IDENTITY_HOSTS         4       // Servers remembered as needing uncompressed bodies
+#define HTTP_INFLATE_HEADROOM       6144    // Largest free block left to TLS when allocating the decoder
+
+// Error codes reported instead of an HTTP status
+#define HTTP_ERROR_CONNECT          -1
+#define HTTP_ERROR_SEND             -2
+#define HTTP_ERROR_TIMEOUT          -3
+#define HTTP_ERROR_ABORTED          -4
+#define HTTP_ERROR_DECODE           -5      // Gzip body that can't be inflated
+
+class AsyncHttp
+{
+    public:
+        typedef std::function<void(int code)> DoneHandler;
+
+        AsyncHttp();
+        Print& compose();
+        bool begin(const char* host, Print* sink, DoneHandler done);
+        void poll();
+        int wait();
+        void abort();
+        void stop();
+        bool busy() const { return state != STATE_IDLE; }
+        void collectCookies(String* jar) { body.collectCookies(jar); }
+        void setSmallBuffers(bool enable) { small_buffers = enable; }
+        void setGzip(bool enable) { gzip = enable; }
+        // Never ask host for gzip. The string must stay valid.
+        void preferIdentity(const char* host);
+        bool smallBuffers() const { return mfln; }
+        bool reusedConnection() const { return reused; }
+        unsigned long sentMillis() const { return sent_ms; }
+        unsigned long firstByteMillis() const { return first_byte_ms; }
+        // TLS session and fragment length support of the current server,
+        // for resuming after a reboot
+        size_t saveSession(Print& out);
+        bool loadSession(Stream& in, const char* server);
+        // Record the responses of requests with a body sink to a trace
+        void setTrace(TraceWriter* writer, uint8_t channel) { trace = writer; trace_channel = channel; }
+        // Average body size on the wire and decoded, and time from sending
+        // the request to the end of the body, by content encoding
+        void printStats(Print& out, const __FlashStringHelper* name) const;
+    private:
+        enum {
+            STATE_IDLE,
+            STATE_CONNECT,
+            STATE_SEND,
+            STATE_HEADERS,
+            STATE_BODY
+        };
+        typedef struct {
+            uint32_t responses;
+            uint32_t wire_bytes;
+            uint32_t body_bytes;
+            uint32_t ms;
+        } EncodingStats;
+        bool start(const char* host);
+        void finish(int code);
+        bool gzipAllowed() const;
+        bool holdInflater();
+        void releaseInflater();
+        void acceptEncoding();
+        void inflateFailed(uint8_t error);
+        WiFiClientSecure client;
+        BearSSL::Session session;
+        HttpBodyStream body;
+        const char* host;
+        FixedString<HTTP_REQUEST_MAX> request;
+        Print* sink;
+        DoneHandler done;
+        static GzipInflater inflater;
+        static AsyncHttp* inflater_holder;  // Request the decoder is kept for
+        bool gzip;
+        bool inflating;         // The current body goes through the inflater
+        const char* identity_hosts[HTTP_IDENTITY_HOSTS];
+        uint8_t identity_count;
+        uint32_t wire_bytes;    // Body bytes of the current response, before inflating
+        EncodingStats stats[2]; // Uncompressed, gzip
+        TraceWriter* trace;
+        uint8_t trace_channel;
+        bool traced;            // The current request is being traced
+        uint8_t state;
+        bool reused;
+        bool small_buffers;
+        bool mfln_probed;
+        bool mfln;
+        int code;
+        unsigned long state_ms;
+        unsigned long sent_ms;
+        unsigned long first_byte_ms;
+};
+
+#endif
@@ -0,0 +1,69 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Timed event queue for display updates
+
+Events are kept in a small sorted ring, keyed by their due time in
+microseconds, and run by poll(). Polling from one periodic Ticker means a
+burst of closely spaced events (e.g. word highlights) costs a comparison
+per poll instead of re-arming a timer for each one. Events due at the
+same time run in the order they were added.
+*/
+
+#ifndef EVENT_SCHEDULER_H
+#define EVENT_SCHEDULER_H
+
+#include <Arduino.h>
+#include <inttypes.h>
+#include <functional>
+
+#define EVENT_QUEUE_SIZE        32
+
+typedef std::function<void(uint8_t type, uint16_t arg)> EventHandler;
+
+typedef struct {
+    uint32_t due_us;
+    uint8_t type;
+    uint16_t arg;
+} ScheduledEvent;
+
+class EventScheduler
+{
+    public:
+        EventScheduler(EventHandler handler);
+        bool at(uint32_t due_us, uint8_t type, uint16_t arg);
+        bool after(uint32_t delay_ms, uint8_t type, uint16_t arg) { return at(micros() + delay_ms * 1000, type, arg); }
+        void cancel(uint8_t type);
+        void clear() { head = count = 0; }
+        size_t pending() const { return count; }
+        uint8_t poll();
+    private:
+        ScheduledEvent& slot(size_t idx) { return queue[(head + idx) % EVENT_QUEUE_SIZE]; }
+        EventHandler handler;
+        ScheduledEvent queue[EVENT_QUEUE_SIZE];
+        size_t head;
+        size_t count;
+        bool running;
+};
+
+#endif
@@ -0,0 +1,78 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Fixed-capacity string builder
+
+Requests and other short-lived text are printed into a buffer of a fixed,
+compile-time size instead of being built from concatenated Strings, so
+they never touch the heap. Output past the capacity is dropped and
+flagged, so an oversized request can be rejected rather than sent
+truncated.
+*/
+
+#ifndef FIXED_STRING_H
+#define FIXED_STRING_H
+
+#include <Arduino.h>
+#include <inttypes.h>
+#include <Print.h>
+
+template<size_t N> class FixedString : public Print
+{
+    public:
+        FixedString() { clear(); }
+        void clear() { len = 0; overflow = false; buf[0] = '\0'; }
+        size_t write(uint8_t c) override {
+            if(len + 1 >= N) {
+                overflow = true;
+                return 0;
+            }
+            buf[len++] = c;
+            buf[len] = '\0';
+            return 1;
+        }
+        size_t write(const uint8_t* data, size_t size) override {
+            size_t n = 0;
+            while(n < size && write(data[n])) {
+                n++;
+            }
+            return n;
+        }
+        // Drop everything after the first len characters
+        void truncate(size_t new_len) {
+            if(new_len < len) {
+                len = new_len;
+                buf[len] = '\0';
+            }
+        }
+        const char* c_str() const { return buf; }
+        size_t length() const { return len; }
+        static constexpr size_t capacity() { return N - 1; }
+        bool overflowed() const { return overflow; }
+    private:
+        char buf[N];
+        size_t len;
+        bool overflow;
+};
+
+#endif
@@ -0,0 +1,67 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+UTF-8 to HD44780 character mapping
+
+Text is converted once, when it is loaded, into single-byte display codes:
+ASCII, characters from the A00 character ROM (e.g. a-umlaut, n-tilde, the
+degree sign), ASCII transliterations (curly quotes, dashes, capitals with
+accents), or custom glyphs GLYPH_BASE..GLYPH_BASE+GLYPH_COUNT-1. Custom
+glyphs are 5x8 bitmaps that the LCD driver loads into the controller's
+eight CGRAM slots when a frame uses them. A00 has no characters at
+0x80-0x9F, so the glyph codes can't be confused with ROM characters.
+*/
+
+#ifndef GLYPHS_H
+#define GLYPHS_H
+
+#include <Arduino.h>
+#include <inttypes.h>
+
+#define GLYPH_BASE              0x80
+#define GLYPH_COUNT             25      // At most 32, so a set of glyphs fits in a uint32_t
+#define GLYPH_UNKNOWN           '?'     // Shown for unsupported characters
+
+extern const uint8_t glyph_bitmaps[GLYPH_COUNT][8] PROGMEM;
+extern const char glyph_fallback[GLYPH_COUNT] PROGMEM;
+
+// Incremental UTF-8 decoder
+class Utf8Decoder
+{
+    public:
+        Utf8Decoder() { reset(); }
+        void reset() { need = 0; }
+        int32_t decode(uint8_t c) { return (c < 0x80 && !need) ? c : decodeMulti(c); }
+    private:
+        int32_t decodeMulti(uint8_t c);
+        uint32_t cp;
+        uint8_t need;   // Continuation bytes still expected
+};
+
+uint8_t utf8Encode(uint32_t cp, char* out);
+uint8_t glyphEncode(uint32_t cp, uint8_t* out);
+size_t glyphEncode(const char* utf8, char* out, size_t out_size);
+uint32_t glyphMask(const char* str, size_t len);
+size_t glyphPrint(Print& out, const char* str, size_t len);
+
+#endif
@@ -0,0 +1,89 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+HTTP/1.1 response reader for persistent connections
+
+Parses the status line and headers, then exposes the body as a Stream that
+ends at the message boundary (Content-Length or chunked encoding) so the
+connection can be reused for the next request. Headers can be parsed
+incrementally as data arrives, or with a blocking call.
+*/
+
+#ifndef HTTP_STREAM_H
+#define HTTP_STREAM_H
+
+#include <Arduino.h>
+#include <Client.h>
+#include <inttypes.h>
+
+#define HTTP_LINE_MAX           48
+
+class HttpBodyStream : public Stream
+{
+    public:
+        HttpBodyStream(Client& client);
+        void begin();
+        int parseHeaders();
+        int readHeaders(unsigned long timeout_ms);
+        void collectCookies(String* jar) { cookies = jar; }
+        bool keepAlive() const { return keep_alive; }
+        // The body is gzip compressed (Content-Encoding: gzip)
+        bool gzipped() const { return gzip; }
+        bool done();
+        int available() override;
+        int read() override;
+        int peek() override;
+        size_t write(uint8_t) override { return 0; }
+    private:
+        enum {
+            HEADER,
+            BODY_LENGTH,        // Content-Length delimited
+            BODY_UNTIL_CLOSE,   // No length given, read until the connection closes
+            CHUNK_SIZE,
+            CHUNK_EXT,
+            CHUNK_DATA,
+            CHUNK_DATA_END,
+            CHUNK_TRAILER,
+            BODY_DONE
+        };
+        void headerLine();
+        int frame(int c);
+        int fill();
+        Client& client;
+        String* cookies;
+        int status;
+        uint8_t state;
+        bool keep_alive;
+        bool chunked;
+        bool gzip;
+        bool has_length;
+        bool first_line;
+        bool line_empty;
+        uint8_t cookie_state;
+        uint8_t line_len;
+        char line[HTTP_LINE_MAX];
+        int peeked;
+        uint32_t remaining;
+};
+
+#endif
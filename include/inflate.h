@@ -0,0 +1,124 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Streaming gzip decoder
+
+Compressed bytes are written in as they arrive, in pieces of any size, and
+the decompressed body is written to another Print (e.g. a JSON or LRC
+extractor) as it is decoded, so neither the compressed nor the
+decompressed body is ever held in full.
+
+DEFLATE allows back-references up to 32 KB, more RAM than the ESP8266 can
+spare next to two TLS connections. Only the last INFLATE_WINDOW bytes of
+output are kept instead. The window and tables are allocated by the first
+begin() and kept until release(), so one decoder reused for every body
+doesn't fragment the heap. A response that refers further back fails with
+INFLATE_ERROR_WINDOW, and should be requested again uncompressed. Bodies
+no longer than the window (most LRCLIB responses) never hit the limit,
+since a reference can't reach back past the start of the body.
+*/
+
+#ifndef INFLATE_H
+#define INFLATE_H
+
+#include <Arduino.h>
+#include <inttypes.h>
+
+#define INFLATE_WINDOW          8192    // Must be a power of 2
+
+enum {
+    INFLATE_OK,
+    INFLATE_ERROR_HEADER,       // Not gzip, or not DEFLATE
+    INFLATE_ERROR_DATA,         // Corrupt compressed data
+    INFLATE_ERROR_WINDOW,       // Refers back further than INFLATE_WINDOW
+    INFLATE_ERROR_CHECKSUM,     // CRC or length in the trailer doesn't match
+    INFLATE_ERROR_TRUNCATED,    // Ended before the trailer
+    INFLATE_ERROR_MEMORY
+};
+
+class GzipInflater : public Print
+{
+    public:
+        GzipInflater();
+        ~GzipInflater();
+        // Allocate the window and tables, if they aren't already
+        bool reserve();
+        // Start decoding a gzip stream into out
+        bool begin(Print* out);
+        size_t write(uint8_t c) override;
+        size_t write(const uint8_t* buf, size_t len) override;
+        // After the last byte: true if a complete, intact stream was
+        // decoded
+        bool finish();
+        // Stop decoding
+        void end();
+        // Stop decoding and free the window and tables
+        void release();
+        bool active() const { return running; }
+        bool reserved() const { return mem != NULL; }
+        static size_t memorySize() { return sizeof(State); }
+        uint8_t error() const { return err; }
+        uint32_t bytesIn() const { return in_count; }
+        uint32_t bytesOut() const { return out_count; }
+        using Print::write;
+    private:
+        typedef struct {
+            uint16_t count[16];     // Codes of each length
+            uint16_t symbol[288];   // Symbols ordered by code
+        } Huffman;
+        // Allocated on first use, so an unused decoder costs little RAM
+        typedef struct {
+            Huffman lencode;
+            Huffman distcode;       // Also the code length code while reading tables
+            uint8_t lengths[320];
+            uint8_t window[INFLATE_WINDOW];
+        } State;
+        bool step();
+        bool fail(uint8_t code);
+        bool build(Huffman& h, const uint8_t* lengths, uint16_t n);
+        int decode(const Huffman& h);
+        bool nextHeaderField();
+        bool startTables();
+        void put(uint8_t c);
+        Print* out;
+        State* mem;
+        bool running;
+        uint8_t state;
+        uint8_t err;
+        uint8_t flags;              // gzip header fields still to skip
+        bool last_block;
+        uint32_t bitbuf;
+        uint8_t bitcount;
+        uint32_t in_count;
+        uint32_t out_count;
+        uint32_t crc;
+        uint16_t remaining;         // Bytes or code lengths left in the current field
+        uint16_t length;            // Match length being decoded
+        uint16_t symbol;            // Symbol waiting for its extra bits
+        uint16_t nlen;              // Literal/length codes in the dynamic table
+        uint16_t ndist;
+        uint16_t ncode;             // Code length codes
+        uint16_t nlens;             // Code lengths read so far
+};
+
+#endif
@@ -0,0 +1,126 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Streaming JSON field extractor
+
+Writes a fixed set of fields from a JSON stream straight into their
+destinations, without building a document tree. Fields are named by key
+paths such as "item.album.name", with "[]" matching every element of an
+array ("item.artists[].name"). Only the keys on the way to a wanted field
+are looked at; other members are skipped by counting brackets, however
+large they are. Several fields may share a path, e.g. to keep both the
+first and all of the artists. An end field stops the document after the
+first value at its path, so "queue[]" reads only the first element.
+*/
+
+#ifndef JSON_FIELDS_H
+#define JSON_FIELDS_H
+
+#include <Arduino.h>
+#include <inttypes.h>
+
+#define JSON_PATH_MAX           48      // Longest key path that can match
+#define JSON_DEPTH_MAX          8       // Deeper containers are skipped
+#define JSON_FIELDS_MAX         16
+
+enum {
+    JSON_FIELD_STRING,  // char[size], first match only, truncated to fit
+    JSON_FIELD_LIST,    // char[size], every match joined with ", "
+    JSON_FIELD_UINT,    // unsigned int, fractions dropped
+    JSON_FIELD_BOOL,    // bool
+    JSON_FIELD_END      // No value, done once the first match has been read
+};
+
+typedef struct {
+    const char* path;
+    uint8_t type;
+    void* value;
+    uint16_t size;      // Buffer size of string fields
+} JsonField;
+
+class JsonFieldExtractor : public Stream
+{
+    public:
+        template<size_t N> JsonFieldExtractor(const JsonField (&fields)[N]) : fields(fields), field_count(N) {
+            static_assert(N <= JSON_FIELDS_MAX, "Too many JSON fields");
+            begin();
+        }
+        void begin();
+        bool finish() const { return state == STATE_DONE; }
+        size_t write(uint8_t c) override;
+        size_t write(const uint8_t* buf, size_t len) override;
+        // Stream interface (write-only)
+        int available() override { return 0; }
+        int read() override { return -1; }
+        int peek() override { return -1; }
+    private:
+        enum {
+            STATE_VALUE,
+            STATE_ARRAY_START,
+            STATE_KEY_START,
+            STATE_KEY,
+            STATE_KEY_ESCAPE,
+            STATE_COLON,
+            STATE_NEXT,         // After a value
+            STATE_STRING,
+            STATE_ESCAPE,
+            STATE_UNICODE,
+            STATE_LITERAL,      // Number, true, false or null
+            STATE_SKIP,
+            STATE_DONE,
+            STATE_ERROR
+        };
+        bool enterValue();
+        void push(bool array);
+        void pop();
+        void skip();
+        void startString();
+        void putString(uint8_t i, const char* str, uint8_t len);
+        void putChar(char c);
+        void putCodepoint(uint32_t cp);
+        void endLiteral();
+        const JsonField* fields;
+        uint8_t field_count;
+        uint16_t match;                 // Fields the current value goes to
+        uint8_t state;
+        uint8_t depth;
+        uint8_t end_depth;              // Depth of an end field's value, if entered
+        uint8_t base[JSON_DEPTH_MAX];   // Path length of each open container
+        uint8_t arrays;                 // Bit n set if container n is an array
+        char path[JSON_PATH_MAX];
+        uint8_t path_len;
+        bool path_overflow;
+        uint16_t str_len[JSON_FIELDS_MAX];
+        uint16_t str_full;              // String fields that ran out of space
+        uint32_t number;
+        bool number_done;
+        char literal;                   // First character of a literal
+        uint16_t skip_depth;
+        bool skip_string;
+        bool skip_escape;
+        uint8_t hex_len;
+        uint16_t hex;
+        uint16_t surrogate;
+};
+
+#endif
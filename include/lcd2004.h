@@ -30,6 +30,23 @@ Note: The LCD data lines must be connected to the MCU as follows:
     LCD DB4..........GPIO12 (NodeMCU D6)
     LCD RW...........GND
     LCD EN...........GPIO16 (NodeMCU D0)
+
+A shadow copy of the display contents is kept so that frames composed with
+frameClear()/frameWrite() can be sent with flush(), which only writes the
+cells that changed.
+
+Up to 32 custom glyphs can be registered with setGlyphs() under a range of
+character codes. The controller only has 8 CGRAM slots, so flush() loads
+the glyphs a frame uses into slots on demand, evicting the least recently
+used ones. Glyphs that don't fit are shown as their fallback character.
+
+cursor() shows the underline cursor under a cell, e.g. to highlight the
+word being sung. Moving it is a single command. flush() puts it back
+after writing, and clear() hides it.
+
+In async mode (begin(true)), bytes are queued and sent from a timer1
+interrupt, one byte per tick, so the caller doesn't wait for the LCD.
+timer1 can't be used for anything else in this mode.
 */
 
 #ifndef LCD2004_H
@@ -49,17 +66,55 @@ Note: The LCD data lines must be connected to the MCU as follows:
 #define LCD_COLS                20
 #define LCD_LINES               4
 
+#define LCD_QUEUE_SIZE          128     // Must be a power of 2
+
+#define LCD_GLYPH_SLOTS         8
+#define LCD_GLYPH_MAX           32
+#define LCD_GLYPH_NONE          0xFF
+#define LCD_CURSOR_OFF          0xFF
+
 class LCD2004 : public Print
 {
     public:
         LCD2004(uint8_t rs);
-        void begin();
+        void begin(bool async = false);
         void clear();
         void cmd(uint8_t val);
         void setCursor(uint8_t col, uint8_t row);
+        void cursor(uint8_t col, uint8_t row);
+        void noCursor();
         size_t write(uint8_t val) override; // Print::write(uint8_t)
+        void frameClear();
+        void frameWrite(uint8_t col, uint8_t row, uint8_t val) { frame[row][col] = val; }
+        void flush();
+        void flush(uint32_t glyphs);
+        void wait();
+        void setGlyphs(uint8_t base, uint8_t count, const uint8_t (*bitmaps)[8], const char* fallbacks);
     private:
+        static void pumpISR();
+        void send(uint16_t val);
+        void sendNibbles(uint8_t val);
+        void enqueue(uint16_t entry);
+        void loadGlyphs(uint32_t glyphs);
+        uint8_t glyphCode(uint8_t val) const;
         uint8_t rs_pin;
+        bool async;
+        volatile bool pump_running;
+        volatile uint8_t q_head;
+        volatile uint8_t q_tail;
+        uint16_t queue[LCD_QUEUE_SIZE];         // Pending bytes for the timer ISR
+        uint8_t addr;                           // DDRAM address counter
+        uint8_t cursor_addr;                    // Underline cursor address, or LCD_CURSOR_OFF
+        uint8_t shadow[LCD_LINES][LCD_COLS];    // Current display contents
+        uint8_t frame[LCD_LINES][LCD_COLS];     // Contents for the next flush()
+        const uint8_t (*glyph_bitmaps)[8];      // PROGMEM 5x8 bitmaps
+        const char* glyph_fallbacks;            // PROGMEM
+        uint8_t glyph_base;
+        uint8_t glyph_count;
+        uint8_t glyph_slot[LCD_GLYPH_MAX];      // CGRAM slot of each glyph, or LCD_GLYPH_NONE
+        uint8_t slot_glyph[LCD_GLYPH_SLOTS];    // Glyph in each slot, or LCD_GLYPH_NONE
+        uint32_t slot_used[LCD_GLYPH_SLOTS];    // Last flush that used each slot
+        uint32_t flush_count;
 };
 
 #endif
\ No newline at end of file
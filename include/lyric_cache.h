@@ -0,0 +1,55 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+On-flash lyric cache keyed by Spotify track ID
+
+Each cached track is stored as /lyrics/<track_id> containing a small header
+(magic, last-use stamp) followed by the serialized LyricTimeline. When the
+total size exceeds the budget, the least recently used files are removed.
+*/
+
+#ifndef LYRIC_CACHE_H
+#define LYRIC_CACHE_H
+
+#include <Arduino.h>
+#include <inttypes.h>
+
+#include "lyrics.h"
+
+#define LYRIC_CACHE_DIR         "/lyrics"
+#define LYRIC_CACHE_BUDGET      (128 * 1024)
+#define LYRIC_CACHE_MAGIC       0x3352594C // "LYR3"
+
+class LyricCache
+{
+    public:
+        LyricCache();
+        void begin();
+        bool load(const char* track_id, LyricTimeline& lyrics);
+        bool store(const char* track_id, const LyricTimeline& lyrics);
+    private:
+        bool evict(size_t needed);
+        uint32_t counter;
+};
+
+#endif
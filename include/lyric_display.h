@@ -0,0 +1,124 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Timed lyric display, driven from Ticker context
+
+loop() and the network callbacks never touch the display schedule or
+the lyric position directly. They post timestamped commands (sync to a
+playback position, stop, reset) into a lock-free SPSC ring, and tick(),
+called from a periodic Ticker, is the only code that consumes them,
+runs the EventScheduler and draws lyric pages. The playback position is
+carried in each sync command, so the display side keeps its own clock
+instead of reading the playback state while it changes.
+
+The timeline must not be modified while the display is running: post
+stop() or reset() first. tick() handles pending commands before any
+queued events, so nothing is drawn from the old lyrics afterwards.
+
+Each page shown is reported back through a second ring, in the other
+direction, for loop() to echo and trace.
+*/
+
+#ifndef LYRIC_DISPLAY_H
+#define LYRIC_DISPLAY_H
+
+#include <Arduino.h>
+#include <inttypes.h>
+
+#include "lcd2004.h"
+#include "lyrics.h"
+#include "event_scheduler.h"
+#include "spsc_ring.h"
+#include "trace.h"
+
+#define LYRIC_SWEEP_MAX_MS      2000    // Longest cursor sweep across a word
+#define DISPLAY_COMMANDS        16      // Must be a power of 2
+#define DISPLAY_TICK_MS         2       // Period of the Ticker calling tick()
+#define DISPLAY_SHOWN           16      // Pages shown, not yet taken by loop(). Must be a power of 2
+
+enum {
+    DISPLAY_SYNC,       // Follow the given playback position
+    DISPLAY_REDRAW,     // Same, and redraw the page even if it is shown
+    DISPLAY_STOP,       // Paused: keep the display as it is
+    DISPLAY_RESET       // Display cleared or lyrics about to change
+};
+
+typedef struct {
+    uint32_t at_us;         // micros() when the position was sampled
+    uint32_t progress_ms;   // Playback position at that time
+    uint8_t type;
+} DisplayCommand;
+
+typedef struct {
+    uint32_t progress_ms;   // Display's playback position when it was drawn
+    int16_t page;
+} DisplayShown;
+
+class LyricDisplay
+{
+    public:
+        LyricDisplay(LCD2004& lcd, const LyricTimeline& lyrics);
+        // Producer side (loop context)
+        bool sync(uint32_t progress_ms, bool redraw);
+        bool stop();
+        bool reset();
+        bool post(uint8_t type, uint32_t progress_ms);
+        // Next page shown since the last call
+        bool shown(DisplayShown& page) { return pages_shown.pop(page); }
+        // Record posted commands
+        void setTrace(TraceWriter* writer) { trace = writer; }
+        // Consumer side (Ticker context)
+        void tick();
+        // Page on the display, -1 if none. Safe to read from either side.
+        int page() const { return page_current; }
+        uint32_t overflows() const { return commands.overflows(); }
+    private:
+        enum {
+            EVENT_PAGE,     // Show page arg
+            EVENT_WORD,     // Highlight word arg
+            EVENT_CURSOR    // Move the cursor to cell arg (row * LCD_COLS + col)
+        };
+        void showPage(int idx);
+        void resync(bool redraw);
+        uint32_t progress() const;
+        void scheduleAt(uint32_t time_ms, uint8_t type, uint16_t arg);
+        void schedulePage();
+        void scheduleWord();
+        void highlightWord();
+        void onEvent(uint8_t type, uint16_t arg);
+        LCD2004& lcd;
+        const LyricTimeline& lyrics;
+        SpscRing<DisplayCommand, DISPLAY_COMMANDS> commands;
+        SpscRing<DisplayShown, DISPLAY_SHOWN> pages_shown;
+        TraceWriter* trace;
+        EventScheduler events;
+        // Owned by the consumer side
+        uint32_t sync_us;
+        uint32_t sync_ms;
+        volatile int page_current;
+        size_t page_next;
+        int word_current;
+        size_t word_next;
+};
+
+#endif
@@ -0,0 +1,120 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Server-Sent Events feed of the track, lyric lines and playback position
+
+Browsers on the LAN open /events and receive the current track, each
+lyric line as it is shown and a periodic progress tick. Nothing is
+copied per client: lines are kept once, as indices into a shared log of
+the last FEED_LOG events, and each client only has a read position.
+Frames are rendered from the lyric timeline and track fields when they
+are sent, and a frame that doesn't fit the socket's send buffer is
+resumed later by rendering it again and skipping what was already sent.
+
+A client that falls more than FEED_LOG lines behind skips ahead, and one
+that accepts nothing for FEED_STALL_MS is dropped, so a slow browser
+costs at most one bounded write per poll() and never holds up the
+display.
+*/
+
+#ifndef LYRIC_FEED_H
+#define LYRIC_FEED_H
+
+#include <Arduino.h>
+#include <Client.h>
+#include <inttypes.h>
+
+#include "lyrics.h"
+
+#define FEED_CLIENTS_MAX        4
+#define FEED_LOG                16      // Lines kept for clients that lag behind. Must be a power of 2
+#define FEED_WRITE_MAX          512     // Bytes written to one client per poll()
+#define FEED_STALL_MS           10000   // Drop a client that accepts nothing for this long
+
+class LyricFeed
+{
+    public:
+        LyricFeed(const LyricTimeline& lyrics);
+
+        // Index of a free client slot, -1 if all are in use
+        int freeSlot() const;
+        // Send the event-stream response headers to client and start
+        // streaming to it. The client must stay valid until it is closed.
+        void attach(int slot, Client& client);
+        size_t clients() const;
+
+        // Events, from the context that owns the lyrics and track fields.
+        // The strings must stay valid until the next track().
+        void track(const char* name, const char* artists);
+        void line(size_t idx);
+        void progress(uint32_t progress_ms, bool playing);
+
+        // Write pending events to each client, as far as their send buffers allow
+        void poll();
+
+        void printStats(Print& out) const;
+        void printMetrics(Print& out) const;
+
+    private:
+        enum {
+            FRAME_NONE,
+            FRAME_TRACK,
+            FRAME_LINE,
+            FRAME_PROGRESS
+        };
+        typedef struct {
+            Client* client;
+            uint32_t cursor;        // Next log entry to send
+            uint16_t track_gen;     // Track the client was last sent
+            bool progress_due;
+            uint8_t frame;          // Frame being sent
+            uint16_t frame_gen;     // Track the frame belongs to
+            uint32_t frame_value;
+            uint16_t frame_sent;    // Bytes of the frame already written
+            unsigned long active_ms;    // Last time the client accepted data
+        } FeedClient;
+
+        bool nextFrame(FeedClient& c);
+        void render(Print& out, uint8_t frame, uint32_t value) const;
+        void close(FeedClient& c);
+
+        const LyricTimeline& lyrics;
+        const char* track_name;
+        const char* track_artists;
+        uint16_t track_gen;
+        uint32_t track_start;       // Log position of the track's first line
+        uint32_t log[FEED_LOG];     // Line indices
+        uint32_t log_head;          // Total lines logged
+        uint32_t progress_ms;
+        bool playing;
+        FeedClient slots[FEED_CLIENTS_MAX];
+
+        // Statistics
+        uint32_t bytes_sent;
+        uint32_t frames_sent;
+        uint32_t lines_skipped;     // Lines missed by clients that lagged
+        uint16_t connections;
+        uint16_t drops;             // Clients closed for stalling
+};
+
+#endif
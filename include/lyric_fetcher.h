@@ -0,0 +1,69 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Lyric lookup across providers
+
+Tries the providers of a LyricProviderList in their current order until one
+has synced lyrics. Local providers are checked immediately; network
+providers share one AsyncHttp connection and are tried one at a time,
+since the ESP8266 can't hold more TLS sessions. Each attempt's result and
+time is recorded, which reorders the list for the next track.
+*/
+
+#ifndef LYRIC_FETCHER_H
+#define LYRIC_FETCHER_H
+
+#include <Arduino.h>
+#include <functional>
+
+#include "async_http.h"
+#include "lyric_provider.h"
+
+class LyricFetcher
+{
+    public:
+        typedef std::function<void(bool found)> DoneHandler;
+
+        LyricFetcher(AsyncHttp& http, LyricProviderList& providers);
+        bool fetch(const LyricQuery& query, LyricTimeline& lyrics, DoneHandler done);
+        void abort();
+        bool busy() const { return active; }
+    private:
+        void next();
+        void complete(bool found);
+        void onResponse(int code);
+        AsyncHttp& http;
+        LyricProviderList& providers;
+        LyricProvider* order[LYRIC_PROVIDERS_MAX];  // Order at the start of the lookup
+        size_t count;
+        size_t idx;
+        LyricQuery query;       // Strings must stay valid until done
+        LyricTimeline* lyrics;
+        DoneHandler done;
+        bool active;
+        bool retried;           // Sent again after a redirect
+        bool decode_retried;    // Sent again after a body that couldn't be inflated
+        unsigned long start_ms;
+};
+
+#endif
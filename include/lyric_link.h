@@ -0,0 +1,163 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Lyric timeline broadcast for several displays in one place
+
+One node (the hub, the normal firmware) polls Spotify and fetches lyrics,
+and multicasts what its display shows to LINK_GROUP:LINK_PORT. Followers
+(env:follower) never talk to Spotify or the lyric providers: they draw
+their LCD from these packets alone, so any number of displays costs the
+same upstream requests as one.
+
+Packets start with a LinkHeader: magic, version, type, and the hub's
+session, which changes with the track or its lyrics.
+- LINK_TRACK: track name and artists, NUL terminated.
+- LINK_TIMELINE: part of the serialized LyricTimeline (as in the lyric
+  cache), at a byte offset.
+- LINK_BEACON: playback position, whether it is playing, and the size
+  of the serialized timeline (0 if there are no lyrics yet).
+
+The hub is off until begin() is called, which the firmware does only
+when built with LYRIC_HUB (env:hub), so a single display sends nothing
+and keeps no serialized copy of the lyrics.
+
+UDP can drop packets and followers can join at any time, so the track
+and timeline packets are sent round robin: quickly for the first passes
+after a change, then slowly for as long as the session lasts. Beacons
+go out once a second, and straight away when the hub resyncs.
+*/
+
+#ifndef LYRIC_LINK_H
+#define LYRIC_LINK_H
+
+#include <Arduino.h>
+#include <Udp.h>
+#include <inttypes.h>
+
+#include "lcd2004.h"
+#include "lyrics.h"
+#include "lyric_display.h"
+
+#define LINK_GROUP              IPAddress(239, 255, 42, 42)
+#define LINK_PORT               4242
+#define LINK_VERSION            1
+#define LINK_FRAGMENT_MAX       1024    // Timeline bytes per packet
+#define LINK_TIMELINE_MAX       (32 * LINK_FRAGMENT_MAX)
+#define LINK_PACKET_MAX         (LINK_FRAGMENT_MAX + 16)
+#define LINK_BEACON_MS          1000
+#define LINK_CAROUSEL_FAST_MS   20      // Packet spacing right after a change
+#define LINK_CAROUSEL_MS        500     // Packet spacing after that
+#define LINK_FAST_PASSES        2
+#define LINK_TEXT_MAX           128     // Track name or artists, including the NUL
+
+enum {
+    LINK_BEACON = 1,
+    LINK_TRACK,
+    LINK_TIMELINE
+};
+
+typedef struct {
+    uint8_t magic[2];   // "KL"
+    uint8_t version;
+    uint8_t type;
+    uint16_t session;
+} LinkHeader;
+
+class LyricHub
+{
+    public:
+        LyricHub(UDP& udp, const LyricTimeline& lyrics);
+        ~LyricHub();
+        // Start broadcasting. Until then the other calls do nothing.
+        void begin() { enabled = true; }
+        // New track, without lyrics yet. The strings must stay valid
+        // until the next call.
+        void track(const char* name, const char* artists);
+        // The lyrics of the current track changed. They are serialized
+        // once here; later changes aren't sent until the next call.
+        void lyricsChanged();
+        // Send a beacon on the next poll()
+        void beacon() { beacon_due = true; }
+        void poll(uint32_t progress_ms, bool playing);
+        void printStats(Print& out) const;
+    private:
+        void newSession();
+        void dropTimeline();
+        void sendNext();
+        bool send(uint8_t type, size_t len);
+        UDP& udp;
+        const LyricTimeline& lyrics;
+        bool enabled;
+        const char* track_name;
+        const char* track_artists;
+        uint16_t session;
+        uint8_t* timeline;          // Serialized lyrics of this session
+        uint16_t timeline_len;
+        uint16_t carousel_pos;      // Next packet: 0 is the track, then timeline fragments
+        uint8_t passes;             // Complete passes over the carousel this session
+        unsigned long carousel_ms;
+        unsigned long beacon_ms;
+        bool beacon_due;
+        uint8_t packet[LINK_PACKET_MAX];
+        uint32_t packets_sent;
+        uint32_t bytes_sent;
+};
+
+class LyricFollower
+{
+    public:
+        LyricFollower(UDP& udp, LCD2004& lcd);
+        ~LyricFollower();
+        // Handle received packets (loop context)
+        void poll();
+        // Run the display (Ticker context)
+        void tick() { display.tick(); }
+        bool ready() const { return timeline_done; }
+        const LyricTimeline& timeline() const { return lyrics; }
+        uint32_t packets() const { return packets_received; }
+    private:
+        void handle(const uint8_t* data, size_t len);
+        void newSession(uint16_t id);
+        void addFragment(const uint8_t* data, size_t len);
+        uint32_t progress() const;
+        UDP& udp;
+        LCD2004& lcd;
+        LyricTimeline lyrics;
+        LyricDisplay display;
+        bool in_session;
+        uint16_t session;
+        bool track_shown;
+        // Timeline being received
+        uint8_t* timeline_buf;
+        uint16_t timeline_len;
+        uint32_t fragments;         // Bitmap of received fragments
+        bool timeline_done;
+        // Last beacon
+        uint32_t beacon_progress;
+        unsigned long beacon_ms;
+        bool playing;
+        uint8_t packet[LINK_PACKET_MAX];
+        uint32_t packets_received;
+};
+
+#endif
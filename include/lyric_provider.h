@@ -0,0 +1,137 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Lyric sources
+
+A LyricProvider either loads lyrics directly (local files) or describes an
+HTTP request and extracts the lyrics from the response body as it streams
+in. LyricProviderList keeps per-provider success and latency statistics
+and orders the providers by the expected time to get synced lyrics, so a
+slow or unreliable source drifts to the back of the list.
+*/
+
+#ifndef LYRIC_PROVIDER_H
+#define LYRIC_PROVIDER_H
+
+#include <Arduino.h>
+#include <inttypes.h>
+
+#include "lyrics.h"
+
+#define LYRIC_PROVIDERS_MAX         4
+#define LYRIC_LATENCY_WEIGHT        4       // Latency average weight, 1/n per sample
+
+enum {
+    LYRICS_FOUND,
+    LYRICS_NOT_FOUND,
+    LYRICS_RETRY        // Send the request again (e.g. after a cookie redirect)
+};
+
+typedef struct {
+    const char* id;     // Spotify track ID
+    const char* name;
+    const char* artist;
+    const char* album;
+    unsigned int duration_ms;
+} LyricQuery;
+
+void printUrlEncoded(Print& out, const char* str);
+
+class LyricProvider
+{
+    public:
+        LyricProvider(const char* name, uint32_t expected_ms);
+        virtual ~LyricProvider() {}
+        const char* name() const { return provider_name; }
+        // Local providers load the lyrics directly
+        virtual bool load(const LyricQuery&, LyricTimeline&) { return false; }
+        // Network providers: server (NULL if local), request, body sink,
+        // and the result once the response has been read
+        virtual const char* host() const { return NULL; }
+        virtual void request(Print&, const LyricQuery&) {}
+        virtual String* cookieJar() { return NULL; }
+        virtual Print* begin(LyricTimeline&) { return NULL; }
+        virtual uint8_t finish(int) { return LYRICS_NOT_FOUND; }
+        // Responses fit the gzip decoder's window (see inflate.h)
+        virtual bool gzip() const { return true; }
+    private:
+        friend class LyricProviderList;
+        const char* provider_name;
+        uint32_t latency_ms;    // Moving average
+        uint16_t attempts;
+        uint16_t hits;
+        uint16_t errors;        // Connection errors and timeouts
+};
+
+class LyricProviderList
+{
+    public:
+        LyricProviderList();
+        bool add(LyricProvider& provider);
+        size_t size() const { return count; }
+        LyricProvider& get(size_t idx) const { return *providers[idx]; }
+        void record(LyricProvider& provider, int code, bool found, uint32_t ms);
+        void printStats(Print& out) const;
+        void printMetrics(Print& out) const;
+    private:
+        static uint32_t cost(const LyricProvider& provider);
+        void sort();
+        LyricProvider* providers[LYRIC_PROVIDERS_MAX];
+        size_t count;
+};
+
+// Musixmatch desktop API (macro.subtitles.get)
+class MusixmatchProvider : public LyricProvider
+{
+    public:
+        MusixmatchProvider(const char* token);
+        const char* host() const override { return "apic-desktop.musixmatch.com"; }
+        void request(Print& out, const LyricQuery& query) override;
+        String* cookieJar() override { return &new_cookie; }
+        Print* begin(LyricTimeline& lyrics) override;
+        uint8_t finish(int code) override;
+        // Responses are routinely larger than the window and refer back
+        // further, so they are fetched uncompressed
+        bool gzip() const override { return false; }
+    private:
+        const char* token;
+        LyricExtractor extractor;
+        String cookie;
+        String new_cookie;
+};
+
+// LRCLIB-style /api/get endpoint returning {"syncedLyrics": "..."}
+class LrclibProvider : public LyricProvider
+{
+    public:
+        LrclibProvider(const char* server);
+        const char* host() const override { return server; }
+        void request(Print& out, const LyricQuery& query) override;
+        Print* begin(LyricTimeline& lyrics) override;
+        uint8_t finish(int code) override;
+    private:
+        const char* server;
+        LyricExtractor extractor;
+};
+
+#endif
@@ -0,0 +1,165 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Time-indexed LRC lyric storage
+
+Lyric text is appended one character at a time (e.g. straight from a network
+stream) and split into {timestamp, offset, length} entries as it arrives, so
+that the line at a given playback position can be found by binary search.
+Only the line text is kept, converted from UTF-8 to display codes (see
+glyphs.h) as it arrives; the arena grows with the lyrics and is trimmed
+to size when loading finishes. Each line is then word wrapped once into
+pages of display rows, so showing a line only copies its rows. Lines too
+long for one page are split into several pages sharing the line's time.
+Expected line format:
+    [MM:SS.TT] Lyric Line\n
+Enhanced LRC word timings are also accepted, and kept as a list of word
+start times and text offsets:
+    [MM:SS.TT] <MM:SS.TT> Lyric <MM:SS.TT> Line\n
+*/
+
+#ifndef LYRICS_H
+#define LYRICS_H
+
+#include <Arduino.h>
+#include <inttypes.h>
+
+#include "glyphs.h"
+
+#define LYRIC_STAMP_MAX         16
+#define LYRIC_PAGE_COLS         20      // Display size pages are laid out for
+#define LYRIC_PAGE_ROWS         4
+#define LYRIC_LAST_LINE_MS      5000    // Time given to the last line if it is split
+
+typedef struct {
+    uint32_t time_ms;   // Start time of the line
+    uint16_t offset;    // Offset of the line text in the text arena
+    uint16_t len;       // Length of the line text
+} LyricLine;
+
+typedef struct {
+    uint32_t time_ms;   // Start time of the word
+    uint16_t offset;    // Offset of the word in the text arena
+    uint8_t len;        // Length up to the next space or word, 0 for an end marker
+} LyricWord;
+
+typedef struct {
+    uint32_t time_ms;                   // Start time of the page
+    uint16_t line;                      // Lyric line shown on the page
+    uint16_t start[LYRIC_PAGE_ROWS];    // Offset of each row in the text arena
+    uint8_t len[LYRIC_PAGE_ROWS];       // Row lengths, 0 for empty rows
+    uint32_t glyphs;                    // Custom glyphs used, see glyphMask()
+} LyricPage;
+
+bool wrapRow(const char*& pos, const char* end, uint8_t cols, const char*& row, uint8_t& len);
+
+class LyricTimeline
+{
+    public:
+        LyricTimeline();
+        ~LyricTimeline();
+        bool load(const char* str);
+        void begin();
+        bool append(char c);
+        bool finish();
+        void clear();
+        void swap(LyricTimeline& other);
+        size_t serialize(Print& out) const;
+        bool deserialize(Stream& in);
+        size_t size() const { return count; }
+        int find(uint32_t progress_ms) const;
+        uint32_t time(size_t idx) const { return lines[idx].time_ms; }
+        const char* text(size_t idx) const { return body + lines[idx].offset; }
+        size_t length(size_t idx) const { return lines[idx].len; }
+        size_t pages() const { return page_count; }
+        int findPage(uint32_t progress_ms) const;
+        const LyricPage& page(size_t idx) const { return page_list[idx]; }
+        const char* row(size_t idx, uint8_t r) const { return body + page_list[idx].start[r]; }
+        size_t wordCount() const { return word_count; }
+        const LyricWord& word(size_t idx) const { return words[idx]; }
+        int findWord(uint32_t progress_ms) const;
+        bool locate(size_t page_idx, uint16_t offset, uint8_t& col, uint8_t& row) const;
+    private:
+        bool addLine(uint32_t time_ms);
+        bool addWord(uint32_t time_ms);
+        bool endWord(bool closed);
+        void measureWords();
+        bool layout();
+        size_t layoutLine(size_t idx, LyricPage* out) const;
+        bool addText(char c);
+        char* body;
+        size_t body_len;
+        size_t body_cap;
+        LyricLine* lines;
+        size_t count;
+        size_t lines_cap;
+        LyricWord* words;
+        size_t word_count;
+        size_t words_cap;
+        size_t word_first;      // First word of the line being parsed
+        LyricPage* page_list;
+        size_t page_count;
+        Utf8Decoder utf8;
+        uint8_t state;
+        uint8_t stamp_len;
+        char stamp[LYRIC_STAMP_MAX];
+};
+
+// Scans a JSON stream for a string member and feeds its unescaped value
+// into a LyricTimeline, without building a document tree.
+class LyricExtractor : public Stream
+{
+    public:
+        LyricExtractor(const char* key);
+        void begin(LyricTimeline& timeline);
+        bool finish();
+        bool found() const { return state >= STATE_VALUE; }
+        size_t write(uint8_t c) override;
+        size_t write(const uint8_t* buf, size_t len) override;
+        // Stream interface (write-only)
+        int available() override { return 0; }
+        int read() override { return -1; }
+        int peek() override { return -1; }
+    private:
+        enum {
+            STATE_SEARCH,
+            STATE_COLON,
+            STATE_QUOTE,
+            STATE_VALUE,
+            STATE_ESCAPE,
+            STATE_UNICODE,
+            STATE_DONE,
+            STATE_ERROR
+        };
+        void reset();
+        void putCodepoint(uint32_t cp);
+        LyricTimeline* lyrics;
+        const char* key;
+        uint8_t state;
+        uint8_t match;
+        uint8_t hex_len;
+        uint16_t hex;
+        uint16_t surrogate;
+};
+
+#endif
@@ -0,0 +1,81 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Local model of the Spotify playback position
+
+Each poll result is compared with the position predicted from the previous
+one. The prediction error is used to track clock drift, to detect seeks and
+to decide how long the next poll can wait: rarely while the prediction
+holds, densely around track changes, pause/resume, seeks and track end.
+
+Samples are blended into the prediction according to how uncertain they
+are (half the request round trip), so a slow poll cannot pull a good
+estimate off by its network delay.
+*/
+
+#ifndef PLAYBACK_CLOCK_H
+#define PLAYBACK_CLOCK_H
+
+#include <Arduino.h>
+#include <inttypes.h>
+
+#define POLL_INTERVAL_MIN       1000
+#define POLL_INTERVAL_MAX       10000
+#define POLL_INTERVAL_PAUSED    2000
+#define POLL_TRACK_END_MARGIN   300     // Poll this long after the predicted track end
+#define POLL_UNSTABLE_COUNT     3       // Dense polls after a change is detected
+
+#define SYNC_ERROR_TOLERANCE    150     // Prediction error (ms) considered normal
+#define SYNC_SEEK_THRESHOLD     1500    // Prediction error (ms) considered a seek
+
+#define SYNC_HISTOGRAM_BINS     12
+
+class PlaybackClock
+{
+    public:
+        PlaybackClock();
+        void update(unsigned long sample_ms, unsigned int progress, unsigned int duration, bool playing, bool same_track, unsigned int uncertainty);
+        unsigned int progress(unsigned long now) const;
+        unsigned int errorBudget(unsigned long now) const;
+        unsigned long nextPoll() const;
+        void printStats(Print& out) const;
+        int32_t lastError() const { return last_error; }
+        const uint32_t* histogram() const { return error_hist; }
+        static int32_t binEdge(uint8_t bin);
+    private:
+        unsigned long sample_ms;
+        unsigned int sample_progress;
+        unsigned int duration;
+        bool playing;
+        bool valid;
+        uint8_t unstable;               // Remaining dense polls
+        float drift;                    // Spotify ms per local ms, minus one
+        float error_avg;                // Average absolute prediction error (ms)
+        float seek_rate;                // Average seeks per minute of playback
+        float variance;                 // Variance of the position estimate (ms^2)
+        int32_t last_error;
+        uint32_t seeks;
+        uint32_t error_hist[SYNC_HISTOGRAM_BINS];
+};
+
+#endif
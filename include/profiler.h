@@ -0,0 +1,65 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Cycle-count profiler for hot paths
+
+A ProfileScope measures the CPU cycles between its construction and
+destruction and adds them to its probe's histogram. Histogram bins are
+powers of two of the cycle count, so recording is a few instructions and
+the profiler can stay enabled in production.
+*/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <Arduino.h>
+#include <inttypes.h>
+
+#define PROFILE_BIN_SHIFT       8       // First bin holds up to 2^8 cycles (1.6 us at 160 MHz)
+#define PROFILE_BINS            22      // Last bin holds everything above 2^28 cycles
+
+enum {
+    PROFILE_TLS_CONNECT,
+    PROFILE_HTTP_HEADERS,
+    PROFILE_JSON_PARSE,
+    PROFILE_LYRIC_FRAME,    // Building the LCD frame for a lyric
+    PROFILE_LCD_FLUSH,
+    PROFILE_TICKER_LATE,    // Time a display event ran after it was due
+    PROFILE_PROBES
+};
+
+void profileRecord(uint8_t probe, uint32_t cycles);
+void profilePrintMetrics(Print& out);
+void profilePrintSummary(Print& out);
+
+class ProfileScope
+{
+    public:
+        ProfileScope(uint8_t probe) : probe(probe), start(ESP.getCycleCount()) {}
+        ~ProfileScope() { profileRecord(probe, ESP.getCycleCount() - start); }
+    private:
+        uint8_t probe;
+        uint32_t start;
+};
+
+#endif
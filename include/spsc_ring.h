@@ -0,0 +1,73 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Lock-free single-producer, single-consumer ring buffer
+
+One side only calls push() and the other only pop(), so no locks or
+interrupt masking are needed: each index is written by one side only,
+and an entry is stored before the index that publishes it moves. Used to
+pass work from loop() to Ticker context without sharing mutable state.
+*/
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <Arduino.h>
+#include <inttypes.h>
+#include <atomic>
+
+template<typename T, size_t N> class SpscRing
+{
+    static_assert(N && !(N & (N - 1)), "Ring size must be a power of 2");
+    public:
+        SpscRing() : head(0), tail(0), dropped(0) {}
+        // Producer side. Returns false if the ring is full.
+        bool push(const T& item) {
+            size_t h = head.load(std::memory_order_relaxed);
+            if(h - tail.load(std::memory_order_acquire) == N) {
+                dropped++;
+                return false;
+            }
+            items[h & (N - 1)] = item;
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+        // Consumer side. Returns false if the ring is empty.
+        bool pop(T& item) {
+            size_t t = tail.load(std::memory_order_relaxed);
+            if(t == head.load(std::memory_order_acquire)) {
+                return false;
+            }
+            item = items[t & (N - 1)];
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+        uint32_t overflows() const { return dropped; }
+    private:
+        T items[N];
+        std::atomic<size_t> head;   // Written by the producer only
+        std::atomic<size_t> tail;   // Written by the consumer only
+        uint32_t dropped;           // Producer side
+};
+
+#endif
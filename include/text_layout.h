@@ -0,0 +1,44 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Drawing word wrapped text and laid out lyric pages on the LCD
+*/
+
+#ifndef TEXT_LAYOUT_H
+#define TEXT_LAYOUT_H
+
+#include <Arduino.h>
+#include <inttypes.h>
+#include "lcd2004.h"
+#include "lyrics.h"
+#include "glyphs.h"
+
+#if LYRIC_PAGE_COLS != LCD_COLS || LYRIC_PAGE_ROWS != LCD_LINES
+#error "Lyric pages must match the LCD size"
+#endif
+
+void printWrap(LCD2004& lcd, const char* str, size_t len);
+void printPage(LCD2004& lcd, const LyricTimeline& lyrics, size_t idx);
+void frameText(LCD2004& lcd, uint8_t row, const char* utf8);
+
+#endif
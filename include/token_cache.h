@@ -0,0 +1,46 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Spotify credentials kept in RTC memory across resets
+
+The RTC user memory survives a reset or watchdog reboot (but not a power
+cycle), so after a warm boot the device can start polling with the last
+access token instead of waiting for a new one, and never needs to read
+the refresh token back from flash. The block is checksummed, since RTC
+memory holds garbage after power-on. The first 128 bytes are left to the
+OTA updater, so the access token is only kept if both tokens fit.
+*/
+
+#ifndef TOKEN_CACHE_H
+#define TOKEN_CACHE_H
+
+#include <Arduino.h>
+#include <inttypes.h>
+
+#define TOKEN_CACHE_RTC_OFFSET  32      // In 4-byte blocks, after the OTA area
+#define TOKEN_CACHE_SIZE        384     // Rest of the 512-byte user memory
+
+bool tokenCacheLoad(char* access, size_t access_size, char* refresh, size_t refresh_size);
+bool tokenCacheStore(const char* access, const char* refresh);
+
+#endif
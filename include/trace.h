@@ -0,0 +1,105 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Binary trace of network responses and display activity
+
+A trace is the magic "TRC1" followed by records: a TraceRecord header
+(local millis(), type, channel, payload length) and the payload. It holds
+the raw bodies of traced HTTP responses with their timing, the commands
+posted to the lyric display, the lyrics it was given and the pages it
+showed, which is enough to run the same session through the parsers and
+the display schedule again without a network (see bench/replay.cpp).
+Integers are stored little-endian, as both the ESP8266 and the host use.
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <Arduino.h>
+#include <inttypes.h>
+
+#include "lyrics.h"
+
+#define TRACE_MAGIC             0x31435254  // "TRC1"
+
+// Connection a response record belongs to
+#define TRACE_CHANNEL_SPOTIFY   0
+#define TRACE_CHANNEL_AUX       1
+
+enum {
+    TRACE_REQUEST = 1,  // Request sent: host name
+    TRACE_HEADERS,      // TraceHeaders
+    TRACE_BODY,         // Next part of the response body
+    TRACE_END,          // Response done: int16_t result
+    TRACE_LYRICS,       // Timeline given to the display, LyricTimeline::serialize()
+    TRACE_DISPLAY,      // TraceDisplay: command posted to the display
+    TRACE_PAGE          // TraceDisplay: page shown by the display
+};
+
+typedef struct {
+    uint32_t ms;
+    uint8_t type;
+    uint8_t channel;
+    uint16_t len;
+} TraceRecord;
+
+typedef struct {
+    int16_t code;
+    uint32_t sent_ms;
+    uint32_t first_byte_ms;
+} TraceHeaders;
+
+typedef struct {
+    uint32_t progress_ms;   // Position posted, or the display's position when the page was shown
+    int16_t arg;            // Display command type, or page shown
+} TraceDisplay;
+
+class TraceWriter
+{
+    public:
+        virtual ~TraceWriter() {}
+        bool active() { return reserve(0) != NULL; }
+        bool record(uint8_t type, uint8_t channel, const void* data, size_t len);
+        bool lyrics(const LyricTimeline& lyrics);
+    protected:
+        // Where the next record goes, with room for len more bytes. NULL
+        // when not tracing.
+        virtual Print* reserve(size_t len) = 0;
+};
+
+class TraceReader
+{
+    public:
+        TraceReader(Stream& in) : in(in), remaining(0) {}
+        bool begin();
+        // Header of the next record. Any payload not read is skipped.
+        bool next(TraceRecord& rec);
+        // Read from the payload of the current record
+        size_t read(void* buf, size_t len);
+        Stream& stream() { return in; }
+    private:
+        Stream& in;
+        size_t remaining;
+};
+
+#endif
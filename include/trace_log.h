@@ -0,0 +1,62 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Trace capture to LittleFS
+
+Records go to /trace.bin. When it reaches TRACE_FILE_MAX it becomes
+/trace.old, replacing the previous one, so a capture keeps the most recent
+TRACE_FILE_MAX to 2 * TRACE_FILE_MAX bytes however long it runs. Writes
+happen in loop(), and a record can wait on a flash erase, so capture is
+meant for debugging sessions rather than normal use.
+*/
+
+#ifndef TRACE_LOG_H
+#define TRACE_LOG_H
+
+#include <Arduino.h>
+#include <FS.h>
+
+#include "trace.h"
+
+#define TRACE_FILE              "/trace.bin"
+#define TRACE_FILE_OLD          "/trace.old"
+#define TRACE_FILE_MAX          (128 * 1024)
+
+class TraceLog : public TraceWriter
+{
+    public:
+        TraceLog() : tracing(false) {}
+        bool start();
+        void stop();
+        bool running() const { return tracing; }
+        // Write the captured trace, oldest record first, as one trace
+        void copyTo(Print& out);
+    protected:
+        Print* reserve(size_t len) override;
+    private:
+        bool open();
+        File file;
+        bool tracing;
+};
+
+#endif
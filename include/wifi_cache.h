@@ -0,0 +1,57 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+WiFi quick connect
+
+A normal connection scans every channel for the access point and then
+waits for DHCP, which takes most of the boot time. The access point's
+BSSID and channel and the address DHCP gave last time are kept in flash
+(RTC memory doesn't survive a power cycle), so the next boot can
+associate directly and configure the same address statically. If that
+doesn't connect within WIFI_QUICK_TIMEOUT_MS (new access point, password
+or channel), it falls back to a scan and DHCP.
+
+The static address is not checked: association succeeds whether or not
+the lease is still ours. If the router has since handed the address to
+another device, both will answer for it until this one is reset with the
+cache file removed. Routers normally keep giving a device the same
+address, and the cache is rewritten whenever a DHCP connection gets a
+different one, but a network with short leases or a small pool should
+not use the quick path.
+*/
+
+#ifndef WIFI_CACHE_H
+#define WIFI_CACHE_H
+
+#include <Arduino.h>
+
+#define WIFI_CACHE_FILE         "/wifi.bin"
+#define WIFI_QUICK_TIMEOUT_MS   3000
+#define WIFI_WAIT_POLL_MS       10
+
+// Start connecting, with the saved settings if there are any
+void wifiBegin(const char* ssid, const char* pass);
+// Wait until connected, then save the settings if they changed
+void wifiWait(const char* ssid, const char* pass);
+
+#endif
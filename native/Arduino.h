@@ -0,0 +1,135 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Host (Linux) stand-in for the parts of the ESP8266 Arduino core used by
+the lyric pipeline, for the native PlatformIO environment.
+
+Time is virtual: millis() and micros() follow the host clock plus all time
+spent in delay() and delayMicroseconds(), which return immediately, so
+benchmarks measure CPU cost rather than LCD timing waits. Ticker callbacks
+and the timer1 interrupt run from yield() and delay(). Writes to GPOS,
+GPOC and GP16O drive a simulated HD44780 (see native_hal.h).
+*/
+
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <algorithm>
+
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+#define PROGMEM
+
+class __FlashStringHelper;
+#define F(s)                (reinterpret_cast<const __FlashStringHelper*>(s))
+#define FPSTR(p)            (reinterpret_cast<const __FlashStringHelper*>(p))
+#define PSTR(s)             (s)
+#define pgm_read_byte(p)    (*(const uint8_t*)(p))
+#define pgm_read_word(p)    (*(const uint16_t*)(p))
+#define pgm_read_dword(p)   (*(const uint32_t*)(p))
+#define strncmp_P           strncmp
+#define strcmp_P            strcmp
+#define strstr_P            strstr
+#define strlen_P            strlen
+#define strcpy_P            strcpy
+#define memcpy_P            memcpy
+
+#define LOW                 0
+#define HIGH                1
+#define INPUT               0
+#define OUTPUT              1
+
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+using std::min;
+using std::max;
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+// GPIO output registers. Only assignment is supported.
+class NativeGpioReg
+{
+    public:
+        NativeGpioReg(void (*on_write)(uint32_t)) : on_write(on_write) {}
+        NativeGpioReg& operator=(uint32_t val) { on_write(val); return *this; }
+    private:
+        void (*on_write)(uint32_t);
+};
+extern NativeGpioReg GPOS;
+extern NativeGpioReg GPOC;
+extern NativeGpioReg GP16O;
+
+// timer1, clocked at 80 MHz like the ESP8266
+#define TIM_DIV1            0
+#define TIM_DIV16           1
+#define TIM_DIV256          3
+#define TIM_EDGE            0
+#define TIM_LEVEL           1
+#define TIM_SINGLE          0
+#define TIM_LOOP            1
+typedef void (*timercallback)(void);
+void timer1_isr_init();
+void timer1_attachInterrupt(timercallback userFunc);
+void timer1_enable(uint8_t divider, uint8_t int_type, uint8_t reload);
+void timer1_write(uint32_t ticks);
+void timer1_disable();
+
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+
+// Serial output goes to stdout, input is never available
+class HardwareSerial : public Stream
+{
+    public:
+        void begin(unsigned long baud) { (void)baud; }
+        size_t write(uint8_t c) override;
+        size_t write(const uint8_t* buf, size_t len) override;
+        int available() override { return 0; }
+        int read() override { return -1; }
+        int peek() override { return -1; }
+        using Print::write;
+};
+extern HardwareSerial Serial;
+
+// The cycle counter runs at a nominal 160 MHz off the host clock
+class EspClass
+{
+    public:
+        uint32_t getCycleCount();
+        uint8_t getCpuFreqMHz() { return 160; }
+};
+extern EspClass ESP;
+
+#endif
@@ -0,0 +1,46 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Host stand-in for the Arduino IPAddress (IPv4 only)
+*/
+
+#ifndef NATIVE_IPADDRESS_H
+#define NATIVE_IPADDRESS_H
+
+#include "Arduino.h"
+
+class IPAddress
+{
+    public:
+        IPAddress() : addr(0) {}
+        IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : addr(a | b << 8 | c << 16 | (uint32_t)d << 24) {}
+        // In network byte order, like on the ESP8266
+        IPAddress(uint32_t addr) : addr(addr) {}
+        operator uint32_t() const { return addr; }
+        uint8_t operator[](int idx) const { return addr >> (idx * 8); }
+        bool isSet() const { return addr != 0; }
+    private:
+        uint32_t addr;
+};
+
+#endif
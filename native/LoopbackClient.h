@@ -0,0 +1,106 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+In-process stand-in for a remote HTTP server
+
+Serves a canned response in fixed-size segments, one per available()
+call, to mimic TCP segments arriving from the network, and records the
+request written to it.
+*/
+
+#ifndef LOOPBACK_CLIENT_H
+#define LOOPBACK_CLIENT_H
+
+#include <Arduino.h>
+#include <Client.h>
+#include <string>
+
+class LoopbackClient : public Client
+{
+    public:
+        LoopbackClient() : response(NULL), response_len(0), pos(0), ready(0), segment(1460), open(false), close_after(true), write_room(-1) {}
+
+        // Respond to the next request with the given bytes, delivered
+        // segment_len bytes at a time. The response must stay valid.
+        void serve(const char* data, size_t len, size_t segment_len = 1460, bool close = true) {
+            response = data;
+            response_len = len;
+            pos = ready = 0;
+            segment = segment_len;
+            close_after = close;
+        }
+        const std::string& request() const { return sent; }
+        // Limit what can be written until the next call, like a TCP send
+        // buffer. -1 (the default) accepts everything.
+        void setWriteRoom(int room) { write_room = room; }
+
+        int connect(const char* host, uint16_t port) override {
+            (void)host;
+            (void)port;
+            open = true;
+            sent.clear();
+            return 1;
+        }
+        size_t write(uint8_t c) override { return write(&c, 1); }
+        size_t write(const uint8_t* buf, size_t size) override {
+            if(write_room >= 0) {
+                size = std::min(size, (size_t)write_room);
+                write_room -= size;
+            }
+            sent.append((const char*)buf, size);
+            return size;
+        }
+        int availableForWrite() override { return write_room >= 0 ? write_room : 0x7FFFFFFF; }
+        int available() override {
+            if(ready == pos && pos < response_len) {
+                ready = std::min(pos + segment, response_len);
+            }
+            return ready - pos;
+        }
+        int read() override { return available() ? (uint8_t)response[pos++] : -1; }
+        int read(uint8_t* buf, size_t size) override {
+            size_t n = std::min(size, (size_t)available());
+            memcpy(buf, response + pos, n);
+            pos += n;
+            return n;
+        }
+        int peek() override { return available() ? (uint8_t)response[pos] : -1; }
+        void flush() override {}
+        void stop() override { open = false; }
+        uint8_t connected() override { return open && (pos < response_len || !close_after); }
+        operator bool() override { return connected(); }
+        using Print::write;
+
+    private:
+        const char* response;
+        size_t response_len;
+        size_t pos;
+        size_t ready;       // End of the segment that has "arrived"
+        size_t segment;
+        bool open;
+        bool close_after;   // Server closes the connection after the response
+        int write_room;
+        std::string sent;
+};
+
+#endif
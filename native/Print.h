@@ -0,0 +1,67 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Host stand-in for the Arduino Print class
+*/
+
+#ifndef NATIVE_PRINT_H
+#define NATIVE_PRINT_H
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "WString.h"
+
+#define DEC 10
+#define HEX 16
+
+class Print
+{
+    public:
+        virtual ~Print() {}
+        virtual size_t write(uint8_t c) = 0;
+        virtual size_t write(const uint8_t* buf, size_t len) {
+            size_t n = 0;
+            while(len--) n += write(*buf++);
+            return n;
+        }
+        virtual int availableForWrite() { return 0; }
+        virtual void flush() {}
+        size_t write(const char* str) { return write((const uint8_t*)str, strlen(str)); }
+        size_t write(const char* buf, size_t len) { return write((const uint8_t*)buf, len); }
+        size_t print(const char* str) { return write(str); }
+        size_t print(const __FlashStringHelper* str) { return write(reinterpret_cast<const char*>(str)); }
+        size_t print(const String& str) { return write(str.c_str(), str.length()); }
+        size_t print(char c) { return write((uint8_t)c); }
+        size_t print(int val, int base = DEC) { return print((long)val, base); }
+        size_t print(unsigned int val, int base = DEC) { return print((unsigned long)val, base); }
+        size_t print(long val, int base = DEC) { return printf(base == HEX ? "%lx" : "%ld", val); }
+        size_t print(unsigned long val, int base = DEC) { return printf(base == HEX ? "%lx" : "%lu", val); }
+        size_t print(double val, int digits = 2) { return printf("%.*f", digits, val); }
+        size_t println() { return write("\r\n"); }
+        template<typename T> size_t println(const T& val) { size_t n = print(val); return n + println(); }
+        template<typename T> size_t println(const T& val, int arg) { size_t n = print(val, arg); return n + println(); }
+        size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+#endif
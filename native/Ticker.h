@@ -0,0 +1,58 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Host stand-in for the ESP8266 Ticker library
+
+Due callbacks are run from yield() and delay() on the virtual clock.
+*/
+
+#ifndef NATIVE_TICKER_H
+#define NATIVE_TICKER_H
+
+#include <Arduino.h>
+#include <functional>
+
+class Ticker
+{
+    public:
+        typedef std::function<void(void)> callback_function_t;
+        Ticker();
+        ~Ticker();
+        void attach(float seconds, callback_function_t callback) { arm(seconds * 1000, true, callback); }
+        void attach_ms(uint32_t ms, callback_function_t callback) { arm(ms, true, callback); }
+        void once(float seconds, callback_function_t callback) { arm(seconds * 1000, false, callback); }
+        void once_ms(uint32_t ms, callback_function_t callback) { arm(ms, false, callback); }
+        void detach();
+        bool active() const { return armed; }
+        static void poll();
+    private:
+        void arm(uint32_t ms, bool repeat, callback_function_t callback);
+        callback_function_t callback;
+        unsigned long due_ms;
+        uint32_t period_ms;
+        bool repeat;
+        bool armed;
+        Ticker* next;
+};
+
+#endif
@@ -0,0 +1,70 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Host stand-in for the Arduino String class, backed by std::string
+*/
+
+#ifndef NATIVE_WSTRING_H
+#define NATIVE_WSTRING_H
+
+#include <inttypes.h>
+#include <string>
+
+class __FlashStringHelper;
+
+class String
+{
+    public:
+        String() {}
+        String(const char* str) { if(str) s = str; }
+        String(const __FlashStringHelper* str) : String(reinterpret_cast<const char*>(str)) {}
+        explicit String(char c) : s(1, c) {}
+        explicit String(int val) : s(std::to_string(val)) {}
+        explicit String(unsigned int val) : s(std::to_string(val)) {}
+        explicit String(long val) : s(std::to_string(val)) {}
+        explicit String(unsigned long val) : s(std::to_string(val)) {}
+        unsigned int length() const { return s.length(); }
+        const char* c_str() const { return s.c_str(); }
+        bool reserve(unsigned int size) { s.reserve(size); return true; }
+        bool concat(const char* str, unsigned int len) { s.append(str, len); return true; }
+        String& operator+=(const String& rhs) { s += rhs.s; return *this; }
+        String& operator+=(const char* rhs) { s += rhs; return *this; }
+        String& operator+=(const __FlashStringHelper* rhs) { s += reinterpret_cast<const char*>(rhs); return *this; }
+        String& operator+=(char c) { s += c; return *this; }
+        String& operator+=(int val) { s += std::to_string(val); return *this; }
+        String& operator+=(unsigned int val) { s += std::to_string(val); return *this; }
+        String& operator+=(unsigned long val) { s += std::to_string(val); return *this; }
+        bool operator==(const String& rhs) const { return s == rhs.s; }
+        bool operator==(const char* rhs) const { return s == rhs; }
+        bool operator!=(const String& rhs) const { return s != rhs.s; }
+        bool operator!=(const char* rhs) const { return s != rhs; }
+        char operator[](unsigned int idx) const { return s[idx]; }
+        char& operator[](unsigned int idx) { return s[idx]; }
+        friend String operator+(const String& lhs, const String& rhs) { String r(lhs); r += rhs; return r; }
+        friend String operator+(const String& lhs, const char* rhs) { String r(lhs); r += rhs; return r; }
+        friend String operator+(const char* lhs, const String& rhs) { String r(lhs); r += rhs; return r; }
+    private:
+        std::string s;
+};
+
+#endif
@@ -0,0 +1,68 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Host stand-in for the ESP8266 WiFiUDP, on a POSIX socket
+
+Non-blocking. Multicast goes over the loopback interface, so several
+processes on one host can talk to each other, whatever interface address
+is passed to beginMulticast().
+*/
+
+#ifndef NATIVE_WIFIUDP_H
+#define NATIVE_WIFIUDP_H
+
+#include "Udp.h"
+
+#define NATIVE_UDP_MAX      1500
+
+class WiFiUDP : public UDP
+{
+    public:
+        WiFiUDP();
+        ~WiFiUDP();
+        uint8_t begin(uint16_t port) override;
+        uint8_t beginMulticast(IPAddress iface, IPAddress group, uint16_t port);
+        void stop() override;
+        int beginPacket(IPAddress ip, uint16_t port) override;
+        int endPacket() override;
+        size_t write(uint8_t c) override;
+        size_t write(const uint8_t* buf, size_t size) override;
+        int parsePacket() override;
+        int available() override { return rx_len - rx_pos; }
+        int read() override { return rx_pos < rx_len ? rx[rx_pos++] : -1; }
+        int read(uint8_t* buf, size_t len) override;
+        int peek() override { return rx_pos < rx_len ? rx[rx_pos] : -1; }
+        using Print::write;
+    private:
+        bool open();
+        int fd;
+        uint32_t tx_addr;
+        uint16_t tx_port;
+        uint8_t tx[NATIVE_UDP_MAX];
+        size_t tx_len;
+        uint8_t rx[NATIVE_UDP_MAX];
+        size_t rx_len;
+        size_t rx_pos;
+};
+
+#endif
@@ -0,0 +1,348 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Arduino.h>
+#include <Ticker.h>
+#include "native_hal.h"
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <chrono>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+// Clock
+
+static uint64_t skew_us = 0;    // Virtual time spent in delays
+static const std::chrono::steady_clock::time_point boot = std::chrono::steady_clock::now();
+
+static uint64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - boot).count() + skew_us;
+}
+
+unsigned long micros() {
+    return (unsigned long)now_us();
+}
+
+unsigned long millis() {
+    return (unsigned long)(now_us() / 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+    skew_us += us;
+}
+
+void delay(unsigned long ms) {
+    skew_us += (uint64_t)ms * 1000;
+    yield();
+}
+
+uint32_t EspClass::getCycleCount() {
+    return (uint32_t)(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - boot).count() * 4 / 25);
+}
+
+// timer1
+
+static timercallback timer1_isr = NULL;
+static bool timer1_armed = false;
+static uint8_t timer1_div = TIM_DIV1;
+static uint64_t timer1_due_us;
+
+void timer1_isr_init() {}
+
+void timer1_attachInterrupt(timercallback userFunc) {
+    timer1_isr = userFunc;
+}
+
+void timer1_enable(uint8_t divider, uint8_t int_type, uint8_t reload) {
+    (void)int_type;
+    (void)reload;
+    timer1_div = divider;
+}
+
+void timer1_write(uint32_t ticks) {
+    static const uint8_t shift[] = {0, 4, 4, 8};
+    timer1_due_us = now_us() + ((uint64_t)ticks << shift[timer1_div & 3]) / 80;
+    timer1_armed = true;
+}
+
+void timer1_disable() {
+    timer1_armed = false;
+}
+
+void yield() {
+    static bool running = false;
+    if(running) {
+        return;
+    }
+    running = true;
+    // Single shot: the ISR re-arms the timer if it wants another tick
+    while(timer1_armed && timer1_isr && now_us() >= timer1_due_us) {
+        timer1_armed = false;
+        timer1_isr();
+    }
+    Ticker::poll();
+    running = false;
+}
+
+// GPIO and HD44780
+
+static struct LcdModel {
+    uint32_t gpio;          // Output latch of GPIO0-15
+    bool enable;            // GPIO16 (E)
+    bool four_bit;
+    bool nibble_pending;
+    uint8_t high_nibble;
+    bool cgram;             // Data writes go to CGRAM
+    bool cursor;            // Underline cursor shown
+    uint8_t addr;
+    uint8_t ddram[128];
+    uint8_t cgram_data[64];
+    uint32_t bytes;
+    char row[NATIVE_LCD_COLS + 1];
+
+    LcdModel() {
+        gpio = 0;
+        enable = true;
+        four_bit = nibble_pending = cgram = cursor = false;
+        high_nibble = addr = 0;
+        bytes = 0;
+        memset(ddram, ' ', sizeof(ddram));
+        memset(cgram_data, 0, sizeof(cgram_data));
+    }
+} lcd_model;
+
+static void lcdExecute(bool rs, uint8_t val) {
+    lcd_model.bytes++;
+    if(rs) {
+        if(lcd_model.cgram) {
+            lcd_model.cgram_data[lcd_model.addr & 0x3F] = val;
+            lcd_model.addr = (lcd_model.addr + 1) & 0x3F;
+        } else {
+            lcd_model.ddram[lcd_model.addr] = val;
+            // Two lines of 40 characters each
+            if(lcd_model.addr == 0x27) {
+                lcd_model.addr = 0x40;
+            } else if(lcd_model.addr == 0x67) {
+                lcd_model.addr = 0x00;
+            } else {
+                lcd_model.addr++;
+            }
+        }
+    } else if(val & 0x80) {
+        lcd_model.addr = val & 0x7F;
+        lcd_model.cgram = false;
+    } else if(val & 0x40) {
+        lcd_model.addr = val & 0x3F;
+        lcd_model.cgram = true;
+    } else if(val == 0x01) {
+        memset(lcd_model.ddram, ' ', sizeof(lcd_model.ddram));
+        lcd_model.addr = 0;
+        lcd_model.cgram = false;
+    } else if((val & 0xFE) == 0x02) {
+        lcd_model.addr = 0;
+        lcd_model.cgram = false;
+    } else if((val & 0xF8) == 0x08) {
+        lcd_model.cursor = val & 0x02;
+    } else if((val & 0xF0) == 0x20) {
+        lcd_model.four_bit = !(val & 0x10);
+    }
+}
+
+// Falling edge of E: the controller latches DB4-DB7 (GPIO12-15)
+static void lcdLatch() {
+    uint8_t nibble = (lcd_model.gpio >> 12) & 0x0F;
+    bool rs = lcd_model.gpio & (1 << NATIVE_LCD_RS_PIN);
+    if(!lcd_model.four_bit) {
+        // 8-bit mode with DB0-DB3 tied low
+        lcdExecute(rs, nibble << 4);
+        lcd_model.nibble_pending = false;
+    } else if(!lcd_model.nibble_pending) {
+        lcd_model.high_nibble = nibble;
+        lcd_model.nibble_pending = true;
+    } else {
+        lcd_model.nibble_pending = false;
+        lcdExecute(rs, (lcd_model.high_nibble << 4) | nibble);
+    }
+}
+
+static void gposWrite(uint32_t val) {
+    lcd_model.gpio |= val;
+}
+
+static void gpocWrite(uint32_t val) {
+    lcd_model.gpio &= ~val;
+}
+
+static void gp16oWrite(uint32_t val) {
+    bool enable = val & 1;
+    if(lcd_model.enable && !enable) {
+        lcdLatch();
+    }
+    lcd_model.enable = enable;
+}
+
+NativeGpioReg GPOS(gposWrite);
+NativeGpioReg GPOC(gpocWrite);
+NativeGpioReg GP16O(gp16oWrite);
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    (void)pin;
+    (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    if(pin == 16) {
+        gp16oWrite(val);
+    } else if(val) {
+        gposWrite(1 << pin);
+    } else {
+        gpocWrite(1 << pin);
+    }
+}
+
+const char* nativeLcdRow(uint8_t row) {
+    static const uint8_t row_addrs[] = {0x00, 0x40, 0x14, 0x54};
+    memcpy(lcd_model.row, lcd_model.ddram + row_addrs[row & 3], NATIVE_LCD_COLS);
+    lcd_model.row[NATIVE_LCD_COLS] = '\0';
+    return lcd_model.row;
+}
+
+const uint8_t* nativeLcdCgram(uint8_t slot) {
+    return lcd_model.cgram_data + ((slot & 7) << 3);
+}
+
+bool nativeLcdCursor(uint8_t& col, uint8_t& row) {
+    static const uint8_t row_addrs[] = {0x00, 0x40, 0x14, 0x54};
+    if(!lcd_model.cursor || lcd_model.cgram) {
+        return false;
+    }
+    for(uint8_t r=0; r<4; r++) {
+        if(lcd_model.addr >= row_addrs[r] && lcd_model.addr < row_addrs[r] + NATIVE_LCD_COLS) {
+            col = lcd_model.addr - row_addrs[r];
+            row = r;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t nativeLcdBytes() {
+    return lcd_model.bytes;
+}
+
+// Ticker
+
+static Ticker* tickers = NULL;
+
+Ticker::Ticker() {
+    armed = false;
+    next = tickers;
+    tickers = this;
+}
+
+Ticker::~Ticker() {
+    for(Ticker** t = &tickers; *t; t = &(*t)->next) {
+        if(*t == this) {
+            *t = next;
+            break;
+        }
+    }
+}
+
+void Ticker::arm(uint32_t ms, bool repeat_cb, callback_function_t cb) {
+    callback = cb;
+    period_ms = ms;
+    repeat = repeat_cb;
+    due_ms = millis() + ms;
+    armed = true;
+}
+
+void Ticker::detach() {
+    armed = false;
+}
+
+void Ticker::poll() {
+    unsigned long now = millis();
+    for(Ticker* t = tickers; t; t = t->next) {
+        if(t->armed && (long)(now - t->due_ms) >= 0) {
+            if(t->repeat) {
+                t->due_ms += t->period_ms;
+            } else {
+                t->armed = false;
+            }
+            // Copy, the callback may re-arm this ticker
+            callback_function_t cb = t->callback;
+            cb();
+        }
+    }
+}
+
+// Print, Stream and Serial
+
+size_t Print::printf(const char* format, ...) {
+    char buf[128];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if(len < 0) {
+        return 0;
+    }
+    return write((const uint8_t*)buf, std::min((size_t)len, sizeof(buf) - 1));
+}
+
+int Stream::timedRead() {
+    unsigned long start = millis();
+    do {
+        int c = read();
+        if(c >= 0) {
+            return c;
+        }
+        delay(1);
+    } while(millis() - start < timeout_ms);
+    return -1;
+}
+
+size_t Stream::readBytes(char* buf, size_t len) {
+    size_t n = 0;
+    while(n < len) {
+        int c = timedRead();
+        if(c < 0) {
+            break;
+        }
+        buf[n++] = c;
+    }
+    return n;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    return fwrite(&c, 1, 1, stdout);
+}
+
+size_t HardwareSerial::write(const uint8_t* buf, size_t len) {
+    return fwrite(buf, 1, len, stdout);
+}
@@ -0,0 +1,46 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+Hooks into the simulated hardware of the native environment
+*/
+
+#ifndef NATIVE_HAL_H
+#define NATIVE_HAL_H
+
+#include <Arduino.h>
+#include <inttypes.h>
+
+#define NATIVE_LCD_RS_PIN   2   // Must match the LCD2004 constructor argument
+#define NATIVE_LCD_COLS     20
+
+// Row of the simulated 20x4 HD44780 as it would appear on the panel,
+// NUL terminated
+const char* nativeLcdRow(uint8_t row);
+// CGRAM bitmap of a custom character slot (0-7), 8 rows
+const uint8_t* nativeLcdCgram(uint8_t slot);
+// Position of the underline cursor, if it is shown on a visible cell
+bool nativeLcdCursor(uint8_t& col, uint8_t& row);
+// Bytes (data and commands) the simulated LCD has latched since power-on
+uint32_t nativeLcdBytes();
+
+#endif
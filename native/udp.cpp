@@ -0,0 +1,145 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "WiFiUdp.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+WiFiUDP::WiFiUDP() : fd(-1), tx_addr(0), tx_port(0), tx_len(0), rx_len(0), rx_pos(0) {}
+
+WiFiUDP::~WiFiUDP() {
+    stop();
+}
+
+bool WiFiUDP::open() {
+    if(fd >= 0) {
+        return true;
+    }
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if(fd < 0) {
+        return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+    in_addr loopback = { htonl(INADDR_LOOPBACK) };
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &loopback, sizeof(loopback));
+    unsigned char loop = 1;
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+    return true;
+}
+
+uint8_t WiFiUDP::begin(uint16_t port) {
+    if(!open()) {
+        return 0;
+    }
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if(bind(fd, (sockaddr*)&addr, sizeof(addr))) {
+        stop();
+        return 0;
+    }
+    return 1;
+}
+
+uint8_t WiFiUDP::beginMulticast(IPAddress iface, IPAddress group, uint16_t port) {
+    (void)iface;
+    if(!begin(port)) {
+        return 0;
+    }
+    ip_mreq mreq;
+    mreq.imr_multiaddr.s_addr = (uint32_t)group;
+    mreq.imr_interface.s_addr = htonl(INADDR_LOOPBACK);
+    if(setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq))) {
+        stop();
+        return 0;
+    }
+    return 1;
+}
+
+void WiFiUDP::stop() {
+    if(fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    tx_len = rx_len = rx_pos = 0;
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port) {
+    if(!open()) {
+        return 0;
+    }
+    tx_addr = ip;
+    tx_port = port;
+    tx_len = 0;
+    return 1;
+}
+
+size_t WiFiUDP::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t WiFiUDP::write(const uint8_t* buf, size_t size) {
+    size = min(size, sizeof(tx) - tx_len);
+    memcpy(tx + tx_len, buf, size);
+    tx_len += size;
+    return size;
+}
+
+int WiFiUDP::endPacket() {
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(tx_port);
+    addr.sin_addr.s_addr = tx_addr;
+    ssize_t sent = sendto(fd, tx, tx_len, 0, (sockaddr*)&addr, sizeof(addr));
+    tx_len = 0;
+    return sent >= 0;
+}
+
+int WiFiUDP::parsePacket() {
+    rx_len = rx_pos = 0;
+    if(fd < 0) {
+        return 0;
+    }
+    ssize_t len = recv(fd, rx, sizeof(rx), 0);
+    if(len <= 0) {
+        return 0;
+    }
+    rx_len = len;
+    return len;
+}
+
+int WiFiUDP::read(uint8_t* buf, size_t len) {
+    len = min(len, rx_len - rx_pos);
+    memcpy(buf, rx + rx_pos, len);
+    rx_pos += len;
+    return len;
+}
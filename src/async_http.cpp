@@ -0,0 +1,408 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "async_http.h"
+#include "profiler.h"
+
+#define HTTP_SESSION_MAGIC          0x31534C54 // "TLS1"
+
+static const char accept_gzip[] PROGMEM = "Accept-Encoding: gzip\r\n\r\n";
+static const char accept_identity[] PROGMEM = "Accept-Encoding: identity\r\n\r\n";
+
+typedef struct {
+    uint32_t magic;
+    uint16_t size;          // sizeof(BearSSL::Session), in case the core changes
+    bool mfln_probed;
+    bool mfln;
+} SessionHeader;
+
+GzipInflater AsyncHttp::inflater;
+AsyncHttp* AsyncHttp::inflater_holder = NULL;
+
+AsyncHttp::AsyncHttp() : body(client) {
+    host = NULL;
+    sink = NULL;
+    gzip = false;
+    inflating = false;
+    identity_count = 0;
+    wire_bytes = 0;
+    memset(stats, 0, sizeof(stats));
+    trace = NULL;
+    trace_channel = 0;
+    traced = false;
+    state = STATE_IDLE;
+    reused = false;
+    small_buffers = false;
+    mfln_probed = false;
+    mfln = false;
+    code = 0;
+    state_ms = sent_ms = first_byte_ms = 0;
+}
+
+// Clear the request buffer and return it for writing the next request.
+// Must not be called while busy(), since a failed send is retried from it.
+Print& AsyncHttp::compose() {
+    request.clear();
+    return request;
+}
+
+bool AsyncHttp::start(const char* new_host) {
+    if(state != STATE_IDLE) {
+        return false;
+    }
+    if(request.overflowed()) {
+        Serial.print(F("Request too long for "));
+        Serial.println(new_host);
+        return false;
+    }
+    if(client.connected() && host && strcmp(host, new_host)) {
+        client.stop(); // Different server
+    }
+    if(host != new_host && (!host || strcmp(host, new_host))) {
+        mfln_probed = false;
+    }
+    host = new_host;
+    code = 0;
+    state = STATE_CONNECT;
+    state_ms = millis();
+    return true;
+}
+
+// Start the composed request, writing the body to the sink as it arrives.
+// The request must include the full header, terminated by a blank line.
+bool AsyncHttp::begin(const char* host, Print* body_sink, DoneHandler on_done) {
+    if(!start(host)) {
+        return false;
+    }
+    sink = body_sink;
+    done = on_done;
+    acceptEncoding();
+    traced = trace && trace->record(TRACE_REQUEST, trace_channel, host, strlen(host));
+    return true;
+}
+
+bool AsyncHttp::gzipAllowed() const {
+    if(!gzip) {
+        return false;
+    }
+    for(uint8_t i=0; i<identity_count; i++) {
+        if(!strcmp(identity_hosts[i], host)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void AsyncHttp::preferIdentity(const char* identity_host) {
+    for(uint8_t i=0; i<identity_count; i++) {
+        if(!strcmp(identity_hosts[i], identity_host)) {
+            return;
+        }
+    }
+    if(identity_count < HTTP_IDENTITY_HOSTS) {
+        identity_hosts[identity_count++] = identity_host;
+    }
+}
+
+// Keep the shared decoder for this request. Fails if another request has
+// it, or if allocating it would leave too small a block for TLS.
+bool AsyncHttp::holdInflater() {
+    if(inflater_holder && inflater_holder != this) {
+        return false;
+    }
+    if(!inflater.reserved() &&
+       (ESP.getMaxFreeBlockSize() < GzipInflater::memorySize() + HTTP_INFLATE_HEADROOM || !inflater.reserve())) {
+        return false;
+    }
+    inflater_holder = this;
+    return true;
+}
+
+void AsyncHttp::releaseInflater() {
+    if(inflater_holder == this) {
+        inflater.end();
+        inflater_holder = NULL;
+    }
+}
+
+// Add an Accept-Encoding header to the composed request, before the blank
+// line that ends it. Gzip is only asked for with the decoder held, so the
+// body never arrives compressed with no memory to inflate it.
+void AsyncHttp::acceptEncoding() {
+    size_t len = request.length();
+    if(len < 4 || strcmp(request.c_str() + len - 4, "\r\n\r\n") ||
+       len - 2 + strlen_P(accept_identity) > request.capacity()) {
+        return;
+    }
+    const char* header = gzipAllowed() && holdInflater() ? accept_gzip : accept_identity;
+    request.truncate(len - 2);
+    request.print(FPSTR(header));
+}
+
+// The body couldn't be inflated. If the server refers back further than
+// the window, stop asking it for gzip.
+void AsyncHttp::inflateFailed(uint8_t error) {
+    Serial.print(F("Can't inflate body from "));
+    Serial.print(host);
+    Serial.print(F(", error "));
+    Serial.println(error);
+    if(error == INFLATE_ERROR_WINDOW) {
+        preferIdentity(host);
+    }
+    finish(HTTP_ERROR_DECODE);
+}
+
+void AsyncHttp::finish(int result) {
+    if(sink && result >= 0) {
+        EncodingStats& s = stats[inflating];
+        s.responses++;
+        s.wire_bytes += wire_bytes;
+        s.body_bytes += inflating ? inflater.bytesOut() : wire_bytes;
+        s.ms += millis() - sent_ms;
+    }
+    releaseInflater();
+    inflating = false;
+    if(traced) {
+        int16_t end = result;
+        trace->record(TRACE_END, trace_channel, &end, sizeof(end));
+        traced = false;
+    }
+    if(result < 0 || !body.keepAlive()) {
+        client.stop();
+    }
+    state = STATE_IDLE;
+    // The callback may start the next request
+    DoneHandler cb = done;
+    done = nullptr;
+    if(cb) {
+        cb(result);
+    }
+}
+
+// Write the TLS session of the last connection, with the result of the
+// fragment length probe, so a reboot can skip both the probe and a full
+// handshake
+size_t AsyncHttp::saveSession(Print& out) {
+    SessionHeader hdr = { HTTP_SESSION_MAGIC, sizeof(session), mfln_probed, mfln };
+    size_t len = out.write((const uint8_t*)&hdr, sizeof(hdr));
+    return len + out.write((const uint8_t*)&session, sizeof(session));
+}
+
+bool AsyncHttp::loadSession(Stream& in, const char* server) {
+    SessionHeader hdr;
+    if(busy() || in.readBytes((uint8_t*)&hdr, sizeof(hdr)) != sizeof(hdr) ||
+       hdr.magic != HTTP_SESSION_MAGIC || hdr.size != sizeof(session) ||
+       in.readBytes((uint8_t*)&session, sizeof(session)) != sizeof(session)) {
+        return false;
+    }
+    host = server;
+    mfln_probed = hdr.mfln_probed;
+    mfln = hdr.mfln;
+    return true;
+}
+
+// Advance the request by one step
+void AsyncHttp::poll() {
+    unsigned long now = millis();
+    switch(state) {
+        case STATE_CONNECT:
+            reused = client.connected();
+            if(!reused) {
+                if(small_buffers && !mfln_probed) {
+                    mfln = WiFiClientSecure::probeMaxFragmentLength(host, 443, HTTP_MFLN_SIZE);
+                    mfln_probed = true;
+                }
+                client.setInsecure(); //Bad!
+                client.setSession(&session); // Resume the TLS session when reconnecting
+                if(mfln) {
+                    client.setBufferSizes(HTTP_MFLN_SIZE, 512);
+                }
+                client.setTimeout(HTTP_CONNECT_TIMEOUT_MS);
+                bool connected;
+                {
+                    ProfileScope scope(PROFILE_TLS_CONNECT);
+                    connected = client.connect(host, 443);
+                }
+                if(!connected) {
+                    finish(HTTP_ERROR_CONNECT);
+                    break;
+                }
+            }
+            state = STATE_SEND;
+            break;
+        case STATE_SEND:
+            if(client.write((const uint8_t*)request.c_str(), request.length()) != request.length()) {
+                if(reused) {
+                    client.stop();
+                    state = STATE_CONNECT;
+                } else {
+                    finish(HTTP_ERROR_SEND);
+                }
+                break;
+            }
+            body.begin();
+            sent_ms = state_ms = millis();
+            first_byte_ms = 0;
+            state = STATE_HEADERS;
+            break;
+        case STATE_HEADERS: {
+            if(!first_byte_ms && client.available()) {
+                first_byte_ms = now;
+            }
+            uint32_t start = ESP.getCycleCount();
+            code = body.parseHeaders();
+            if(first_byte_ms) { // Only count calls that had data to parse
+                profileRecord(PROFILE_HTTP_HEADERS, ESP.getCycleCount() - start);
+            }
+            if(code >= 0) {
+                state_ms = now;
+                if(traced) {
+                    TraceHeaders hdr = { (int16_t)code, (uint32_t)sent_ms, (uint32_t)first_byte_ms };
+                    trace->record(TRACE_HEADERS, trace_channel, &hdr, sizeof(hdr));
+                }
+                wire_bytes = 0;
+                if(sink && body.gzipped() && !body.done()) {
+                    // Compressed although not asked for, without the decoder
+                    if(inflater_holder != this || !inflater.begin(sink)) {
+                        inflateFailed(INFLATE_ERROR_MEMORY);
+                        break;
+                    }
+                    inflating = true;
+                }
+                state = STATE_BODY;
+            } else if(!client.connected() && !client.available()) {
+                // A kept-alive connection may have been closed by the server
+                // before our request arrived. Try once more on a new one.
+                if(reused) {
+                    client.stop();
+                    state = STATE_CONNECT;
+                } else {
+                    finish(HTTP_ERROR_SEND);
+                }
+            } else if(now - state_ms > HTTP_RESPONSE_TIMEOUT_MS) {
+                finish(HTTP_ERROR_TIMEOUT);
+            }
+            break;
+        }
+        case STATE_BODY: {
+            uint8_t chunk[HTTP_BODY_CHUNK];
+            int n = 0;
+            int c;
+            while(n < HTTP_BODY_CHUNK && (c = body.read()) >= 0) {
+                chunk[n++] = c;
+            }
+            if(n) {
+                state_ms = now;
+                wire_bytes += n;
+                if(traced) {
+                    trace->record(TRACE_BODY, trace_channel, chunk, n);
+                }
+                ProfileScope scope(PROFILE_JSON_PARSE); // Every sink is a JSON extractor
+                if(inflating) {
+                    inflater.write(chunk, n);
+                    if(inflater.error()) {
+                        inflateFailed(inflater.error());
+                        break;
+                    }
+                } else if(sink) {
+                    sink->write(chunk, n);
+                }
+            }
+            if(body.done()) {
+                if(inflating && !inflater.finish()) {
+                    inflateFailed(inflater.error());
+                    break;
+                }
+                finish(code);
+            } else if(now - state_ms > HTTP_RESPONSE_TIMEOUT_MS) {
+                finish(HTTP_ERROR_TIMEOUT);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// Run the current request to completion. Returns the status or error code.
+int AsyncHttp::wait() {
+    DoneHandler cb = done;
+    int result = HTTP_ERROR_ABORTED;
+    done = [&result, cb](int code) {
+        result = code;
+        if(cb) {
+            cb(code);
+        }
+    };
+    while(state != STATE_IDLE) {
+        poll();
+        yield();
+    }
+    return result;
+}
+
+// Cancel the current request. The done handler is not called.
+void AsyncHttp::abort() {
+    if(state != STATE_IDLE) {
+        if(traced) {
+            int16_t end = HTTP_ERROR_ABORTED;
+            trace->record(TRACE_END, trace_channel, &end, sizeof(end));
+            traced = false;
+        }
+        client.stop();
+        releaseInflater();
+        inflating = false;
+        done = nullptr;
+        state = STATE_IDLE;
+    }
+}
+
+// Close the connection, releasing the TLS buffers
+void AsyncHttp::stop() {
+    abort();
+    client.stop();
+}
+
+void AsyncHttp::printStats(Print& out, const __FlashStringHelper* name) const {
+    out.print(name);
+    out.print(':');
+    for(uint8_t i=0; i<2; i++) {
+        const EncodingStats& s = stats[i];
+        if(!s.responses) {
+            continue;
+        }
+        out.print(i ? F(" gzip ") : F(" identity "));
+        out.print(s.responses);
+        out.print(F(" x "));
+        out.print(s.wire_bytes / s.responses);
+        if(i) {
+            out.print(F(" -> "));
+            out.print(s.body_bytes / s.responses);
+        }
+        out.print(F(" bytes, "));
+        out.print(s.ms / s.responses);
+        out.print(F(" ms"));
+    }
+    out.println();
+}
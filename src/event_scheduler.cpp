@@ -0,0 +1,89 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "event_scheduler.h"
+#include "profiler.h"
+
+#include <inttypes.h>
+
+EventScheduler::EventScheduler(EventHandler handler) : handler(handler) {
+    head = count = 0;
+    running = false;
+}
+
+// Queue an event. Times are compared as signed differences, so they can
+// wrap. Returns false if the queue is full.
+bool EventScheduler::at(uint32_t due_us, uint8_t type, uint16_t arg) {
+    if(count == EVENT_QUEUE_SIZE) {
+        return false;
+    }
+    // Events are mostly added in time order, so search from the back
+    size_t idx = count;
+    while(idx > 0 && (int32_t)(slot(idx-1).due_us - due_us) > 0) {
+        slot(idx) = slot(idx-1);
+        idx--;
+    }
+    ScheduledEvent& e = slot(idx);
+    e.due_us = due_us;
+    e.type = type;
+    e.arg = arg;
+    count++;
+    return true;
+}
+
+// Drop all pending events of a type
+void EventScheduler::cancel(uint8_t type) {
+    size_t kept = 0;
+    for(size_t i=0; i<count; i++) {
+        if(slot(i).type != type) {
+            slot(kept++) = slot(i);
+        }
+    }
+    count = kept;
+}
+
+// Run the events that are due. Handlers may add or cancel events.
+// Returns the number of events run.
+uint8_t EventScheduler::poll() {
+    if(running) {
+        return 0;
+    }
+    running = true;
+    uint8_t n = 0;
+    while(count) {
+        uint32_t now = micros();
+        ScheduledEvent e = slot(0);
+        int32_t late_us = now - e.due_us;
+        if(late_us < 0) {
+            break;
+        }
+        head = (head + 1) % EVENT_QUEUE_SIZE;
+        count--;
+        profileRecord(PROFILE_TICKER_LATE, min(late_us, (int32_t)10000000) * ESP.getCpuFreqMHz());
+        handler(e.type, e.arg);
+        n++;
+    }
+    running = false;
+    return n;
+}
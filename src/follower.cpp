@@ -0,0 +1,86 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Firmware for a follower display (env:follower): shows what the hub
+// multicasts, without talking to Spotify. See lyric_link.h.
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include <LittleFS.h>
+#include <Ticker.h>
+
+#include "secrets.h"
+#include "lcd2004.h"
+#include "glyphs.h"
+#include "lyric_link.h"
+#include "wifi_cache.h"
+
+#define STATS_INTERVAL_MS       60000
+
+LCD2004 lcd(2);
+Ticker displayTicker;
+WiFiUDP linkUdp;
+LyricFollower follower(linkUdp, lcd);
+unsigned long stats_ms = 0;
+
+// Called from displayTicker: the only place the lyric display runs
+void displayTick() {
+    follower.tick();
+}
+
+void setup() {
+    Serial.begin(115200);
+    if(!LittleFS.begin()) {
+        Serial.println(F("FATAL: filesystem error"));
+        while(1) yield();
+    }
+    lcd.begin(true);
+    lcd.setGlyphs(GLYPH_BASE, GLYPH_COUNT, glyph_bitmaps, glyph_fallback);
+    displayTicker.attach_ms(DISPLAY_TICK_MS, displayTick);
+    lcd.clear();
+    lcd.print("Connecting to");
+    lcd.setCursor(0,1);
+    lcd.print(WIFI_SSID);
+    wifiBegin(WIFI_SSID, WIFI_PASS);
+    wifiWait(WIFI_SSID, WIFI_PASS);
+    Serial.println(F("Connected"));
+    Serial.println(WiFi.localIP());
+    if(!linkUdp.beginMulticast(WiFi.localIP(), LINK_GROUP, LINK_PORT)) {
+        Serial.println(F("FATAL: can't join the link group"));
+        while(1) yield();
+    }
+    lcd.clear();
+    lcd.print("Waiting for hub");
+}
+
+void loop() {
+    follower.poll();
+    if(millis() - stats_ms >= STATS_INTERVAL_MS) {
+        stats_ms = millis();
+        Serial.print(F("Lyric link: "));
+        Serial.print(follower.packets());
+        Serial.println(F(" packets"));
+    }
+}
@@ -0,0 +1,530 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "glyphs.h"
+
+#include <inttypes.h>
+
+typedef struct {
+    uint16_t cp;        // Unicode code point
+    uint8_t code[2];    // One or two display codes, zero padded
+} GlyphMap;
+
+// Sorted by code point. Everything not listed (other than ASCII) is
+// shown as GLYPH_UNKNOWN.
+static const GlyphMap glyph_map[] PROGMEM = {
+    { 0x00A0, { ' ' } }, // NBSP
+    { 0x00A1, { GLYPH_BASE + 23 } }, // ¡
+    { 0x00A5, { 0x5C } }, // ¥
+    { 0x00AB, { '"' } }, // «
+    { 0x00B0, { 0xDF } }, // °
+    { 0x00B5, { 0xE4 } }, // µ
+    { 0x00B7, { 0xA5 } }, // ·
+    { 0x00BB, { '"' } }, // »
+    { 0x00BF, { GLYPH_BASE + 22 } }, // ¿
+    { 0x00C0, { 'A' } }, // À
+    { 0x00C1, { 'A' } }, // Á
+    { 0x00C2, { 'A' } }, // Â
+    { 0x00C3, { 'A' } }, // Ã
+    { 0x00C4, { 'A' } }, // Ä
+    { 0x00C5, { 'A' } }, // Å
+    { 0x00C6, { 'A', 'E' } }, // Æ
+    { 0x00C7, { 'C' } }, // Ç
+    { 0x00C8, { 'E' } }, // È
+    { 0x00C9, { 'E' } }, // É
+    { 0x00CA, { 'E' } }, // Ê
+    { 0x00CB, { 'E' } }, // Ë
+    { 0x00CC, { 'I' } }, // Ì
+    { 0x00CD, { 'I' } }, // Í
+    { 0x00CE, { 'I' } }, // Î
+    { 0x00CF, { 'I' } }, // Ï
+    { 0x00D0, { 'D' } }, // Ð
+    { 0x00D1, { 'N' } }, // Ñ
+    { 0x00D2, { 'O' } }, // Ò
+    { 0x00D3, { 'O' } }, // Ó
+    { 0x00D4, { 'O' } }, // Ô
+    { 0x00D5, { 'O' } }, // Õ
+    { 0x00D6, { 'O' } }, // Ö
+    { 0x00D7, { 'x' } }, // ×
+    { 0x00D8, { 'O' } }, // Ø
+    { 0x00D9, { 'U' } }, // Ù
+    { 0x00DA, { 'U' } }, // Ú
+    { 0x00DB, { 'U' } }, // Û
+    { 0x00DC, { 'U' } }, // Ü
+    { 0x00DD, { 'Y' } }, // Ý
+    { 0x00DF, { 0xE2 } }, // ß
+    { 0x00E0, { GLYPH_BASE + 1 } }, // à
+    { 0x00E1, { GLYPH_BASE + 0 } }, // á
+    { 0x00E2, { GLYPH_BASE + 2 } }, // â
+    { 0x00E3, { GLYPH_BASE + 3 } }, // ã
+    { 0x00E4, { 0xE1 } }, // ä
+    { 0x00E5, { GLYPH_BASE + 19 } }, // å
+    { 0x00E6, { 'a', 'e' } }, // æ
+    { 0x00E7, { GLYPH_BASE + 20 } }, // ç
+    { 0x00E8, { GLYPH_BASE + 5 } }, // è
+    { 0x00E9, { GLYPH_BASE + 4 } }, // é
+    { 0x00EA, { GLYPH_BASE + 6 } }, // ê
+    { 0x00EB, { GLYPH_BASE + 17 } }, // ë
+    { 0x00EC, { GLYPH_BASE + 8 } }, // ì
+    { 0x00ED, { GLYPH_BASE + 7 } }, // í
+    { 0x00EE, { GLYPH_BASE + 9 } }, // î
+    { 0x00EF, { GLYPH_BASE + 18 } }, // ï
+    { 0x00F0, { 'd' } }, // ð
+    { 0x00F1, { 0xEE } }, // ñ
+    { 0x00F2, { GLYPH_BASE + 11 } }, // ò
+    { 0x00F3, { GLYPH_BASE + 10 } }, // ó
+    { 0x00F4, { GLYPH_BASE + 12 } }, // ô
+    { 0x00F5, { GLYPH_BASE + 13 } }, // õ
+    { 0x00F6, { 0xEF } }, // ö
+    { 0x00F7, { 0xFD } }, // ÷
+    { 0x00F8, { GLYPH_BASE + 21 } }, // ø
+    { 0x00F9, { GLYPH_BASE + 15 } }, // ù
+    { 0x00FA, { GLYPH_BASE + 14 } }, // ú
+    { 0x00FB, { GLYPH_BASE + 16 } }, // û
+    { 0x00FC, { 0xF5 } }, // ü
+    { 0x00FD, { 'y' } }, // ý
+    { 0x00FF, { 'y' } }, // ÿ
+    { 0x0152, { 'O', 'E' } }, // Œ
+    { 0x0153, { 'o', 'e' } }, // œ
+    { 0x03A3, { 0xF6 } }, // Σ
+    { 0x03A9, { 0xF4 } }, // Ω
+    { 0x03B1, { 0xE0 } }, // α
+    { 0x03B2, { 0xE2 } }, // β
+    { 0x03B5, { 0xE3 } }, // ε
+    { 0x03B8, { 0xF2 } }, // θ
+    { 0x03BC, { 0xE4 } }, // μ
+    { 0x03C0, { 0xF7 } }, // π
+    { 0x03C1, { 0xE6 } }, // ρ
+    { 0x03C3, { 0xE5 } }, // σ
+    { 0x2010, { '-' } }, // ‐
+    { 0x2011, { '-' } }, // ‑
+    { 0x2012, { '-' } }, // ‒
+    { 0x2013, { '-' } }, // –
+    { 0x2014, { '-' } }, // —
+    { 0x2015, { '-' } }, // ―
+    { 0x2018, { '\'' } }, // ‘
+    { 0x2019, { '\'' } }, // ’
+    { 0x201C, { '"' } }, // “
+    { 0x201D, { '"' } }, // ”
+    { 0x2022, { 0xA5 } }, // •
+    { 0x2026, { '.', '.' } }, // …
+    { 0x2190, { 0x7F } }, // ←
+    { 0x2192, { 0x7E } }, // →
+    { 0x221A, { 0xE8 } }, // √
+    { 0x221E, { 0xF3 } }, // ∞
+    { 0x266A, { GLYPH_BASE + 24 } }, // ♪
+    { 0x266B, { GLYPH_BASE + 24 } } // ♫
+};
+
+// Custom glyphs, top row first, 5 pixels per row
+const uint8_t glyph_bitmaps[GLYPH_COUNT][8] PROGMEM = {
+    { // 0: á
+        0b00010,
+        0b00100,
+        0b01110,
+        0b00001,
+        0b01111,
+        0b10001,
+        0b01111,
+        0b00000
+    },
+    { // 1: à
+        0b01000,
+        0b00100,
+        0b01110,
+        0b00001,
+        0b01111,
+        0b10001,
+        0b01111,
+        0b00000
+    },
+    { // 2: â
+        0b00100,
+        0b01010,
+        0b01110,
+        0b00001,
+        0b01111,
+        0b10001,
+        0b01111,
+        0b00000
+    },
+    { // 3: ã
+        0b01101,
+        0b10010,
+        0b01110,
+        0b00001,
+        0b01111,
+        0b10001,
+        0b01111,
+        0b00000
+    },
+    { // 4: é
+        0b00010,
+        0b00100,
+        0b01110,
+        0b10001,
+        0b11111,
+        0b10000,
+        0b01110,
+        0b00000
+    },
+    { // 5: è
+        0b01000,
+        0b00100,
+        0b01110,
+        0b10001,
+        0b11111,
+        0b10000,
+        0b01110,
+        0b00000
+    },
+    { // 6: ê
+        0b00100,
+        0b01010,
+        0b01110,
+        0b10001,
+        0b11111,
+        0b10000,
+        0b01110,
+        0b00000
+    },
+    { // 7: í
+        0b00010,
+        0b00100,
+        0b01100,
+        0b00100,
+        0b00100,
+        0b00100,
+        0b01110,
+        0b00000
+    },
+    { // 8: ì
+        0b01000,
+        0b00100,
+        0b01100,
+        0b00100,
+        0b00100,
+        0b00100,
+        0b01110,
+        0b00000
+    },
+    { // 9: î
+        0b00100,
+        0b01010,
+        0b01100,
+        0b00100,
+        0b00100,
+        0b00100,
+        0b01110,
+        0b00000
+    },
+    { // 10: ó
+        0b00010,
+        0b00100,
+        0b01110,
+        0b10001,
+        0b10001,
+        0b10001,
+        0b01110,
+        0b00000
+    },
+    { // 11: ò
+        0b01000,
+        0b00100,
+        0b01110,
+        0b10001,
+        0b10001,
+        0b10001,
+        0b01110,
+        0b00000
+    },
+    { // 12: ô
+        0b00100,
+        0b01010,
+        0b01110,
+        0b10001,
+        0b10001,
+        0b10001,
+        0b01110,
+        0b00000
+    },
+    { // 13: õ
+        0b01101,
+        0b10010,
+        0b01110,
+        0b10001,
+        0b10001,
+        0b10001,
+        0b01110,
+        0b00000
+    },
+    { // 14: ú
+        0b00010,
+        0b00100,
+        0b10001,
+        0b10001,
+        0b10001,
+        0b10011,
+        0b01101,
+        0b00000
+    },
+    { // 15: ù
+        0b01000,
+        0b00100,
+        0b10001,
+        0b10001,
+        0b10001,
+        0b10011,
+        0b01101,
+        0b00000
+    },
+    { // 16: û
+        0b00100,
+        0b01010,
+        0b10001,
+        0b10001,
+        0b10001,
+        0b10011,
+        0b01101,
+        0b00000
+    },
+    { // 17: ë
+        0b01010,
+        0b00000,
+        0b01110,
+        0b10001,
+        0b11111,
+        0b10000,
+        0b01110,
+        0b00000
+    },
+    { // 18: ï
+        0b01010,
+        0b00000,
+        0b01100,
+        0b00100,
+        0b00100,
+        0b00100,
+        0b01110,
+        0b00000
+    },
+    { // 19: å
+        0b00100,
+        0b01010,
+        0b00100,
+        0b01110,
+        0b00001,
+        0b01111,
+        0b10001,
+        0b01111
+    },
+    { // 20: ç
+        0b00000,
+        0b01110,
+        0b10000,
+        0b10000,
+        0b10001,
+        0b01110,
+        0b00100,
+        0b01100
+    },
+    { // 21: ø
+        0b00000,
+        0b00000,
+        0b01110,
+        0b10011,
+        0b10101,
+        0b11001,
+        0b01110,
+        0b00000
+    },
+    { // 22: ¿
+        0b00100,
+        0b00000,
+        0b00100,
+        0b01000,
+        0b10000,
+        0b10001,
+        0b01110,
+        0b00000
+    },
+    { // 23: ¡
+        0b00100,
+        0b00000,
+        0b00100,
+        0b00100,
+        0b00100,
+        0b00100,
+        0b00100,
+        0b00000
+    },
+    { // 24: ♪
+        0b00100,
+        0b00110,
+        0b00101,
+        0b00101,
+        0b00100,
+        0b11100,
+        0b11100,
+        0b00000
+    }
+};
+
+// Shown instead of a glyph when all CGRAM slots are taken
+const char glyph_fallback[GLYPH_COUNT] PROGMEM = {
+    'a', 'a', 'a', 'a', 'e', 'e', 'e', 'i', 'i', 'i', 'o', 'o', 'o', 'o', 'u', 'u', 'u', 'e', 'i', 'a', 'c', 'o', '?', '!', '*'
+};
+
+// Feed one byte. Returns the code point once a character is complete,
+// -1 while more bytes are needed, or 0xFFFD for a malformed sequence.
+int32_t Utf8Decoder::decodeMulti(uint8_t c) {
+    if(need) {
+        if((c & 0xC0) == 0x80) {
+            cp = (cp << 6) | (c & 0x3F);
+            return --need ? -1 : (int32_t)cp;
+        }
+        need = 0; // Truncated sequence, start over with this byte
+        if(c < 0x80) {
+            return 0xFFFD;
+        }
+    }
+    if(c < 0x80) {
+        return c;
+    } else if((c & 0xE0) == 0xC0) {
+        cp = c & 0x1F;
+        need = 1;
+    } else if((c & 0xF0) == 0xE0) {
+        cp = c & 0x0F;
+        need = 2;
+    } else if((c & 0xF8) == 0xF0) {
+        cp = c & 0x07;
+        need = 3;
+    } else {
+        return 0xFFFD;
+    }
+    return -1;
+}
+
+// Write the UTF-8 encoding of a code point (up to 4 bytes).
+// Returns its length.
+uint8_t utf8Encode(uint32_t cp, char* out) {
+    if(cp < 0x80) {
+        out[0] = cp;
+        return 1;
+    } else if(cp < 0x800) {
+        out[0] = 0xC0 | (cp >> 6);
+        out[1] = 0x80 | (cp & 0x3F);
+        return 2;
+    } else if(cp < 0x10000) {
+        out[0] = 0xE0 | (cp >> 12);
+        out[1] = 0x80 | ((cp >> 6) & 0x3F);
+        out[2] = 0x80 | (cp & 0x3F);
+        return 3;
+    }
+    out[0] = 0xF0 | (cp >> 18);
+    out[1] = 0x80 | ((cp >> 12) & 0x3F);
+    out[2] = 0x80 | ((cp >> 6) & 0x3F);
+    out[3] = 0x80 | (cp & 0x3F);
+    return 4;
+}
+
+// Write the display codes for a code point. Returns how many (1 or 2).
+uint8_t glyphEncode(uint32_t cp, uint8_t* out) {
+    if(cp < 0x80) {
+        out[0] = cp;
+        return 1;
+    }
+    size_t lo = 0;
+    size_t hi = sizeof(glyph_map) / sizeof(glyph_map[0]);
+    while(lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        uint16_t mid_cp = pgm_read_word(&glyph_map[mid].cp);
+        if(mid_cp == cp) {
+            out[0] = pgm_read_byte(&glyph_map[mid].code[0]);
+            out[1] = pgm_read_byte(&glyph_map[mid].code[1]);
+            return out[1] ? 2 : 1;
+        } else if(mid_cp < cp) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    out[0] = GLYPH_UNKNOWN;
+    return 1;
+}
+
+// Convert a NUL terminated UTF-8 string. The result is truncated to fit
+// and always NUL terminated. Returns its length.
+size_t glyphEncode(const char* utf8, char* out, size_t out_size) {
+    Utf8Decoder decoder;
+    size_t len = 0;
+    while(*utf8 && len + 1 < out_size) {
+        int32_t cp = decoder.decode(*utf8++);
+        if(cp >= 0) {
+            uint8_t codes[2];
+            uint8_t n = glyphEncode(cp, codes);
+            for(uint8_t i=0; i<n && len + 1 < out_size; i++) {
+                out[len++] = codes[i];
+            }
+        }
+    }
+    if(out_size) {
+        out[len] = '\0';
+    }
+    return len;
+}
+
+// Set of custom glyphs used by display text, bit n for GLYPH_BASE + n
+uint32_t glyphMask(const char* str, size_t len) {
+    uint32_t mask = 0;
+    for(size_t i=0; i<len; i++) {
+        uint8_t c = str[i];
+        if(c >= GLYPH_BASE && c < GLYPH_BASE + GLYPH_COUNT) {
+            mask |= (uint32_t)1 << (c - GLYPH_BASE);
+        }
+    }
+    return mask;
+}
+
+// Print display text as UTF-8, e.g. for the serial log.
+// Transliterated characters stay transliterated.
+size_t glyphPrint(Print& out, const char* str, size_t len) {
+    size_t n = 0;
+    for(size_t i=0; i<len; i++) {
+        uint8_t c = str[i];
+        uint16_t cp = c;
+        if(c >= 0x80) {
+            cp = 0xFFFD;
+            for(size_t j=0; j<sizeof(glyph_map) / sizeof(glyph_map[0]); j++) {
+                if(pgm_read_byte(&glyph_map[j].code[0]) == c && !pgm_read_byte(&glyph_map[j].code[1])) {
+                    cp = pgm_read_word(&glyph_map[j].cp);
+                    break;
+                }
+            }
+        }
+        char utf8[4];
+        n += out.write((const uint8_t*)utf8, utf8Encode(cp, utf8));
+    }
+    return n;
+}
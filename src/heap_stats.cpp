@@ -0,0 +1,104 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "heap_stats.h"
+
+#include <inttypes.h>
+
+typedef struct {
+    uint32_t free;          // Free heap bytes
+    uint32_t max_block;     // Largest allocatable block
+    uint8_t frag;           // Fragmentation, percent
+} HeapSample;
+
+static HeapSample last;
+static HeapSample worst = { UINT32_MAX, UINT32_MAX, 0 };
+static uint64_t uptime_ms = 0;  // Unlike millis(), doesn't wrap after 49 days
+static uint32_t sample_ms = 0;
+
+// Record the current heap state. Walks the heap, so call it every few
+// seconds rather than every loop.
+void heapSample() {
+    uint32_t now = millis();
+    uptime_ms += (uint32_t)(now - sample_ms);
+    sample_ms = now;
+    ESP.getHeapStats(&last.free, NULL, &last.frag);
+    last.max_block = ESP.getMaxFreeBlockSize();
+    if(last.free < worst.free) {
+        worst.free = last.free;
+    }
+    if(last.max_block < worst.max_block) {
+        worst.max_block = last.max_block;
+    }
+    if(last.frag > worst.frag) {
+        worst.frag = last.frag;
+    }
+}
+
+static void printGauge(Print& out, const __FlashStringHelper* name, const __FlashStringHelper* help, uint32_t now, uint32_t min_val) {
+    out.print(F("# HELP "));
+    out.print(name);
+    out.print(' ');
+    out.print(help);
+    out.print('\n');
+    out.print(F("# TYPE "));
+    out.print(name);
+    out.print(F(" gauge\n"));
+    out.print(name);
+    out.print(' ');
+    out.print(now);
+    out.print('\n');
+    out.print(name);
+    out.print(F("{stat=\"worst\"} "));
+    out.print(min_val);
+    out.print('\n');
+}
+
+void heapPrintMetrics(Print& out) {
+    heapSample();
+    printGauge(out, F("karaoke_heap_free_bytes"), F("Free heap"), last.free, worst.free);
+    printGauge(out, F("karaoke_heap_max_block_bytes"), F("Largest free heap block"), last.max_block, worst.max_block);
+    printGauge(out, F("karaoke_heap_fragmentation_percent"), F("Heap fragmentation"), last.frag, worst.frag);
+    out.print(F("# HELP karaoke_uptime_seconds Time since boot\n"
+                "# TYPE karaoke_uptime_seconds counter\n"
+                "karaoke_uptime_seconds "));
+    out.print((uint32_t)(uptime_ms / 1000));
+    out.print('\n');
+}
+
+void heapPrintSummary(Print& out) {
+    out.print(F("Heap: free "));
+    out.print(last.free);
+    out.print(F(" (min "));
+    out.print(worst.free);
+    out.print(F("), max block "));
+    out.print(last.max_block);
+    out.print(F(" (min "));
+    out.print(worst.max_block);
+    out.print(F("), frag "));
+    out.print(last.frag);
+    out.print(F("% (max "));
+    out.print(worst.frag);
+    out.println(F("%)"));
+}
@@ -0,0 +1,259 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "http_stream.h"
+
+#include <inttypes.h>
+
+enum {
+    COOKIE_NONE,
+    COOKIE_START,       // Skipping spaces before the name=value pair
+    COOKIE_VALUE,
+    COOKIE_ATTRIBUTES   // Path, Expires etc. are not sent back
+};
+
+HttpBodyStream::HttpBodyStream(Client& client) : client(client) {
+    cookies = NULL;
+    begin();
+    state = BODY_DONE;
+}
+
+// Prepare to read a new response
+void HttpBodyStream::begin() {
+    state = HEADER;
+    status = 0;
+    keep_alive = false;
+    chunked = false;
+    gzip = false;
+    has_length = false;
+    first_line = true;
+    line_empty = true;
+    cookie_state = COOKIE_NONE;
+    line_len = 0;
+    peeked = -1;
+    remaining = 0;
+}
+
+// Handle a complete header line. Only the start of each line is kept,
+// which is enough for the headers we care about.
+void HttpBodyStream::headerLine() {
+    line[line_len] = '\0';
+    if(first_line) {
+        first_line = false;
+        if(!strncmp_P(line, PSTR("http/1."), 7) && line_len > 9) {
+            status = atoi(line + 9);
+            keep_alive = line[7] == '1'; // HTTP/1.1 defaults to keep-alive
+        }
+    } else if(line_len == 0) {
+        // End of header
+        if(status == 204 || status == 304 || (status >= 100 && status < 200)) {
+            state = BODY_DONE;
+        } else if(chunked) {
+            // Chunked framing overrides any Content-Length (RFC 7230 3.3.3)
+            remaining = 0;
+            has_length = false;
+            state = CHUNK_SIZE;
+        } else if(has_length) {
+            state = remaining ? BODY_LENGTH : BODY_DONE;
+        } else {
+            state = BODY_UNTIL_CLOSE;
+            keep_alive = false;
+        }
+    } else if(!strncmp_P(line, PSTR("content-length:"), 15)) {
+        remaining = strtoul(line + 15, NULL, 10);
+        has_length = true;
+    } else if(!strncmp_P(line, PSTR("transfer-encoding:"), 18)) {
+        chunked = strstr_P(line + 18, PSTR("chunked")) != NULL;
+    } else if(!strncmp_P(line, PSTR("content-encoding:"), 17)) {
+        gzip = strstr_P(line + 17, PSTR("gzip")) != NULL;
+    } else if(!strncmp_P(line, PSTR("connection:"), 11)) {
+        keep_alive = strstr_P(line + 11, PSTR("close")) == NULL;
+    }
+    line_len = 0;
+    cookie_state = COOKIE_NONE;
+}
+
+// Consume whatever header bytes have arrived without blocking.
+// Returns -1 until the header is complete, then the HTTP status code
+// (0 if the status line was malformed).
+int HttpBodyStream::parseHeaders() {
+    while(state == HEADER && client.available()) {
+        int c = client.read();
+        if(c == '\n') {
+            headerLine();
+            continue;
+        } else if(c == '\r' || c < 0) {
+            continue;
+        }
+        switch(cookie_state) {
+            case COOKIE_START:
+                if(c == ' ') {
+                    break;
+                }
+                cookie_state = COOKIE_VALUE;
+                // fall through
+            case COOKIE_VALUE:
+                if(c == ';') {
+                    cookie_state = COOKIE_ATTRIBUTES;
+                } else {
+                    *cookies += (char)c;
+                }
+                break;
+            case COOKIE_ATTRIBUTES:
+                break;
+            default:
+                if(line_len < HTTP_LINE_MAX - 1) {
+                    line[line_len++] = tolower(c);
+                    if(cookies && line_len == 11 && !strncmp_P(line, PSTR("set-cookie:"), 11)) {
+                        if(cookies->length()) {
+                            *cookies += F("; ");
+                        }
+                        cookie_state = COOKIE_START;
+                    }
+                }
+                break;
+        }
+    }
+    return state == HEADER ? -1 : status;
+}
+
+// Wait for the response and parse the status line and headers.
+// Returns the HTTP status code, or 0 on timeout or error.
+int HttpBodyStream::readHeaders(unsigned long timeout_ms) {
+    begin();
+    unsigned long req_start = millis();
+    int ret_code;
+    while((ret_code = parseHeaders()) < 0) {
+        if(millis() - req_start > timeout_ms || (!client.connected() && !client.available())) {
+            state = BODY_DONE;
+            return 0;
+        }
+        delay(1);
+    }
+    return ret_code;
+}
+
+bool HttpBodyStream::done() {
+    if(state == BODY_UNTIL_CLOSE && peeked < 0 && !client.connected() && !client.available()) {
+        state = BODY_DONE;
+    }
+    return state == BODY_DONE && peeked < 0;
+}
+
+// Consume one byte from the connection. Returns the byte if it belongs to
+// the body, or -1 if it was part of the message framing.
+int HttpBodyStream::frame(int c) {
+    switch(state) {
+        case BODY_LENGTH:
+            if(--remaining == 0) {
+                state = BODY_DONE;
+            }
+            return c;
+        case BODY_UNTIL_CLOSE:
+            return c;
+        case CHUNK_SIZE:
+            if(isxdigit(c)) {
+                remaining = (remaining << 4) | (isdigit(c) ? c - '0' : (c | 0x20) - 'a' + 10);
+                break;
+            } else if(c != '\n') {
+                if(c != '\r') state = CHUNK_EXT;
+                break;
+            }
+            // fall through
+        case CHUNK_EXT:
+            if(c == '\n') {
+                if(remaining) {
+                    state = CHUNK_DATA;
+                } else {
+                    state = CHUNK_TRAILER;
+                    line_empty = true;
+                }
+            }
+            break;
+        case CHUNK_DATA:
+            if(--remaining == 0) {
+                state = CHUNK_DATA_END;
+            }
+            return c;
+        case CHUNK_DATA_END:
+            if(c == '\n') {
+                state = CHUNK_SIZE;
+                remaining = 0;
+            }
+            break;
+        case CHUNK_TRAILER:
+            if(c == '\n') {
+                if(line_empty) {
+                    state = BODY_DONE;
+                }
+                line_empty = true;
+            } else if(c != '\r') {
+                line_empty = false;
+            }
+            break;
+        default:
+            break;
+    }
+    return -1;
+}
+
+int HttpBodyStream::fill() {
+    while(state > HEADER && state != BODY_DONE && client.available()) {
+        int c = frame(client.read());
+        if(c >= 0) {
+            return c;
+        }
+    }
+    return -1;
+}
+
+int HttpBodyStream::available() {
+    if(peeked >= 0) {
+        return 1;
+    }
+    if(state == HEADER || state == BODY_DONE) {
+        return 0;
+    }
+    int avail = client.available();
+    if(state == BODY_LENGTH && (uint32_t)avail > remaining) {
+        avail = remaining;
+    }
+    return avail;
+}
+
+int HttpBodyStream::read() {
+    int c = peeked;
+    if(c >= 0) {
+        peeked = -1;
+        return c;
+    }
+    return fill();
+}
+
+int HttpBodyStream::peek() {
+    if(peeked < 0) {
+        peeked = fill();
+    }
+    return peeked;
+}
@@ -0,0 +1,495 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "inflate.h"
+
+#include <stdlib.h>
+
+enum {
+    GZ_MAGIC,
+    GZ_METHOD,
+    GZ_FLAGS,
+    GZ_SKIP,            // Fixed fields or FEXTRA, remaining bytes
+    GZ_EXTRA_LENGTH,
+    GZ_STRING,          // FNAME or FCOMMENT, up to a NUL
+    GZ_HEADER_CRC,
+    BLOCK,
+    STORED_LENGTH,
+    STORED_CHECK,       // One's complement of the length
+    STORED_DATA,
+    TABLE_SIZES,
+    TABLE_CODE_LENGTHS,
+    TABLE_LENGTHS,
+    TABLE_REPEAT,       // Extra bits of a repeat code (symbol)
+    CODES,
+    LENGTH_EXTRA,
+    DISTANCE,
+    DISTANCE_EXTRA,
+    TRAILER,            // CRC and size, remaining is the byte index
+    DONE,
+    FAILED
+};
+
+#define GZ_FHCRC        0x02
+#define GZ_FEXTRA       0x04
+#define GZ_FNAME        0x08
+#define GZ_FCOMMENT     0x10
+
+// Every step needs at most 16 bits, so a stalled step leaves room in
+// bitbuf for another byte
+#define NEED(n)         do { if(bitcount < (n)) return false; } while(0)
+#define BITS(n)         (bitbuf & ((1UL << (n)) - 1))
+#define DROP(n)         do { bitbuf >>= (n); bitcount -= (n); } while(0)
+
+static const uint16_t length_base[29] PROGMEM = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t length_extra[29] PROGMEM = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t distance_base[30] PROGMEM = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t distance_extra[30] PROGMEM = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const uint8_t code_length_order[19] PROGMEM = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// CRC-32 four bits at a time, to keep the table small
+static const uint32_t crc_table[16] PROGMEM = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+GzipInflater::GzipInflater() {
+    out = NULL;
+    mem = NULL;
+    running = false;
+    state = DONE;
+    err = INFLATE_OK;
+    in_count = out_count = 0;
+}
+
+GzipInflater::~GzipInflater() {
+    release();
+}
+
+bool GzipInflater::reserve() {
+    if(!mem) {
+        mem = (State*)malloc(sizeof(State));
+    }
+    return mem != NULL;
+}
+
+bool GzipInflater::begin(Print* sink) {
+    out = sink;
+    err = INFLATE_OK;
+    in_count = out_count = 0;
+    running = false;
+    if(!reserve()) {
+        fail(INFLATE_ERROR_MEMORY);
+        return false;
+    }
+    running = true;
+    state = GZ_MAGIC;
+    flags = 0;
+    last_block = false;
+    bitbuf = 0;
+    bitcount = 0;
+    crc = 0xFFFFFFFF;
+    remaining = 0;
+    return true;
+}
+
+void GzipInflater::end() {
+    running = false;
+}
+
+void GzipInflater::release() {
+    end();
+    free(mem);
+    mem = NULL;
+}
+
+bool GzipInflater::finish() {
+    bool ok = state == DONE;
+    if(!ok && state != FAILED) {
+        err = INFLATE_ERROR_TRUNCATED;
+    }
+    end();
+    return ok;
+}
+
+size_t GzipInflater::write(uint8_t c) {
+    if(!running || state >= DONE) {
+        return 0;
+    }
+    bitbuf |= (uint32_t)c << bitcount;
+    bitcount += 8;
+    in_count++;
+    while(step());
+    return state == FAILED ? 0 : 1;
+}
+
+size_t GzipInflater::write(const uint8_t* buf, size_t len) {
+    size_t n = 0;
+    while(n < len && write(buf[n])) {
+        n++;
+    }
+    return n;
+}
+
+bool GzipInflater::fail(uint8_t code) {
+    err = code;
+    state = FAILED;
+    return false;
+}
+
+void GzipInflater::put(uint8_t c) {
+    mem->window[out_count & (INFLATE_WINDOW - 1)] = c;
+    out_count++;
+    crc ^= c;
+    crc = (crc >> 4) ^ pgm_read_dword(&crc_table[crc & 15]);
+    crc = (crc >> 4) ^ pgm_read_dword(&crc_table[crc & 15]);
+    out->write(c);
+}
+
+// Canonical Huffman code from code lengths. Incomplete codes are allowed
+// (e.g. a single distance code); over-subscribed ones are not.
+bool GzipInflater::build(Huffman& h, const uint8_t* lengths, uint16_t n) {
+    uint16_t offsets[16];
+    memset(h.count, 0, sizeof(h.count));
+    for(uint16_t i=0; i<n; i++) {
+        h.count[lengths[i]]++;
+    }
+    int left = 1;
+    for(uint8_t len=1; len<16; len++) {
+        left = (left << 1) - h.count[len];
+        if(left < 0) {
+            return false;
+        }
+    }
+    offsets[1] = 0;
+    for(uint8_t len=1; len<15; len++) {
+        offsets[len + 1] = offsets[len] + h.count[len];
+    }
+    for(uint16_t i=0; i<n; i++) {
+        if(lengths[i]) {
+            h.symbol[offsets[lengths[i]]++] = i;
+        }
+    }
+    return true;
+}
+
+// Decode one symbol. Returns -1 (consuming nothing) if more bits are
+// needed, or -2 if the bits aren't a code.
+int GzipInflater::decode(const Huffman& h) {
+    int code = 0;
+    int first = 0;
+    int index = 0;
+    for(uint8_t len=1; len<16; len++) {
+        if(len > bitcount) {
+            return -1;
+        }
+        code |= (bitbuf >> (len - 1)) & 1;
+        int count = h.count[len];
+        if(code - first < count) {
+            DROP(len);
+            return h.symbol[index + code - first];
+        }
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return -2;
+}
+
+// Move on to the next optional gzip header field, or the first block
+bool GzipInflater::nextHeaderField() {
+    if(flags & GZ_FEXTRA) {
+        flags &= ~GZ_FEXTRA;
+        state = GZ_EXTRA_LENGTH;
+    } else if(flags & (GZ_FNAME | GZ_FCOMMENT)) {
+        flags &= flags & GZ_FNAME ? ~GZ_FNAME : ~GZ_FCOMMENT;
+        state = GZ_STRING;
+    } else if(flags & GZ_FHCRC) {
+        flags &= ~GZ_FHCRC;
+        state = GZ_HEADER_CRC;
+    } else {
+        state = BLOCK;
+    }
+    return true;
+}
+
+// Build the codes of a dynamic block from the lengths just read
+bool GzipInflater::startTables() {
+    if(!mem->lengths[256] || !build(mem->lencode, mem->lengths, nlen) ||
+       !build(mem->distcode, mem->lengths + nlen, ndist)) {
+        return fail(INFLATE_ERROR_DATA);
+    }
+    state = CODES;
+    return true;
+}
+
+// Decode as far as the buffered bits allow. Returns false when stalled.
+bool GzipInflater::step() {
+    switch(state) {
+        case GZ_MAGIC:
+            NEED(16);
+            if(BITS(16) != 0x8B1F) {
+                return fail(INFLATE_ERROR_HEADER);
+            }
+            DROP(16);
+            state = GZ_METHOD;
+            return true;
+        case GZ_METHOD:
+            NEED(8);
+            if(BITS(8) != 8) { // DEFLATE
+                return fail(INFLATE_ERROR_HEADER);
+            }
+            DROP(8);
+            state = GZ_FLAGS;
+            return true;
+        case GZ_FLAGS:
+            NEED(8);
+            flags = BITS(8);
+            DROP(8);
+            remaining = 6; // Time, extra flags, OS
+            state = GZ_SKIP;
+            return true;
+        case GZ_SKIP:
+            if(!remaining) {
+                return nextHeaderField();
+            }
+            NEED(8);
+            DROP(8);
+            remaining--;
+            return true;
+        case GZ_EXTRA_LENGTH:
+            NEED(16);
+            remaining = BITS(16);
+            DROP(16);
+            state = GZ_SKIP;
+            return true;
+        case GZ_STRING: {
+            NEED(8);
+            bool end = !BITS(8);
+            DROP(8);
+            return end ? nextHeaderField() : true;
+        }
+        case GZ_HEADER_CRC:
+            NEED(16);
+            DROP(16);
+            return nextHeaderField();
+        case BLOCK: {
+            NEED(3);
+            last_block = BITS(1);
+            uint8_t type = (bitbuf >> 1) & 3;
+            DROP(3);
+            if(type == 0) {
+                DROP(bitcount & 7);
+                state = STORED_LENGTH;
+            } else if(type == 1) {
+                uint8_t* lengths = mem->lengths;
+                memset(lengths, 8, 144);
+                memset(lengths + 144, 9, 112);
+                memset(lengths + 256, 7, 24);
+                memset(lengths + 280, 8, 8);
+                build(mem->lencode, lengths, 288);
+                memset(lengths, 5, 30);
+                build(mem->distcode, lengths, 30);
+                state = CODES;
+            } else if(type == 2) {
+                state = TABLE_SIZES;
+            } else {
+                return fail(INFLATE_ERROR_DATA);
+            }
+            return true;
+        }
+        case STORED_LENGTH:
+            NEED(16);
+            remaining = BITS(16);
+            DROP(16);
+            state = STORED_CHECK;
+            return true;
+        case STORED_CHECK:
+            NEED(16);
+            if((uint16_t)~BITS(16) != remaining) {
+                return fail(INFLATE_ERROR_DATA);
+            }
+            DROP(16);
+            state = STORED_DATA;
+            return true;
+        case STORED_DATA:
+            if(!remaining) {
+                state = last_block ? TRAILER : BLOCK;
+                return true;
+            }
+            NEED(8);
+            put(BITS(8));
+            DROP(8);
+            remaining--;
+            return true;
+        case TABLE_SIZES:
+            NEED(14);
+            nlen = BITS(5) + 257;
+            DROP(5);
+            ndist = BITS(5) + 1;
+            DROP(5);
+            ncode = BITS(4) + 4;
+            DROP(4);
+            if(nlen > 286 || ndist > 30) {
+                return fail(INFLATE_ERROR_DATA);
+            }
+            nlens = 0;
+            state = TABLE_CODE_LENGTHS;
+            return true;
+        case TABLE_CODE_LENGTHS: {
+            if(nlens == 19) {
+                if(!build(mem->distcode, mem->lengths, 19)) {
+                    return fail(INFLATE_ERROR_DATA);
+                }
+                nlens = 0;
+                state = TABLE_LENGTHS;
+                return true;
+            }
+            uint8_t len = 0;
+            if(nlens < ncode) {
+                NEED(3);
+                len = BITS(3);
+                DROP(3);
+            }
+            mem->lengths[pgm_read_byte(&code_length_order[nlens++])] = len;
+            return true;
+        }
+        case TABLE_LENGTHS: {
+            if(nlens == nlen + ndist) {
+                return startTables();
+            }
+            int sym = decode(mem->distcode);
+            if(sym == -1) {
+                return false;
+            } else if(sym < 0 || (sym == 16 && !nlens)) {
+                return fail(INFLATE_ERROR_DATA);
+            } else if(sym < 16) {
+                mem->lengths[nlens++] = sym;
+            } else {
+                symbol = sym;
+                state = TABLE_REPEAT;
+            }
+            return true;
+        }
+        case TABLE_REPEAT: {
+            uint8_t n = symbol == 16 ? 2 : symbol == 17 ? 3 : 7;
+            NEED(n);
+            uint16_t repeat = BITS(n) + (symbol == 18 ? 11 : 3);
+            DROP(n);
+            uint8_t len = symbol == 16 ? mem->lengths[nlens - 1] : 0;
+            if(nlens + repeat > nlen + ndist) {
+                return fail(INFLATE_ERROR_DATA);
+            }
+            memset(mem->lengths + nlens, len, repeat);
+            nlens += repeat;
+            state = TABLE_LENGTHS;
+            return true;
+        }
+        case CODES: {
+            int sym = decode(mem->lencode);
+            if(sym == -1) {
+                return false;
+            } else if(sym < 0 || sym > 285) {
+                return fail(INFLATE_ERROR_DATA);
+            } else if(sym < 256) {
+                put(sym);
+            } else if(sym == 256) {
+                if(last_block) {
+                    DROP(bitcount & 7);
+                    remaining = 0;
+                    state = TRAILER;
+                } else {
+                    state = BLOCK;
+                }
+            } else {
+                symbol = sym - 257;
+                state = LENGTH_EXTRA;
+            }
+            return true;
+        }
+        case LENGTH_EXTRA: {
+            uint8_t n = pgm_read_byte(&length_extra[symbol]);
+            NEED(n);
+            length = pgm_read_word(&length_base[symbol]) + BITS(n);
+            DROP(n);
+            state = DISTANCE;
+            return true;
+        }
+        case DISTANCE: {
+            int sym = decode(mem->distcode);
+            if(sym == -1) {
+                return false;
+            } else if(sym < 0 || sym > 29) {
+                return fail(INFLATE_ERROR_DATA);
+            }
+            symbol = sym;
+            state = DISTANCE_EXTRA;
+            return true;
+        }
+        case DISTANCE_EXTRA: {
+            uint8_t n = pgm_read_byte(&distance_extra[symbol]);
+            NEED(n);
+            uint32_t distance = pgm_read_word(&distance_base[symbol]) + BITS(n);
+            DROP(n);
+            if(distance > out_count) {
+                return fail(INFLATE_ERROR_DATA);
+            } else if(distance > INFLATE_WINDOW) {
+                return fail(INFLATE_ERROR_WINDOW);
+            }
+            for(; length; length--) {
+                put(mem->window[(out_count - distance) & (INFLATE_WINDOW - 1)]);
+            }
+            state = CODES;
+            return true;
+        }
+        case TRAILER: {
+            NEED(8);
+            uint32_t expect = remaining < 4 ? ~crc : out_count;
+            if(BITS(8) != ((expect >> (remaining % 4 * 8)) & 0xFF)) {
+                return fail(INFLATE_ERROR_CHECKSUM);
+            }
+            DROP(8);
+            if(++remaining == 8) {
+                state = DONE;
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
@@ -0,0 +1,396 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "json_fields.h"
+#include "glyphs.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+static bool isSpace(uint8_t c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+// Reset the fields and start a new document
+void JsonFieldExtractor::begin() {
+    for(uint8_t i=0; i<field_count; i++) {
+        const JsonField& f = fields[i];
+        switch(f.type) {
+            case JSON_FIELD_STRING:
+            case JSON_FIELD_LIST: ((char*)f.value)[0] = '\0'; break;
+            case JSON_FIELD_UINT: *(unsigned int*)f.value = 0; break;
+            case JSON_FIELD_BOOL: *(bool*)f.value = false; break;
+        }
+    }
+    depth = 0;
+    end_depth = 0xFF;
+    arrays = 0;
+    path_len = 0;
+    path_overflow = false;
+    surrogate = 0;
+    state = STATE_VALUE;
+    enterValue();
+}
+
+// Match the path of the value about to start against the fields.
+// Returns false if nothing can match inside it, so it can be skipped.
+bool JsonFieldExtractor::enterValue() {
+    match = 0;
+    if(path_overflow) {
+        return false;
+    }
+    bool wanted = false;
+    for(uint8_t i=0; i<field_count; i++) {
+        const char* p = fields[i].path;
+        if(strncmp(p, path, path_len)) {
+            continue;
+        }
+        char next = p[path_len];
+        if(next == '\0' && fields[i].type == JSON_FIELD_END) {
+            end_depth = depth;
+        } else if(next == '\0') {
+            match |= 1 << i;
+            wanted = true;
+        } else if(path_len == 0 || next == '.' || next == '[') {
+            wanted = true;
+        }
+    }
+    return wanted;
+}
+
+void JsonFieldExtractor::push(bool array) {
+    if(depth == JSON_DEPTH_MAX) {
+        // Too deep to track, skip the whole container
+        state = STATE_SKIP;
+        skip_depth = 1;
+        skip_string = false;
+        return;
+    }
+    if(array) {
+        if(path_len + 2 < JSON_PATH_MAX) {
+            path[path_len++] = '[';
+            path[path_len++] = ']';
+        } else {
+            path_overflow = true;
+        }
+        arrays |= 1 << depth;
+    } else {
+        arrays &= ~(1 << depth);
+    }
+    base[depth++] = path_len;
+    state = array ? STATE_ARRAY_START : STATE_KEY_START;
+}
+
+void JsonFieldExtractor::pop() {
+    depth--;
+    path_len = depth ? base[depth-1] : 0;
+    path_overflow = false;
+    state = depth ? STATE_NEXT : STATE_DONE;
+}
+
+// Skip the value about to start
+void JsonFieldExtractor::skip() {
+    state = STATE_SKIP;
+    skip_depth = 0;
+    skip_string = false;
+}
+
+void JsonFieldExtractor::startString() {
+    str_full = 0;
+    for(uint8_t i=0; i<field_count; i++) {
+        if(!(match & (1 << i))) {
+            continue;
+        }
+        const JsonField& f = fields[i];
+        const char* buf = (const char*)f.value;
+        if(f.type == JSON_FIELD_LIST) {
+            str_len[i] = strlen(buf);
+        } else if(f.type == JSON_FIELD_STRING && !buf[0]) {
+            str_len[i] = 0;
+        } else {
+            match &= ~(1 << i); // Not a string, or already set
+        }
+    }
+    // Separate list entries
+    for(uint8_t i=0; i<field_count; i++) {
+        if((match & (1 << i)) && str_len[i]) {
+            putString(i, ", ", 2);
+        }
+    }
+    state = STATE_STRING;
+}
+
+// Append to a string field if all of str fits. Once something doesn't
+// fit, the rest of the value is dropped so no partial character follows.
+void JsonFieldExtractor::putString(uint8_t i, const char* str, uint8_t len) {
+    if(str_full & (1 << i)) {
+        return;
+    }
+    const JsonField& f = fields[i];
+    if(str_len[i] + len >= f.size) {
+        str_full |= 1 << i;
+        return;
+    }
+    char* buf = (char*)f.value;
+    memcpy(buf + str_len[i], str, len);
+    str_len[i] += len;
+    buf[str_len[i]] = '\0';
+}
+
+void JsonFieldExtractor::putChar(char c) {
+    for(uint8_t i=0; match >> i; i++) {
+        if(match & (1 << i)) {
+            putString(i, &c, 1);
+        }
+    }
+}
+
+void JsonFieldExtractor::putCodepoint(uint32_t cp) {
+    char utf8[4];
+    uint8_t len = utf8Encode(cp, utf8);
+    for(uint8_t i=0; match >> i; i++) {
+        if(match & (1 << i)) {
+            putString(i, utf8, len);
+        }
+    }
+}
+
+void JsonFieldExtractor::endLiteral() {
+    for(uint8_t i=0; match >> i; i++) {
+        if(!(match & (1 << i))) {
+            continue;
+        }
+        const JsonField& f = fields[i];
+        if(f.type == JSON_FIELD_UINT && literal >= '0' && literal <= '9') {
+            *(unsigned int*)f.value = number;
+        } else if(f.type == JSON_FIELD_BOOL) {
+            *(bool*)f.value = literal == 't';
+        }
+    }
+    state = STATE_NEXT;
+}
+
+size_t JsonFieldExtractor::write(const uint8_t* buf, size_t len) {
+    for(size_t i=0; i<len && state < STATE_DONE; i++) {
+        write(buf[i]);
+    }
+    return len;
+}
+
+size_t JsonFieldExtractor::write(uint8_t c) {
+    switch(state) {
+        case STATE_SKIP:
+            if(skip_string) {
+                if(skip_escape) {
+                    skip_escape = false;
+                } else if(c == '\\') {
+                    skip_escape = true;
+                } else if(c == '"') {
+                    skip_string = false;
+                    if(!skip_depth) {
+                        state = STATE_NEXT;
+                    }
+                }
+            } else if(c == '"') {
+                skip_string = true;
+                skip_escape = false;
+            } else if(c == '{' || c == '[') {
+                skip_depth++;
+            } else if(c == '}' || c == ']') {
+                if(!skip_depth) {
+                    state = STATE_ERROR; // Closing bracket where a value should be
+                    break;
+                }
+                if(!--skip_depth) {
+                    state = STATE_NEXT;
+                }
+            } else if(!skip_depth && !isSpace(c)) {
+                // A number or literal, which ends at the next delimiter
+                match = 0;
+                literal = c;
+                state = STATE_LITERAL;
+            }
+            break;
+        case STATE_ARRAY_START:
+            if(isSpace(c)) {
+                break;
+            }
+            if(c == ']') {
+                pop();
+                break;
+            }
+            state = STATE_VALUE;
+            if(!enterValue()) {
+                skip();
+                return write(c);
+            }
+            // fall through
+        case STATE_VALUE:
+            if(c == '{') {
+                push(false);
+            } else if(c == '[') {
+                push(true);
+            } else if(c == '"') {
+                startString();
+            } else if(!isSpace(c)) {
+                literal = c;
+                number = (c >= '0' && c <= '9') ? c - '0' : 0;
+                number_done = false;
+                state = STATE_LITERAL;
+            }
+            break;
+        case STATE_KEY_START:
+            if(c == '"') {
+                if(path_len) {
+                    if(path_len + 1 < JSON_PATH_MAX) {
+                        path[path_len++] = '.';
+                    } else {
+                        path_overflow = true;
+                    }
+                }
+                state = STATE_KEY;
+            } else if(c == '}') {
+                pop();
+            } else if(!isSpace(c)) {
+                state = STATE_ERROR;
+            }
+            break;
+        case STATE_KEY:
+            if(c == '"') {
+                state = STATE_COLON;
+                break;
+            } else if(c == '\\') {
+                state = STATE_KEY_ESCAPE;
+                break;
+            }
+            // fall through
+        case STATE_KEY_ESCAPE:
+            if(path_len + 1 < JSON_PATH_MAX) {
+                path[path_len++] = c;
+            } else {
+                path_overflow = true;
+            }
+            if(state == STATE_KEY_ESCAPE) {
+                state = STATE_KEY;
+            }
+            break;
+        case STATE_COLON:
+            if(c == ':') {
+                if(enterValue()) {
+                    state = STATE_VALUE;
+                } else {
+                    skip();
+                }
+            } else if(!isSpace(c)) {
+                state = STATE_ERROR;
+            }
+            break;
+        case STATE_STRING:
+            if(c == '"') {
+                state = STATE_NEXT;
+            } else if(c == '\\') {
+                state = STATE_ESCAPE;
+            } else {
+                putChar(c);
+            }
+            break;
+        case STATE_ESCAPE:
+            state = STATE_STRING;
+            switch(c) {
+                case 'n': putChar('\n'); break;
+                case 't': putChar('\t'); break;
+                case 'r':
+                case 'b':
+                case 'f': break;
+                case 'u':
+                    hex = 0;
+                    hex_len = 0;
+                    state = STATE_UNICODE;
+                    break;
+                default: putChar(c); break; // \" \\ \/
+            }
+            break;
+        case STATE_UNICODE:
+            hex <<= 4;
+            if(c >= '0' && c <= '9') hex |= c - '0';
+            else if(c >= 'a' && c <= 'f') hex |= c - 'a' + 10;
+            else if(c >= 'A' && c <= 'F') hex |= c - 'A' + 10;
+            if(++hex_len == 4) {
+                state = STATE_STRING;
+                if(hex >= 0xD800 && hex < 0xDC00) {
+                    surrogate = hex;
+                } else if(hex >= 0xDC00 && hex < 0xE000) {
+                    if(surrogate) {
+                        putCodepoint(0x10000 + ((uint32_t)(surrogate - 0xD800) << 10) + (hex - 0xDC00));
+                    }
+                    surrogate = 0;
+                } else {
+                    putCodepoint(hex);
+                }
+            }
+            break;
+        case STATE_LITERAL:
+            if(c == ',' || c == '}' || c == ']' || isSpace(c)) {
+                endLiteral();
+                return write(c);
+            }
+            if(c >= '0' && c <= '9') {
+                if(!number_done) {
+                    number = number * 10 + (c - '0');
+                }
+            } else {
+                number_done = true; // Fraction or exponent
+            }
+            break;
+        case STATE_NEXT:
+            if(depth == end_depth) {
+                state = STATE_DONE; // The rest isn't wanted
+            } else if(c == ',') {
+                if(!depth) {
+                    state = STATE_ERROR;
+                } else if(arrays & (1 << (depth-1))) {
+                    state = STATE_VALUE;
+                    if(!enterValue()) {
+                        skip();
+                    }
+                } else {
+                    path_len = base[depth-1];
+                    path_overflow = false;
+                    state = STATE_KEY_START;
+                }
+            } else if(c == '}' || c == ']') {
+                if(!depth || (c == ']') != !!(arrays & (1 << (depth-1)))) {
+                    state = STATE_ERROR;
+                } else {
+                    pop();
+                }
+            } else if(!isSpace(c)) {
+                state = STATE_ERROR;
+            }
+            break;
+        default:
+            break;
+    }
+    return 1;
+}
@@ -23,14 +23,40 @@ SOFTWARE.
 */
 
 #include "lcd2004.h"
+#include "profiler.h"
 
 #include <inttypes.h>
 
+// Queue entry flags
+#define LCD_QUEUE_CMD           0x100   // RS low
+#define LCD_QUEUE_LONG          0x200   // Clear/home execution time
+
+#define TIMER1_TICKS_PER_US     5       // TIM_DIV16 at 80 MHz
+
+static const uint8_t row_addrs[] = { 0x00, 0x40, 0x14, 0x54 }; // For regular LCDs
+
+static LCD2004* pump_lcd = NULL;
+
 LCD2004::LCD2004(uint8_t rs) {
     rs_pin = rs;
+    addr = 0;
+    cursor_addr = LCD_CURSOR_OFF;
+    async = false;
+    pump_running = false;
+    q_head = q_tail = 0;
+    memset(shadow, ' ', sizeof(shadow));
+    memset(frame, ' ', sizeof(frame));
+    glyph_bitmaps = NULL;
+    glyph_fallbacks = NULL;
+    glyph_base = 0;
+    glyph_count = 0;
+    memset(glyph_slot, LCD_GLYPH_NONE, sizeof(glyph_slot));
+    memset(slot_glyph, LCD_GLYPH_NONE, sizeof(slot_glyph));
+    memset(slot_used, 0, sizeof(slot_used));
+    flush_count = 0;
 }
 
-void LCD2004::begin() {
+void LCD2004::begin(bool use_async) {
     delay(DELAY_MS_POR);
     pinMode(rs_pin, OUTPUT);
     pinMode(16, OUTPUT);
@@ -69,22 +95,63 @@ void LCD2004::begin() {
 
     cmd(0x06); // Entry mode auto-increment
     delayMicroseconds(DELAY_US_DATA_COMMAND);
+
+    if(use_async) {
+        pump_lcd = this;
+        timer1_isr_init();
+        timer1_attachInterrupt(pumpISR);
+        timer1_enable(TIM_DIV16, TIM_EDGE, TIM_SINGLE);
+        async = true;
+    }
 }
 
 void LCD2004::clear() {
-    cmd(0x01);
-    delayMicroseconds(DELAY_US_LONG_COMMAND);
+    noCursor();
+    send(0x01 | LCD_QUEUE_CMD | LCD_QUEUE_LONG);
+    memset(shadow, ' ', sizeof(shadow));
+    addr = 0;
 }
 
 void LCD2004::cmd(uint8_t val) {
-    GPOC = (1 << rs_pin);
-    delayMicroseconds(DELAY_US_SETUP_HOLD);
-    write(val);
-    GPOS = (1 << rs_pin);
-    delayMicroseconds(DELAY_US_DATA_COMMAND);
+    send(val | LCD_QUEUE_CMD);
 }
 
 size_t IRAM_ATTR LCD2004::write(uint8_t val) {
+    send(glyphCode(val));
+    // Track the DDRAM address the same way the controller does.
+    // Rows 0 and 2 share 0x00-0x27, rows 1 and 3 share 0x40-0x67.
+    uint8_t base = addr & 0x40;
+    uint8_t offset = addr & 0x3F;
+    if(offset < 2 * LCD_COLS) {
+        shadow[(base ? 1 : 0) + (offset >= LCD_COLS ? 2 : 0)][offset % LCD_COLS] = val;
+    }
+    if(++offset == 0x28) {
+        addr = base ^ 0x40;
+    } else {
+        addr = base | offset;
+    }
+    return 1;
+}
+
+// Send a byte with LCD_QUEUE_* flags, either directly or via the queue
+void IRAM_ATTR LCD2004::send(uint16_t val) {
+    if(async) {
+        enqueue(val);
+        return;
+    }
+    if(val & LCD_QUEUE_CMD) {
+        GPOC = (1 << rs_pin);
+        delayMicroseconds(DELAY_US_SETUP_HOLD);
+        sendNibbles(val);
+        GPOS = (1 << rs_pin);
+        delayMicroseconds(DELAY_US_DATA_COMMAND);
+    } else {
+        sendNibbles(val);
+    }
+    delayMicroseconds((val & LCD_QUEUE_LONG) ? DELAY_US_LONG_COMMAND : DELAY_US_DATA_COMMAND);
+}
+
+void IRAM_ATTR LCD2004::sendNibbles(uint8_t val) {
     GPOC = 0xF000;
     GPOS = ((uint32_t)(val & 0xF0)) << 8;
     delayMicroseconds(DELAY_US_SETUP_HOLD);
@@ -95,11 +162,190 @@ size_t IRAM_ATTR LCD2004::write(uint8_t val) {
     delayMicroseconds(DELAY_US_SETUP_HOLD);
     GP16O = 0;
     GP16O = 1;
-    delayMicroseconds(DELAY_US_DATA_COMMAND);
-    return 1;
+}
+
+// Add a byte to the queue, waiting for space if it is full,
+// and start the timer if it is idle.
+void IRAM_ATTR LCD2004::enqueue(uint16_t entry) {
+    uint8_t next = (q_head + 1) & (LCD_QUEUE_SIZE - 1);
+    while(next == q_tail); // Full, the ISR will make room
+    queue[q_head] = entry;
+    __sync_synchronize(); // The slot must be written before the ISR sees it
+    q_head = next;
+    if(!pump_running) {
+        // The timer is not armed when the pump is idle, so the ISR can't
+        // change pump_running between the check and here.
+        pump_running = true;
+        timer1_write(TIMER1_TICKS_PER_US);
+    }
+}
+
+// Send the next queued byte and arm the timer for its execution time
+void IRAM_ATTR LCD2004::pumpISR() {
+    LCD2004* lcd = pump_lcd;
+    uint8_t tail = lcd->q_tail;
+    if(tail == lcd->q_head) {
+        lcd->pump_running = false;
+        return;
+    }
+    uint16_t entry = lcd->queue[tail];
+    __sync_synchronize(); // Read the slot before handing it back
+    lcd->q_tail = (tail + 1) & (LCD_QUEUE_SIZE - 1);
+    if(entry & LCD_QUEUE_CMD) {
+        GPOC = (1 << lcd->rs_pin);
+    } else {
+        GPOS = (1 << lcd->rs_pin);
+    }
+    lcd->sendNibbles(entry);
+    timer1_write(TIMER1_TICKS_PER_US * ((entry & LCD_QUEUE_LONG) ? DELAY_US_LONG_COMMAND : DELAY_US_DATA_COMMAND));
+}
+
+// Block until all queued bytes have been sent
+void LCD2004::wait() {
+    while(pump_running) {
+        yield();
+    }
 }
 
 void LCD2004::setCursor(uint8_t col, uint8_t row) {
-    const uint8_t row_addrs[] = { 0x00, 0x40, 0x14, 0x54 }; // For regular LCDs
-    cmd(0x80 | (col + row_addrs[row]));
+    addr = col + row_addrs[row];
+    cmd(0x80 | addr);
+}
+
+// Show the underline cursor at a cell
+void LCD2004::cursor(uint8_t col, uint8_t row) {
+    uint8_t target = col + row_addrs[row];
+    if(cursor_addr == LCD_CURSOR_OFF) {
+        cmd(0x0E); // Display on, cursor on
+    }
+    cursor_addr = target;
+    if(addr != target) {
+        setCursor(col, row);
+    }
+}
+
+void LCD2004::noCursor() {
+    if(cursor_addr != LCD_CURSOR_OFF) {
+        cmd(0x0C); // Display on, cursor off
+        cursor_addr = LCD_CURSOR_OFF;
+    }
+}
+
+// Blank the frame buffer
+void LCD2004::frameClear() {
+    memset(frame, ' ', sizeof(frame));
+}
+
+// Register custom glyphs for character codes base..base+count-1.
+// bitmaps and fallbacks must be in PROGMEM.
+void LCD2004::setGlyphs(uint8_t base, uint8_t count, const uint8_t (*bitmaps)[8], const char* fallbacks) {
+    glyph_bitmaps = bitmaps;
+    glyph_fallbacks = fallbacks;
+    glyph_base = base;
+    glyph_count = count < LCD_GLYPH_MAX ? count : LCD_GLYPH_MAX;
+    memset(glyph_slot, LCD_GLYPH_NONE, sizeof(glyph_slot));
+    memset(slot_glyph, LCD_GLYPH_NONE, sizeof(slot_glyph));
+    memset(slot_used, 0, sizeof(slot_used));
+}
+
+// Character code to send for a shadow value
+uint8_t IRAM_ATTR LCD2004::glyphCode(uint8_t val) const {
+    uint8_t idx = val - glyph_base;
+    if(idx >= glyph_count) {
+        return val;
+    }
+    uint8_t slot = glyph_slot[idx];
+    return slot != LCD_GLYPH_NONE ? slot : pgm_read_byte(&glyph_fallbacks[idx]);
+}
+
+// Make sure the glyphs in a frame (bit n for glyph n) are in CGRAM.
+// Slots already holding one of them are kept; the rest are loaded into
+// the least recently used slots that the frame doesn't need.
+void LCD2004::loadGlyphs(uint32_t glyphs) {
+    if(glyph_count < 32) {
+        glyphs &= ((uint32_t)1 << glyph_count) - 1;
+    }
+    flush_count++;
+    uint8_t keep = 0;
+    for(uint8_t s=0; s<LCD_GLYPH_SLOTS; s++) {
+        uint8_t g = slot_glyph[s];
+        if(g != LCD_GLYPH_NONE && (glyphs & ((uint32_t)1 << g))) {
+            glyphs &= ~((uint32_t)1 << g);
+            slot_used[s] = flush_count;
+            keep |= 1 << s;
+        }
+    }
+    while(glyphs) {
+        uint8_t g = __builtin_ctz(glyphs);
+        glyphs &= glyphs - 1;
+        uint8_t slot = LCD_GLYPH_NONE;
+        for(uint8_t s=0; s<LCD_GLYPH_SLOTS; s++) {
+            if(!(keep & (1 << s)) && (slot == LCD_GLYPH_NONE || slot_used[s] < slot_used[slot])) {
+                slot = s;
+            }
+        }
+        if(slot == LCD_GLYPH_NONE) {
+            break; // More than 8 glyphs in the frame, the rest use fallbacks
+        }
+        if(slot_glyph[slot] != LCD_GLYPH_NONE) {
+            glyph_slot[slot_glyph[slot]] = LCD_GLYPH_NONE;
+        }
+        slot_glyph[slot] = g;
+        glyph_slot[g] = slot;
+        slot_used[slot] = flush_count;
+        keep |= 1 << slot;
+        cmd(0x40 | (slot << 3));
+        for(uint8_t i=0; i<8; i++) {
+            send(pgm_read_byte(&glyph_bitmaps[g][i]));
+        }
+        addr = LCD_GLYPH_NONE; // The address counter now points into CGRAM
+    }
+}
+
+// Send the frame buffer, finding the glyphs it uses first
+void LCD2004::flush() {
+    uint32_t glyphs = 0;
+    if(glyph_count) {
+        for(uint8_t row=0; row<LCD_LINES; row++) {
+            for(uint8_t col=0; col<LCD_COLS; col++) {
+                uint8_t idx = frame[row][col] - glyph_base;
+                if(idx < glyph_count) {
+                    glyphs |= (uint32_t)1 << idx;
+                }
+            }
+        }
+    }
+    flush(glyphs);
+}
+
+// Send the cells of the frame buffer that differ from the display, given
+// the set of glyphs it uses. Rows are visited in DDRAM order so runs of
+// changes continue across line boundaries without moving the cursor.
+void LCD2004::flush(uint32_t glyphs) {
+    ProfileScope scope(PROFILE_LCD_FLUSH);
+    static const uint8_t row_order[] = { 0, 2, 1, 3 };
+    if(glyphs) {
+        loadGlyphs(glyphs);
+    }
+    for(uint8_t i=0; i<LCD_LINES; i++) {
+        uint8_t row = row_order[i];
+        for(uint8_t col=0; col<LCD_COLS; col++) {
+            uint8_t val = frame[row][col];
+            uint8_t idx = val - glyph_base;
+            if(idx < glyph_count && glyph_slot[idx] == LCD_GLYPH_NONE) {
+                val = pgm_read_byte(&glyph_fallbacks[idx]);
+            }
+            if(shadow[row][col] == val) {
+                continue;
+            }
+            if(addr != col + row_addrs[row]) {
+                setCursor(col, row);
+            }
+            write(val);
+        }
+    }
+    if(cursor_addr != LCD_CURSOR_OFF && addr != cursor_addr) {
+        addr = cursor_addr;
+        cmd(0x80 | addr);
+    }
 }
\ No newline at end of file
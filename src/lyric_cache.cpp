@@ -0,0 +1,149 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "lyric_cache.h"
+
+#include <inttypes.h>
+#include <LittleFS.h>
+
+typedef struct {
+    uint32_t magic;
+    uint32_t stamp;     // Value of the use counter when last read or written
+} LyricCacheHeader;
+
+// Counts what is written to it, to size an entry before writing it
+class CountingPrint : public Print
+{
+    public:
+        CountingPrint() : count(0) {}
+        size_t write(uint8_t) override { count++; return 1; }
+        size_t write(const uint8_t*, size_t len) override { count += len; return len; }
+        size_t count;
+};
+
+static String cachePath(const char* track_id) {
+    String path = F(LYRIC_CACHE_DIR "/");
+    path += track_id;
+    return path;
+}
+
+LyricCache::LyricCache() {
+    counter = 0;
+}
+
+// Recover the use counter from the existing cache files.
+// LittleFS must already be mounted.
+void LyricCache::begin() {
+    LittleFS.mkdir(F(LYRIC_CACHE_DIR));
+    Dir dir = LittleFS.openDir(F(LYRIC_CACHE_DIR));
+    while(dir.next()) {
+        File f = dir.openFile("r");
+        LyricCacheHeader hdr;
+        if(f.read((uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr) && hdr.magic == LYRIC_CACHE_MAGIC && hdr.stamp > counter) {
+            counter = hdr.stamp;
+        }
+        f.close();
+    }
+}
+
+bool LyricCache::load(const char* track_id, LyricTimeline& lyrics) {
+    String path = cachePath(track_id);
+    File f = LittleFS.open(path, "r+");
+    if(!f) {
+        return false;
+    }
+    LyricCacheHeader hdr;
+    if(f.read((uint8_t*)&hdr, sizeof(hdr)) != sizeof(hdr) || hdr.magic != LYRIC_CACHE_MAGIC || !lyrics.deserialize(f)) {
+        f.close();
+        LittleFS.remove(path);
+        return false;
+    }
+    // Mark as most recently used
+    hdr.stamp = ++counter;
+    f.seek(0);
+    f.write((const uint8_t*)&hdr, sizeof(hdr));
+    f.close();
+    return true;
+}
+
+bool LyricCache::store(const char* track_id, const LyricTimeline& lyrics) {
+    String path = cachePath(track_id);
+    LittleFS.remove(path);
+    CountingPrint size;
+    lyrics.serialize(size);
+    if(!evict(sizeof(LyricCacheHeader) + size.count)) {
+        return false;
+    }
+
+    File f = LittleFS.open(path, "w");
+    if(!f) {
+        return false;
+    }
+    LyricCacheHeader hdr = { LYRIC_CACHE_MAGIC, ++counter };
+    bool ok = f.write((const uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr) && lyrics.serialize(f);
+    f.close();
+    if(!ok) {
+        LittleFS.remove(path);
+    }
+    return ok;
+}
+
+// Remove least recently used entries until there is room for the given
+// number of bytes within the budget.
+bool LyricCache::evict(size_t needed) {
+    if(needed > LYRIC_CACHE_BUDGET) {
+        return false;
+    }
+    while(true) {
+        size_t total = 0;
+        uint32_t oldest_stamp = UINT32_MAX;
+        String oldest;
+        Dir dir = LittleFS.openDir(F(LYRIC_CACHE_DIR));
+        while(dir.next()) {
+            total += dir.fileSize();
+            File f = dir.openFile("r");
+            LyricCacheHeader hdr;
+            if(f.read((uint8_t*)&hdr, sizeof(hdr)) != sizeof(hdr) || hdr.magic != LYRIC_CACHE_MAGIC) {
+                hdr.stamp = 0; // Corrupt, remove first
+            }
+            f.close();
+            if(hdr.stamp < oldest_stamp) {
+                oldest_stamp = hdr.stamp;
+                oldest = dir.fileName();
+            }
+        }
+
+        FSInfo info;
+        LittleFS.info(info);
+        size_t fs_free = info.totalBytes - info.usedBytes;
+        // Keep a couple of blocks spare for the token file and metadata
+        if(total + needed <= LYRIC_CACHE_BUDGET && needed + 2 * info.blockSize <= fs_free) {
+            return true;
+        }
+        if(oldest.length() == 0) {
+            return false;
+        }
+        LittleFS.remove(String(F(LYRIC_CACHE_DIR "/")) + oldest);
+    }
+}
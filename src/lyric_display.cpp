@@ -0,0 +1,191 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "lyric_display.h"
+#include "text_layout.h"
+
+#include <inttypes.h>
+
+LyricDisplay::LyricDisplay(LCD2004& lcd, const LyricTimeline& lyrics) : lcd(lcd), lyrics(lyrics),
+    events([this](uint8_t type, uint16_t arg) { onEvent(type, arg); }) {
+    trace = NULL;
+    sync_us = sync_ms = 0;
+    page_current = -1;
+    page_next = 0;
+    word_current = -1;
+    word_next = 0;
+}
+
+// Post a DISPLAY_* command. sync(), stop() and reset() cover normal use.
+bool LyricDisplay::post(uint8_t type, uint32_t progress_ms) {
+    if(trace) {
+        TraceDisplay rec = { progress_ms, type };
+        trace->record(TRACE_DISPLAY, 0, &rec, sizeof(rec));
+    }
+    DisplayCommand cmd = { (uint32_t)micros(), progress_ms, type };
+    return commands.push(cmd);
+}
+
+// Follow playback from progress_ms, sampled just now. Shows the page at
+// that position if it isn't shown already, or always if redraw is set.
+bool LyricDisplay::sync(uint32_t progress_ms, bool redraw) {
+    return post(redraw ? DISPLAY_REDRAW : DISPLAY_SYNC, progress_ms);
+}
+
+bool LyricDisplay::stop() {
+    return post(DISPLAY_STOP, 0);
+}
+
+// Stop and forget what is shown, e.g. before drawing over the lyrics
+// or loading new ones
+bool LyricDisplay::reset() {
+    return post(DISPLAY_RESET, 0);
+}
+
+// Handle posted commands, then run the events that are due
+void LyricDisplay::tick() {
+    DisplayCommand cmd;
+    while(commands.pop(cmd)) {
+        events.clear();
+        switch(cmd.type) {
+            case DISPLAY_SYNC:
+            case DISPLAY_REDRAW:
+                sync_us = cmd.at_us;
+                sync_ms = cmd.progress_ms;
+                resync(cmd.type == DISPLAY_REDRAW);
+                break;
+            case DISPLAY_RESET:
+                page_current = -1;
+                word_current = -1;
+                lcd.noCursor();
+                break;
+            default:
+                break;
+        }
+    }
+    events.poll();
+}
+
+void LyricDisplay::showPage(int idx) {
+    printPage(lcd, lyrics, idx);
+    DisplayShown shown = { progress(), (int16_t)idx };
+    pages_shown.push(shown);
+}
+
+uint32_t LyricDisplay::progress() const {
+    return sync_ms + (uint32_t)(micros() - sync_us) / 1000;
+}
+
+// Show the page at the current position if needed, and schedule the
+// following page and words
+void LyricDisplay::resync(bool redraw) {
+    uint32_t progress_ms = progress();
+    int idx = lyrics.findPage(progress_ms);
+    if(redraw || idx != page_current) {
+        if(idx >= 0) {
+            showPage(idx);
+        } else if(!redraw) {
+            lcd.frameClear();
+            lcd.flush();
+        }
+        page_current = idx;
+    }
+    page_next = idx + 1;
+    word_current = lyrics.findWord(progress_ms);
+    word_next = word_current + 1;
+    schedulePage();
+    scheduleWord();
+    highlightWord();
+}
+
+// Queue an event for a playback position
+void LyricDisplay::scheduleAt(uint32_t time_ms, uint8_t type, uint16_t arg) {
+    uint32_t progress_ms = progress();
+    events.after(time_ms > progress_ms ? time_ms - progress_ms : 0, type, arg);
+}
+
+void LyricDisplay::schedulePage() {
+    if(page_next < lyrics.pages()) {
+        scheduleAt(lyrics.page(page_next).time_ms, EVENT_PAGE, page_next);
+    }
+}
+
+void LyricDisplay::scheduleWord() {
+    if(word_next < lyrics.wordCount()) {
+        scheduleAt(lyrics.word(word_next).time_ms, EVENT_WORD, word_next);
+    }
+}
+
+// Underline the word being sung if it is on the display, and queue the
+// cursor's steps across its letters until the next word starts
+void LyricDisplay::highlightWord() {
+    events.cancel(EVENT_CURSOR);
+    uint8_t col, row;
+    if(word_current < 0 || page_current < 0 || !lyrics.word(word_current).len ||
+       !lyrics.locate(page_current, lyrics.word(word_current).offset, col, row)) {
+        lcd.noCursor();
+        return;
+    }
+    const LyricWord& word = lyrics.word(word_current);
+    uint32_t span = LYRIC_SWEEP_MAX_MS;
+    if((size_t)word_current + 1 < lyrics.wordCount()) {
+        span = min(lyrics.word(word_current + 1).time_ms - word.time_ms, span);
+    }
+    uint32_t progress_ms = progress();
+    for(uint8_t i=1; i<word.len && events.pending() < EVENT_QUEUE_SIZE - 2; i++) {
+        uint8_t c, r;
+        uint32_t step_ms = word.time_ms + span * i / word.len;
+        if(!lyrics.locate(page_current, word.offset + i, c, r)) {
+            break;
+        }
+        if(step_ms <= progress_ms) {
+            col = c;
+            row = r;
+        } else {
+            scheduleAt(step_ms, EVENT_CURSOR, r * LCD_COLS + c);
+        }
+    }
+    lcd.cursor(col, row);
+}
+
+void LyricDisplay::onEvent(uint8_t type, uint16_t arg) {
+    switch(type) {
+        case EVENT_PAGE:
+            showPage(arg);
+            page_current = arg;
+            page_next = arg + 1;
+            schedulePage();
+            highlightWord();
+            break;
+        case EVENT_WORD:
+            word_current = arg;
+            word_next = arg + 1;
+            scheduleWord();
+            highlightWord();
+            break;
+        case EVENT_CURSOR:
+            lcd.cursor(arg % LCD_COLS, arg / LCD_COLS);
+            break;
+    }
+}
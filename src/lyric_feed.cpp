@@ -0,0 +1,299 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "lyric_feed.h"
+#include "glyphs.h"
+
+#define PROGRESS_PLAYING        0x80000000UL    // Flag in a progress frame's value
+
+// Passes on bytes [skip, skip + room) of what is written to it, so a frame
+// can be rendered again to send the part that didn't fit last time
+class FrameWindow : public Print
+{
+    public:
+        FrameWindow(Client& out, size_t skip, size_t room) : out(out), skip(skip), end(skip + room), pos(0), len(0), sent(0) {}
+        size_t write(uint8_t c) override {
+            if(pos >= skip && pos < end) {
+                buf[len++] = c;
+                if(len == sizeof(buf)) {
+                    flush();
+                }
+            }
+            pos++;
+            return 1;
+        }
+        void flush() override {
+            if(len) {
+                sent += out.write(buf, len);
+                len = 0;
+            }
+        }
+        size_t size() const { return pos; }
+        size_t written() const { return sent; }
+    private:
+        Client& out;
+        size_t skip;
+        size_t end;
+        size_t pos;     // Bytes of the frame rendered so far
+        uint8_t buf[128];
+        size_t len;
+        size_t sent;
+};
+
+// Write str as event data. It can't contain line breaks.
+static void printData(Print& out, const char* str) {
+    for(; str && *str; str++) {
+        out.write((*str == '\r' || *str == '\n') ? ' ' : *str);
+    }
+}
+
+LyricFeed::LyricFeed(const LyricTimeline& lyrics) : lyrics(lyrics) {
+    track_name = track_artists = NULL;
+    track_gen = 0;
+    track_start = log_head = 0;
+    progress_ms = 0;
+    playing = false;
+    for(FeedClient& c : slots) {
+        c.client = NULL;
+    }
+    bytes_sent = frames_sent = lines_skipped = 0;
+    connections = drops = 0;
+}
+
+int LyricFeed::freeSlot() const {
+    for(int i=0; i<FEED_CLIENTS_MAX; i++) {
+        if(!slots[i].client) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void LyricFeed::attach(int slot, Client& client) {
+    client.print(F("HTTP/1.1 200 OK\r\n"
+                   "Content-Type: text/event-stream\r\n"
+                   "Cache-Control: no-cache\r\n"
+                   "Connection: keep-alive\r\n"
+                   "Access-Control-Allow-Origin: *\r\n\r\n"
+                   "retry: 3000\n\n"));
+    FeedClient& c = slots[slot];
+    c.client = &client;
+    // Catch up with the current track and its lines, as far as the log goes
+    c.track_gen = track_name ? track_gen - 1 : track_gen;
+    c.cursor = track_start;
+    c.progress_due = progress_ms || playing;
+    c.frame = FRAME_NONE;
+    c.active_ms = millis();
+    connections++;
+}
+
+size_t LyricFeed::clients() const {
+    size_t n = 0;
+    for(const FeedClient& c : slots) {
+        n += c.client != NULL;
+    }
+    return n;
+}
+
+void LyricFeed::track(const char* name, const char* artists) {
+    track_name = name;
+    track_artists = artists;
+    track_gen++;
+    track_start = log_head;
+}
+
+void LyricFeed::line(size_t idx) {
+    log[log_head++ & (FEED_LOG - 1)] = idx;
+}
+
+void LyricFeed::progress(uint32_t ms, bool is_playing) {
+    progress_ms = ms;
+    playing = is_playing;
+    for(FeedClient& c : slots) {
+        c.progress_due = true;
+    }
+}
+
+// Pick the next frame for a client: its track if that changed, then the
+// lines it hasn't seen, then the latest position
+bool LyricFeed::nextFrame(FeedClient& c) {
+    c.frame_sent = 0;
+    c.frame_gen = track_gen;
+    if(c.track_gen != track_gen) {
+        c.track_gen = track_gen;
+        if((int32_t)(track_start - c.cursor) > 0) {
+            c.cursor = track_start;
+        }
+        c.frame = FRAME_TRACK;
+        return true;
+    }
+    if(c.cursor != log_head) {
+        if(log_head - c.cursor > FEED_LOG) {
+            lines_skipped += log_head - c.cursor - FEED_LOG;
+            c.cursor = log_head - FEED_LOG;
+        }
+        c.frame = FRAME_LINE;
+        c.frame_value = log[c.cursor++ & (FEED_LOG - 1)];
+        return true;
+    }
+    if(c.progress_due) {
+        c.progress_due = false;
+        c.frame = FRAME_PROGRESS;
+        c.frame_value = progress_ms | (playing ? PROGRESS_PLAYING : 0);
+        return true;
+    }
+    c.frame = FRAME_NONE;
+    return false;
+}
+
+void LyricFeed::render(Print& out, uint8_t frame, uint32_t value) const {
+    switch(frame) {
+        case FRAME_TRACK:
+            out.print(F("event: track\ndata: "));
+            printData(out, track_name);
+            out.print(F("\ndata: "));
+            printData(out, track_artists);
+            break;
+        case FRAME_LINE:
+            out.print(F("event: line\ndata: "));
+            if(value < lyrics.size()) {
+                glyphPrint(out, lyrics.text(value), lyrics.length(value));
+            }
+            break;
+        case FRAME_PROGRESS:
+            out.print(F("event: progress\ndata: {\"progress_ms\":"));
+            out.print((unsigned long)(value & ~PROGRESS_PLAYING));
+            out.print(value & PROGRESS_PLAYING ? F(",\"playing\":true}") : F(",\"playing\":false}"));
+            break;
+    }
+    out.print(F("\n\n"));
+}
+
+void LyricFeed::close(FeedClient& c) {
+    c.client->stop();
+    c.client = NULL;
+}
+
+void LyricFeed::poll() {
+    unsigned long now = millis();
+    for(FeedClient& c : slots) {
+        if(!c.client) {
+            continue;
+        }
+        if(!c.client->connected()) {
+            close(c);
+            continue;
+        }
+        size_t budget = FEED_WRITE_MAX;
+        while(budget) {
+            if(c.frame == FRAME_NONE && !nextFrame(c)) {
+                c.active_ms = now;  // Idle, not stalled
+                break;
+            }
+            int room = c.client->availableForWrite();
+            if(room <= 0) {
+                if(now - c.active_ms >= FEED_STALL_MS) {
+                    drops++;
+                    close(c);
+                }
+                break;
+            }
+            size_t sent;
+            bool done;
+            if(c.frame_gen != track_gen && c.frame != FRAME_PROGRESS) {
+                // The text changed under a frame being sent. End it where it is.
+                if(c.frame_sent && room < 2) {
+                    break;
+                }
+                sent = c.frame_sent ? c.client->write((const uint8_t*)"\n\n", 2) : 0;
+                done = true;
+            } else {
+                FrameWindow window(*c.client, c.frame_sent, std::min((size_t)room, budget));
+                render(window, c.frame, c.frame_value);
+                window.flush();
+                sent = window.written();
+                c.frame_sent += sent;
+                done = c.frame_sent == window.size();
+            }
+            budget -= std::min(sent, budget);
+            bytes_sent += sent;
+            if(sent) {
+                c.active_ms = now;
+            }
+            if(done) {
+                frames_sent++;
+                c.frame = FRAME_NONE;
+            } else if(!sent) {
+                break;
+            }
+        }
+    }
+}
+
+void LyricFeed::printStats(Print& out) const {
+    out.print(F("Lyric feed: "));
+    out.print(clients());
+    out.print(F(" clients, "));
+    out.print(frames_sent);
+    out.print(F(" events, "));
+    out.print(bytes_sent);
+    out.print(F(" bytes, "));
+    out.print(lines_skipped);
+    out.print(F(" lines skipped, "));
+    out.print(drops);
+    out.println(F(" stalled"));
+}
+
+void LyricFeed::printMetrics(Print& out) const {
+    out.print(F("# HELP karaoke_feed_clients Connected event stream clients\n"
+                "# TYPE karaoke_feed_clients gauge\n"
+                "karaoke_feed_clients "));
+    out.print(clients());
+    out.print('\n');
+    out.print(F("# HELP karaoke_feed_connections_total Event stream connections accepted\n"
+                "# TYPE karaoke_feed_connections_total counter\n"
+                "karaoke_feed_connections_total "));
+    out.print(connections);
+    out.print('\n');
+    out.print(F("# HELP karaoke_feed_events_total Events sent to all clients\n"
+                "# TYPE karaoke_feed_events_total counter\n"
+                "karaoke_feed_events_total "));
+    out.print(frames_sent);
+    out.print('\n');
+    out.print(F("# HELP karaoke_feed_bytes_total Bytes sent to all clients\n"
+                "# TYPE karaoke_feed_bytes_total counter\n"
+                "karaoke_feed_bytes_total "));
+    out.print(bytes_sent);
+    out.print('\n');
+    out.print(F("# HELP karaoke_feed_lines_skipped_total Lyric lines missed by clients that fell behind\n"
+                "# TYPE karaoke_feed_lines_skipped_total counter\n"
+                "karaoke_feed_lines_skipped_total "));
+    out.print(lines_skipped);
+    out.print('\n');
+    out.print(F("# HELP karaoke_feed_stalled_total Clients closed for not accepting data\n"
+                "# TYPE karaoke_feed_stalled_total counter\n"
+                "karaoke_feed_stalled_total "));
+    out.print(drops);
+    out.print('\n');
+}
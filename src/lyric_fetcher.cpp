@@ -0,0 +1,130 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "lyric_fetcher.h"
+
+LyricFetcher::LyricFetcher(AsyncHttp& http, LyricProviderList& providers) : http(http), providers(providers) {
+    count = idx = 0;
+    lyrics = NULL;
+    active = false;
+    retried = false;
+    decode_retried = false;
+    start_ms = 0;
+}
+
+// Start looking up lyrics, replacing any lookup in progress. done is
+// called once, with the lyrics in place if found. Returns false if done
+// was already called (e.g. a local file was found).
+bool LyricFetcher::fetch(const LyricQuery& new_query, LyricTimeline& target, DoneHandler on_done) {
+    abort();
+    query = new_query;
+    lyrics = &target;
+    done = on_done;
+    count = providers.size();
+    for(size_t i=0; i<count; i++) {
+        order[i] = &providers.get(i);
+    }
+    idx = 0;
+    active = true;
+    next();
+    return active;
+}
+
+void LyricFetcher::abort() {
+    if(active) {
+        http.abort();
+        active = false;
+        done = nullptr;
+    }
+}
+
+// Try providers from idx on until one is waiting for a response or
+// there are none left
+void LyricFetcher::next() {
+    for(; idx < count; idx++) {
+        LyricProvider& p = *order[idx];
+        start_ms = millis();
+        if(!p.host()) {
+            bool found = p.load(query, *lyrics);
+            providers.record(p, 0, found, millis() - start_ms);
+            if(found) {
+                complete(true);
+                return;
+            }
+            continue;
+        }
+        retried = decode_retried = false;
+        if(!p.gzip()) {
+            http.preferIdentity(p.host());
+        }
+        p.request(http.compose(), query);
+        http.collectCookies(p.cookieJar());
+        Print* sink = p.begin(*lyrics);
+        if(http.begin(p.host(), sink, [this](int code) { onResponse(code); })) {
+            Serial.print(F("Lyric request: "));
+            Serial.println(p.name());
+            return;
+        }
+        providers.record(p, HTTP_ERROR_SEND, false, 0);
+    }
+    complete(false);
+}
+
+void LyricFetcher::complete(bool found) {
+    active = false;
+    DoneHandler cb = done;
+    done = nullptr;
+    if(cb) {
+        cb(found);
+    }
+}
+
+void LyricFetcher::onResponse(int code) {
+    LyricProvider& p = *order[idx];
+    uint8_t result = p.finish(code);
+    // Retry once after a redirect, and once more uncompressed after a gzip
+    // body that couldn't be inflated
+    bool redirect = result == LYRICS_RETRY && !retried;
+    bool decode = code == HTTP_ERROR_DECODE && !decode_retried;
+    if(redirect || decode) {
+        retried |= redirect;
+        decode_retried |= decode;
+        p.request(http.compose(), query);
+        if(http.begin(p.host(), p.begin(*lyrics), [this](int code) { onResponse(code); })) {
+            return;
+        }
+        result = LYRICS_NOT_FOUND;
+    }
+    Serial.print(p.name());
+    Serial.print(F(" response code: "));
+    Serial.println(code);
+    providers.record(p, code, result == LYRICS_FOUND, millis() - start_ms);
+    if(result == LYRICS_FOUND) {
+        complete(true);
+    } else {
+        lyrics->clear();
+        idx++;
+        next();
+    }
+}
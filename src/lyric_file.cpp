@@ -0,0 +1,53 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "lyric_file.h"
+
+#include <inttypes.h>
+#include <LittleFS.h>
+
+bool LyricFileProvider::load(const LyricQuery& query, LyricTimeline& lyrics) {
+    String path = F(LYRIC_FILE_DIR "/");
+    path += query.id;
+    path += F(".lrc");
+    File f = LittleFS.open(path, "r");
+    if(!f) {
+        return false;
+    }
+    lyrics.begin();
+    uint8_t buf[128];
+    size_t n;
+    bool ok = true;
+    while(ok && (n = f.read(buf, sizeof(buf))) > 0) {
+        for(size_t i=0; ok && i<n; i++) {
+            ok = lyrics.append(buf[i]);
+        }
+    }
+    f.close();
+    if(!ok || !lyrics.finish()) {
+        lyrics.clear();
+        return false;
+    }
+    return true;
+}
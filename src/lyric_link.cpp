@@ -0,0 +1,347 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "lyric_link.h"
+#include "text_layout.h"
+
+// Keeps bytes [skip, skip + room) of what is written to it
+class SlicePrint : public Print
+{
+    public:
+        SlicePrint(uint8_t* out, size_t skip, size_t room) : out(out), skip(skip), end(skip + room), pos(0) {}
+        size_t write(uint8_t c) override {
+            if(pos >= skip && pos < end) {
+                out[pos - skip] = c;
+            }
+            pos++;
+            return 1;
+        }
+        size_t size() const { return pos; }
+    private:
+        uint8_t* out;
+        size_t skip;
+        size_t end;
+        size_t pos;
+};
+
+// Reads a byte array
+class MemoryStream : public Stream
+{
+    public:
+        MemoryStream(const uint8_t* data, size_t len) : data(data), len(len), pos(0) {}
+        int available() override { return len - pos; }
+        int read() override { return pos < len ? data[pos++] : -1; }
+        int peek() override { return pos < len ? data[pos] : -1; }
+        size_t write(uint8_t) override { return 0; }
+        using Print::write;
+    private:
+        const uint8_t* data;
+        size_t len;
+        size_t pos;
+};
+
+static void putU16(uint8_t* p, uint16_t val) {
+    p[0] = val;
+    p[1] = val >> 8;
+}
+
+static void putU32(uint8_t* p, uint32_t val) {
+    putU16(p, val);
+    putU16(p + 2, val >> 16);
+}
+
+static uint16_t getU16(const uint8_t* p) {
+    return p[0] | p[1] << 8;
+}
+
+static uint32_t getU32(const uint8_t* p) {
+    return getU16(p) | (uint32_t)getU16(p + 2) << 16;
+}
+
+#define HEADER_LEN      6   // LinkHeader on the wire
+
+LyricHub::LyricHub(UDP& udp, const LyricTimeline& lyrics) : udp(udp), lyrics(lyrics) {
+    enabled = false;
+    track_name = track_artists = "";
+    session = micros();     // Unlikely to match what followers had from before a reboot
+    timeline = NULL;
+    timeline_len = 0;
+    carousel_pos = 0;
+    passes = 0;
+    carousel_ms = beacon_ms = 0;
+    beacon_due = true;
+    packets_sent = bytes_sent = 0;
+}
+
+LyricHub::~LyricHub() {
+    free(timeline);
+}
+
+void LyricHub::dropTimeline() {
+    free(timeline);
+    timeline = NULL;
+    timeline_len = 0;
+}
+
+void LyricHub::newSession() {
+    session++;
+    carousel_pos = 0;
+    passes = 0;
+    carousel_ms = millis() - LINK_CAROUSEL_MS;
+    beacon_due = true;
+}
+
+void LyricHub::track(const char* name, const char* artists) {
+    track_name = name ? name : "";
+    track_artists = artists ? artists : "";
+    dropTimeline();
+    newSession();
+}
+
+// Serialize the timeline once, so each fragment is a copy rather than
+// another pass over the whole timeline. Without memory for it, followers
+// get the track but no lyrics.
+void LyricHub::lyricsChanged() {
+    dropTimeline();
+    if(!enabled) {
+        return;
+    }
+    SlicePrint size(NULL, 0, 0);
+    lyrics.serialize(size);
+    if(size.size() && size.size() <= LINK_TIMELINE_MAX) {
+        timeline = (uint8_t*)malloc(size.size());
+        if(timeline) {
+            timeline_len = size.size();
+            SlicePrint out(timeline, 0, timeline_len);
+            lyrics.serialize(out);
+        }
+    }
+    newSession();
+}
+
+bool LyricHub::send(uint8_t type, size_t len) {
+    packet[0] = 'K';
+    packet[1] = 'L';
+    packet[2] = LINK_VERSION;
+    packet[3] = type;
+    putU16(packet + 4, session);
+    len += HEADER_LEN;
+    if(!udp.beginPacket(LINK_GROUP, LINK_PORT)) {
+        return false;
+    }
+    udp.write(packet, len);
+    if(!udp.endPacket()) {
+        return false;
+    }
+    packets_sent++;
+    bytes_sent += len;
+    return true;
+}
+
+// Send the next track or timeline packet
+void LyricHub::sendNext() {
+    uint8_t* body = packet + HEADER_LEN;
+    if(carousel_pos == 0) {
+        size_t name_len = min(strlen(track_name), (size_t)LINK_TEXT_MAX - 1);
+        size_t artists_len = min(strlen(track_artists), (size_t)LINK_TEXT_MAX - 1);
+        memcpy(body, track_name, name_len);
+        body[name_len] = '\0';
+        memcpy(body + name_len + 1, track_artists, artists_len);
+        body[name_len + 1 + artists_len] = '\0';
+        send(LINK_TRACK, name_len + artists_len + 2);
+    } else {
+        size_t offset = (carousel_pos - 1) * LINK_FRAGMENT_MAX;
+        size_t len = min((size_t)LINK_FRAGMENT_MAX, (size_t)timeline_len - offset);
+        putU16(body, offset);
+        putU16(body + 2, timeline_len);
+        memcpy(body + 4, timeline + offset, len);
+        send(LINK_TIMELINE, len + 4);
+    }
+    size_t count = 1 + (timeline_len + LINK_FRAGMENT_MAX - 1) / LINK_FRAGMENT_MAX;
+    if(++carousel_pos >= count) {
+        carousel_pos = 0;
+        if(passes < LINK_FAST_PASSES) {
+            passes++;
+        }
+    }
+}
+
+void LyricHub::poll(uint32_t progress_ms, bool playing) {
+    if(!enabled || !track_name[0]) {
+        return;     // Off, or nothing played yet
+    }
+    unsigned long now = millis();
+    if(beacon_due || now - beacon_ms >= LINK_BEACON_MS) {
+        uint8_t* body = packet + HEADER_LEN;
+        putU32(body, progress_ms);
+        body[4] = playing;
+        putU16(body + 5, timeline_len);
+        send(LINK_BEACON, 7);
+        beacon_ms = now;
+        beacon_due = false;
+    }
+    if(now - carousel_ms >= (passes < LINK_FAST_PASSES ? LINK_CAROUSEL_FAST_MS : LINK_CAROUSEL_MS)) {
+        carousel_ms = now;
+        sendNext();
+    }
+}
+
+void LyricHub::printStats(Print& out) const {
+    out.print(F("Lyric hub: "));
+    out.print(packets_sent);
+    out.print(F(" packets, "));
+    out.print(bytes_sent);
+    out.println(F(" bytes"));
+}
+
+LyricFollower::LyricFollower(UDP& udp, LCD2004& lcd) : udp(udp), lcd(lcd), display(lcd, lyrics) {
+    in_session = false;
+    session = 0;
+    track_shown = false;
+    timeline_buf = NULL;
+    timeline_len = 0;
+    fragments = 0;
+    timeline_done = false;
+    beacon_progress = 0;
+    beacon_ms = 0;
+    playing = false;
+    packets_received = 0;
+}
+
+LyricFollower::~LyricFollower() {
+    free(timeline_buf);
+}
+
+void LyricFollower::poll() {
+    int len;
+    while((len = udp.parsePacket()) > 0) {
+        len = udp.read(packet, sizeof(packet));
+        if(len > 0) {
+            handle(packet, len);
+        }
+    }
+}
+
+uint32_t LyricFollower::progress() const {
+    return beacon_progress + (playing ? millis() - beacon_ms : 0);
+}
+
+void LyricFollower::newSession(uint16_t id) {
+    display.reset();
+    lyrics.clear();
+    free(timeline_buf);
+    timeline_buf = NULL;
+    timeline_len = 0;
+    fragments = 0;
+    timeline_done = false;
+    track_shown = false;
+    in_session = true;
+    session = id;
+}
+
+void LyricFollower::addFragment(const uint8_t* data, size_t len) {
+    if(timeline_done || len < 4) {
+        return;
+    }
+    uint16_t offset = getU16(data);
+    uint16_t total = getU16(data + 2);
+    data += 4;
+    len -= 4;
+    if(!total || total > LINK_TIMELINE_MAX || offset % LINK_FRAGMENT_MAX || offset + len > total ||
+       len != min((size_t)LINK_FRAGMENT_MAX, (size_t)(total - offset))) {
+        return;
+    }
+    if(total != timeline_len) {
+        free(timeline_buf);
+        timeline_buf = (uint8_t*)malloc(total);
+        timeline_len = timeline_buf ? total : 0;
+        fragments = 0;
+        if(!timeline_buf) {
+            return;
+        }
+    }
+    memcpy(timeline_buf + offset, data, len);
+    fragments |= 1UL << (offset / LINK_FRAGMENT_MAX);
+    size_t count = (timeline_len + LINK_FRAGMENT_MAX - 1) / LINK_FRAGMENT_MAX;
+    if(fragments != (count == 32 ? UINT32_MAX : (1UL << count) - 1)) {
+        return;
+    }
+    MemoryStream in(timeline_buf, timeline_len);
+    timeline_done = lyrics.deserialize(in);
+    free(timeline_buf);
+    timeline_buf = NULL;
+    timeline_len = 0;
+    fragments = 0;
+    if(timeline_done && playing) {
+        display.sync(progress(), true);
+    }
+}
+
+void LyricFollower::handle(const uint8_t* data, size_t len) {
+    if(len < HEADER_LEN || data[0] != 'K' || data[1] != 'L' || data[2] != LINK_VERSION) {
+        return;
+    }
+    packets_received++;
+    uint16_t id = getU16(data + 4);
+    if(!in_session || id != session) {
+        newSession(id);
+    }
+    uint8_t type = data[3];
+    data += HEADER_LEN;
+    len -= HEADER_LEN;
+    switch(type) {
+        case LINK_TRACK: {
+            const char* name = (const char*)data;
+            size_t name_len = strnlen(name, len);
+            if(track_shown || name_len + 1 >= len || strnlen(name + name_len + 1, len - name_len - 1) == len - name_len - 1) {
+                break;
+            }
+            lcd.frameClear();
+            frameText(lcd, 0, name);
+            frameText(lcd, 1, name + name_len + 1);
+            lcd.noCursor();
+            lcd.flush();
+            track_shown = true;
+            break;
+        }
+        case LINK_TIMELINE:
+            addFragment(data, len);
+            break;
+        case LINK_BEACON:
+            if(len < 7) {
+                break;
+            }
+            beacon_progress = getU32(data);
+            beacon_ms = millis();
+            playing = data[4];
+            if(timeline_done) {
+                if(playing) {
+                    display.sync(beacon_progress, false);
+                } else {
+                    display.stop();
+                }
+            }
+            break;
+    }
+}
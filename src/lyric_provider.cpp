@@ -0,0 +1,210 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "lyric_provider.h"
+
+#include <inttypes.h>
+
+// Based on https://github.com/plageoj/urlencode
+void printUrlEncoded(Print& out, const char* str) {
+    const char* hex = "0123456789ABCDEF";
+    while(*str != '\0') {
+        uint8_t c = *str++;
+        if(('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || ('0' <= c && c <= '9') || c == '-' || c == '_' || c == '.' || c == '~') {
+            out.write(c);
+        } else {
+            out.write('%');
+            out.write(hex[c >> 4]);
+            out.write(hex[c & 0xf]);
+        }
+    }
+}
+
+// expected_ms is the latency assumed before the first lookup, which sets
+// the initial order
+LyricProvider::LyricProvider(const char* name, uint32_t expected_ms) {
+    provider_name = name;
+    latency_ms = expected_ms;
+    attempts = hits = errors = 0;
+}
+
+LyricProviderList::LyricProviderList() {
+    count = 0;
+}
+
+bool LyricProviderList::add(LyricProvider& provider) {
+    if(count == LYRIC_PROVIDERS_MAX) {
+        return false;
+    }
+    providers[count++] = &provider;
+    sort();
+    return true;
+}
+
+// Expected time to get lyrics from a provider: its average latency
+// divided by its success rate. The rate starts at 1/2 and is smoothed
+// so that one miss doesn't send a provider to the back.
+uint32_t LyricProviderList::cost(const LyricProvider& provider) {
+    return (uint64_t)provider.latency_ms * (provider.attempts + 2) / (provider.hits + 1);
+}
+
+void LyricProviderList::sort() {
+    for(size_t i=1; i<count; i++) {
+        LyricProvider* p = providers[i];
+        uint32_t c = cost(*p);
+        size_t j = i;
+        while(j > 0 && cost(*providers[j-1]) > c) {
+            providers[j] = providers[j-1];
+            j--;
+        }
+        providers[j] = p;
+    }
+}
+
+// Update a provider's statistics after a lookup and reorder the list.
+// code is the HTTP status or error code (0 for local providers).
+void LyricProviderList::record(LyricProvider& provider, int code, bool found, uint32_t ms) {
+    provider.attempts++;
+    if(found) {
+        provider.hits++;
+    } else if(code < 0) {
+        provider.errors++;
+    }
+    provider.latency_ms += ((int32_t)ms - (int32_t)provider.latency_ms) / LYRIC_LATENCY_WEIGHT;
+    sort();
+}
+
+void LyricProviderList::printStats(Print& out) const {
+    out.print(F("Lyric providers:"));
+    for(size_t i=0; i<count; i++) {
+        const LyricProvider& p = *providers[i];
+        out.print(' ');
+        out.print(p.name());
+        out.print(F(" ("));
+        out.print(p.hits);
+        out.print('/');
+        out.print(p.attempts);
+        out.print(F(", "));
+        out.print(p.latency_ms);
+        out.print(F(" ms)"));
+    }
+    out.println();
+}
+
+void LyricProviderList::printMetrics(Print& out) const {
+    out.print(F("# HELP karaoke_lyric_lookups_total Lyric lookups by provider and result\n"
+                "# TYPE karaoke_lyric_lookups_total counter\n"));
+    for(size_t i=0; i<count; i++) {
+        const LyricProvider& p = *providers[i];
+        const uint16_t results[] = { p.hits, (uint16_t)(p.attempts - p.hits - p.errors), p.errors };
+        const char* const labels[] = { "found", "not_found", "error" };
+        for(uint8_t r=0; r<3; r++) {
+            out.print(F("karaoke_lyric_lookups_total{provider=\""));
+            out.print(p.name());
+            out.print(F("\",result=\""));
+            out.print(labels[r]);
+            out.print(F("\"} "));
+            out.print(results[r]);
+            out.print('\n');
+        }
+    }
+    out.print(F("# HELP karaoke_lyric_latency_seconds Moving average lookup time\n"
+                "# TYPE karaoke_lyric_latency_seconds gauge\n"));
+    for(size_t i=0; i<count; i++) {
+        const LyricProvider& p = *providers[i];
+        out.print(F("karaoke_lyric_latency_seconds{provider=\""));
+        out.print(p.name());
+        out.print(F("\"} "));
+        out.print(p.latency_ms / 1000.0, 3);
+        out.print('\n');
+    }
+}
+
+MusixmatchProvider::MusixmatchProvider(const char* token) : LyricProvider("musixmatch", 1200), token(token), extractor("subtitle_body") {}
+
+void MusixmatchProvider::request(Print& out, const LyricQuery& query) {
+    out.print(F("GET /ws/1.1/macro.subtitles.get?format=json&namespace=lyrics_synched&subtitle_format=lrc&app_id=web-desktop-app-v1.0&usertoken="));
+    out.print(token);
+    out.print(F("&q_track="));
+    printUrlEncoded(out, query.name);
+    out.print(F("&q_artist="));
+    printUrlEncoded(out, query.artist);
+    out.print(F("&q_duration="));
+    out.print(query.duration_ms);
+    out.print(F(" HTTP/1.1\r\n"
+                "Host: apic-desktop.musixmatch.com\r\n"
+                "User-Agent: ESP8266HTTPClient\r\n"
+                "Connection: close\r\n"));
+    if(cookie != "") {
+        out.print(F("Cookie: "));
+        out.print(cookie);
+        out.print(F("\r\n"));
+    }
+    out.print(F("\r\n"));
+}
+
+Print* MusixmatchProvider::begin(LyricTimeline& lyrics) {
+    new_cookie = "";
+    extractor.begin(lyrics);
+    return &extractor;
+}
+
+uint8_t MusixmatchProvider::finish(int code) {
+    if(code == 301 && cookie != new_cookie) {
+        // Redirect: save the cookies and send them back
+        cookie = new_cookie;
+        return LYRICS_RETRY;
+    }
+    return (code == 200 && extractor.finish()) ? LYRICS_FOUND : LYRICS_NOT_FOUND;
+}
+
+LrclibProvider::LrclibProvider(const char* server) : LyricProvider("lrclib", 1500), server(server), extractor("syncedLyrics") {}
+
+void LrclibProvider::request(Print& out, const LyricQuery& query) {
+    out.print(F("GET /api/get?track_name="));
+    printUrlEncoded(out, query.name);
+    out.print(F("&artist_name="));
+    printUrlEncoded(out, query.artist);
+    out.print(F("&album_name="));
+    printUrlEncoded(out, query.album);
+    out.print(F("&duration="));
+    out.print((query.duration_ms + 500) / 1000);
+    out.print(F(" HTTP/1.1\r\n"
+                "Host: "));
+    out.print(server);
+    out.print(F("\r\n"
+                "User-Agent: esp8266-karaoke\r\n"
+                "Connection: close\r\n\r\n"));
+}
+
+Print* LrclibProvider::begin(LyricTimeline& lyrics) {
+    extractor.begin(lyrics);
+    return &extractor;
+}
+
+// 404 when the track is unknown; syncedLyrics is null for tracks with
+// only plain lyrics
+uint8_t LrclibProvider::finish(int code) {
+    return (code == 200 && extractor.finish()) ? LYRICS_FOUND : LYRICS_NOT_FOUND;
+}
@@ -0,0 +1,726 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "lyrics.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#define LYRIC_TEXT_INITIAL      1024
+#define LYRIC_LINES_INITIAL     32
+#define LYRIC_WORDS_INITIAL     64
+
+enum {
+    LRC_STAMP,  // Collecting "[MM:SS.TT]" at the start of a line
+    LRC_SPACE,  // After the timestamp, skip a single separating space
+    LRC_TEXT,   // Line text
+    LRC_WORD,   // Collecting "<MM:SS.TT>" within the text
+    LRC_SKIP,   // Malformed line, skip to the next newline
+    LRC_ERROR   // Out of memory
+};
+
+static unsigned int parseDigits(const char*& ptr, unsigned int* ndigits = NULL) {
+    unsigned int ret = 0;
+    unsigned int n = 0;
+    while(*ptr >= '0' && *ptr <= '9') {
+        ret *= 10;
+        ret += (*ptr++ - '0');
+        n++;
+    }
+    if(ndigits) {
+        *ndigits = n;
+    }
+    return ret;
+}
+
+// Parse a null-terminated "[MM:SS.TT]"
+static bool parseTimestamp(const char* ptr, uint32_t& time_ms) {
+    if(*ptr++ != '[') {
+        return false;
+    }
+    unsigned int lyric_min = parseDigits(ptr);
+    if(*ptr++ != ':') {
+        return false;
+    }
+    unsigned int lyric_sec = parseDigits(ptr);
+    unsigned int lyric_frac = 0;
+    if(*ptr == '.') {
+        ptr++;
+        unsigned int ndigits;
+        lyric_frac = parseDigits(ptr, &ndigits);
+        // Fraction is given in hundredths, but allow any precision
+        for(; ndigits < 3; ndigits++) lyric_frac *= 10;
+        for(; ndigits > 3; ndigits--) lyric_frac /= 10;
+    }
+    if(*ptr++ != ']') {
+        return false;
+    }
+    time_ms = lyric_min*60000 + lyric_sec*1000 + lyric_frac;
+    return true;
+}
+
+LyricTimeline::LyricTimeline() {
+    body = NULL;
+    lines = NULL;
+    words = NULL;
+    page_list = NULL;
+    clear();
+}
+
+LyricTimeline::~LyricTimeline() {
+    clear();
+}
+
+void LyricTimeline::clear() {
+    free(lines);
+    free(words);
+    free(body);
+    free(page_list);
+    lines = NULL;
+    words = NULL;
+    body = NULL;
+    page_list = NULL;
+    body_len = body_cap = 0;
+    count = lines_cap = 0;
+    word_count = words_cap = word_first = 0;
+    page_count = 0;
+    state = LRC_STAMP;
+    stamp_len = 0;
+    utf8.reset();
+}
+
+template<typename T> static void swapValue(T& a, T& b) {
+    T tmp = a;
+    a = b;
+    b = tmp;
+}
+
+// Exchange contents with another timeline, e.g. a prefetched one
+void LyricTimeline::swap(LyricTimeline& other) {
+    swapValue(body, other.body);
+    swapValue(body_len, other.body_len);
+    swapValue(body_cap, other.body_cap);
+    swapValue(lines, other.lines);
+    swapValue(count, other.count);
+    swapValue(lines_cap, other.lines_cap);
+    swapValue(words, other.words);
+    swapValue(word_count, other.word_count);
+    swapValue(words_cap, other.words_cap);
+    swapValue(word_first, other.word_first);
+    swapValue(page_list, other.page_list);
+    swapValue(page_count, other.page_count);
+    swapValue(utf8, other.utf8);
+    swapValue(state, other.state);
+    swapValue(stamp_len, other.stamp_len);
+    for(uint8_t i=0; i<LYRIC_STAMP_MAX; i++) {
+        swapValue(stamp[i], other.stamp[i]);
+    }
+}
+
+// Parse a complete lyric body
+bool LyricTimeline::load(const char* str) {
+    begin();
+    while(str && *str) {
+        if(!append(*str++)) {
+            break;
+        }
+    }
+    return finish();
+}
+
+void LyricTimeline::begin() {
+    clear();
+}
+
+bool LyricTimeline::addLine(uint32_t time_ms) {
+    if(word_first < word_count) {
+        measureWords();
+    }
+    if(count == lines_cap) {
+        size_t cap = lines_cap ? lines_cap * 2 : LYRIC_LINES_INITIAL;
+        LyricLine* tmp = (LyricLine*)realloc(lines, cap * sizeof(LyricLine));
+        if(!tmp) {
+            return false;
+        }
+        lines = tmp;
+        lines_cap = cap;
+    }
+    lines[count].time_ms = time_ms;
+    lines[count].offset = body_len;
+    lines[count].len = 0;
+    count++;
+    return true;
+}
+
+// Word timings may only follow the line's own timestamp
+bool LyricTimeline::addWord(uint32_t time_ms) {
+    if(word_count == words_cap) {
+        size_t cap = words_cap ? words_cap * 2 : LYRIC_WORDS_INITIAL;
+        LyricWord* tmp = (LyricWord*)realloc(words, cap * sizeof(LyricWord));
+        if(!tmp) {
+            return false;
+        }
+        words = tmp;
+        words_cap = cap;
+    }
+    words[word_count].time_ms = time_ms;
+    words[word_count].offset = body_len;
+    words[word_count].len = 0;
+    word_count++;
+    return true;
+}
+
+// End a "<MM:SS.TT" word timestamp collected in stamp. If it was closed
+// with '>' and is valid, record the word; otherwise keep it as text.
+bool LyricTimeline::endWord(bool closed) {
+    if(closed) {
+        uint32_t time_ms;
+        stamp[0] = '[';
+        stamp[stamp_len] = ']';
+        stamp[stamp_len+1] = '\0';
+        if(parseTimestamp(stamp, time_ms)) {
+            return addWord(time_ms);
+        }
+        stamp[stamp_len++] = '>';
+    }
+    stamp[0] = '<';
+    for(uint8_t i=0; i<stamp_len; i++) {
+        if(!addText(stamp[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LyricTimeline::addText(char c) {
+    if(body_len == body_cap) {
+        size_t cap = body_cap ? body_cap + body_cap / 2 : LYRIC_TEXT_INITIAL;
+        if(cap > UINT16_MAX) {
+            cap = UINT16_MAX;
+        }
+        if(cap == body_cap) {
+            return false;
+        }
+        char* tmp = (char*)realloc(body, cap);
+        if(!tmp) {
+            return false;
+        }
+        body = tmp;
+        body_cap = cap;
+    }
+    body[body_len++] = c;
+    lines[count-1].len++;
+    return true;
+}
+
+// Feed the next character of the LRC body.
+// Returns false if the lyrics could not be stored.
+bool LyricTimeline::append(char c) {
+    if(c == '\r') {
+        return state != LRC_ERROR;
+    }
+    if(c == '\n') {
+        if(state == LRC_WORD && !endWord(false)) {
+            state = LRC_ERROR;
+        }
+        if(state != LRC_ERROR) {
+            state = LRC_STAMP;
+            stamp_len = 0;
+            utf8.reset();
+        }
+        return state != LRC_ERROR;
+    }
+    if(state == LRC_WORD) {
+        if(c == '>') {
+            state = endWord(true) ? LRC_TEXT : LRC_ERROR;
+            return state != LRC_ERROR;
+        }
+        if(((c >= '0' && c <= '9') || c == ':' || c == '.') && stamp_len < LYRIC_STAMP_MAX - 3) {
+            stamp[stamp_len++] = c;
+            return true;
+        }
+        // Not a timestamp: keep the text and handle c as text
+        if(!endWord(false)) {
+            state = LRC_ERROR;
+            return false;
+        }
+        state = LRC_TEXT;
+    }
+    switch(state) {
+        case LRC_STAMP:
+            if(stamp_len == LYRIC_STAMP_MAX - 1 || (stamp_len == 0 && c != '[')) {
+                state = LRC_SKIP;
+                break;
+            }
+            stamp[stamp_len++] = c;
+            if(c == ']') {
+                uint32_t time_ms;
+                stamp[stamp_len] = '\0';
+                if(!parseTimestamp(stamp, time_ms)) {
+                    state = LRC_SKIP;
+                } else if(!addLine(time_ms)) {
+                    state = LRC_ERROR;
+                } else {
+                    state = LRC_SPACE;
+                }
+            }
+            break;
+        case LRC_SPACE:
+            state = LRC_TEXT;
+            if(c == ' ') {
+                break;
+            }
+            // fall through
+        case LRC_TEXT: {
+            if(c == '<') {
+                stamp_len = 1;
+                state = LRC_WORD;
+                break;
+            }
+            int32_t cp = utf8.decode(c);
+            if(cp >= 0 && cp < 0x80) {
+                if(!addText(cp)) {
+                    state = LRC_ERROR;
+                }
+            } else if(cp >= 0) {
+                uint8_t codes[2];
+                uint8_t n = glyphEncode(cp, codes);
+                for(uint8_t i=0; i<n; i++) {
+                    if(!addText(codes[i])) {
+                        state = LRC_ERROR;
+                        break;
+                    }
+                }
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return state != LRC_ERROR;
+}
+
+// Finish loading and release unused space.
+// Returns false if no timestamped lines were found.
+bool LyricTimeline::finish() {
+    if(state == LRC_ERROR) {
+        clear();
+        return false;
+    }
+    measureWords();
+    // The last lyric is an empty string marking the end of the song.
+    // Keep the previous line on the display instead.
+    if(count && lines[count-1].len == 0) {
+        count--;
+    }
+    if(!count) {
+        clear();
+        return false;
+    }
+    if(body_len && body_len < body_cap) {
+        char* tmp = (char*)realloc(body, body_len);
+        if(tmp) {
+            body = tmp;
+            body_cap = body_len;
+        }
+    }
+    if(count < lines_cap) {
+        LyricLine* tmp = (LyricLine*)realloc(lines, count * sizeof(LyricLine));
+        if(tmp) {
+            lines = tmp;
+            lines_cap = count;
+        }
+    }
+    if(word_count < words_cap) {
+        LyricWord* tmp = (LyricWord*)realloc(words, (word_count ? word_count : 1) * sizeof(LyricWord));
+        if(tmp) {
+            words = tmp;
+            words_cap = word_count;
+        }
+    }
+    if(!layout()) {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+// Point the words of the line just parsed at their first character and
+// find their lengths. A word runs to the next space or word in the line.
+void LyricTimeline::measureWords() {
+    if(!count) {
+        return;
+    }
+    uint16_t line_end = lines[count-1].offset + lines[count-1].len;
+    for(size_t i=word_first; i<word_count; i++) {
+        LyricWord& w = words[i];
+        uint16_t end = line_end;
+        if(i + 1 < word_count && words[i+1].offset > w.offset) {
+            end = words[i+1].offset;
+        }
+        while(w.offset < end && body[w.offset] == ' ') {
+            w.offset++;
+        }
+        uint16_t pos = w.offset;
+        while(pos < end && body[pos] != ' ' && pos - w.offset < UINT8_MAX) {
+            pos++;
+        }
+        w.len = pos - w.offset;
+    }
+    word_first = word_count;
+}
+
+// Split off the next row of text, wrapped at word boundaries where
+// possible. Spaces at the start of a row and at a break are dropped.
+// Returns false when no text is left.
+bool wrapRow(const char*& pos, const char* end, uint8_t cols, const char*& row, uint8_t& len) {
+    while(pos != end && *pos == ' ') {
+        pos++;
+    }
+    if(pos == end) {
+        return false;
+    }
+    row = pos;
+    len = 0;
+    while(pos != end && len < cols) {
+        if(*pos == ' ') {
+            // Break here if the next word fits on a row but not on this one
+            unsigned int wcnt = 1;
+            const char* tmp = pos + 1;
+            while(tmp != end && *tmp++ != ' ') {
+                wcnt++;
+            }
+            if(len + wcnt > cols && wcnt < cols) {
+                pos++;
+                break;
+            }
+        }
+        pos++;
+        len++;
+    }
+    return true;
+}
+
+// Lay out one line into pages, or only count them if out is NULL
+size_t LyricTimeline::layoutLine(size_t idx, LyricPage* out) const {
+    const char* str = text(idx);
+    const char* end = str + lines[idx].len;
+    const char* pos = str;
+    uint32_t start = lines[idx].time_ms;
+    uint32_t span = (idx + 1 < count ? lines[idx+1].time_ms : start + LYRIC_LAST_LINE_MS) - start;
+    size_t n = 0;
+    do {
+        if(out) {
+            LyricPage& page = out[n];
+            // Share the line's time in proportion to the text on each page
+            page.time_ms = start + (uint32_t)((uint64_t)span * (pos - str) / (lines[idx].len ? lines[idx].len : 1));
+            page.line = idx;
+            page.glyphs = 0;
+            for(uint8_t r=0; r<LYRIC_PAGE_ROWS; r++) {
+                const char* row;
+                if(wrapRow(pos, end, LYRIC_PAGE_COLS, row, page.len[r])) {
+                    page.start[r] = row - body;
+                    page.glyphs |= glyphMask(row, page.len[r]);
+                } else {
+                    page.start[r] = 0;
+                    page.len[r] = 0;
+                }
+            }
+        } else {
+            const char* row;
+            uint8_t len;
+            for(uint8_t r=0; r<LYRIC_PAGE_ROWS && wrapRow(pos, end, LYRIC_PAGE_COLS, row, len); r++);
+        }
+        n++;
+        while(pos != end && *pos == ' ') {
+            pos++;
+        }
+    } while(pos != end);
+    return n;
+}
+
+// Build the pages for all lines
+bool LyricTimeline::layout() {
+    free(page_list);
+    page_list = NULL;
+    page_count = 0;
+    size_t n = 0;
+    for(size_t i=0; i<count; i++) {
+        n += layoutLine(i, NULL);
+    }
+    page_list = (LyricPage*)malloc(n * sizeof(LyricPage));
+    if(!page_list) {
+        return false;
+    }
+    for(size_t i=0; i<count; i++) {
+        page_count += layoutLine(i, page_list + page_count);
+    }
+    return true;
+}
+
+// Write the timeline in a compact binary form:
+//   uint16 line count, uint16 text length, uint16 word count,
+//   LyricLine[count], LyricWord[word count], text
+// Returns the number of bytes written, or 0 on failure.
+size_t LyricTimeline::serialize(Print& out) const {
+    uint16_t hdr[3] = { (uint16_t)count, (uint16_t)body_len, (uint16_t)word_count };
+    size_t len = out.write((const uint8_t*)hdr, sizeof(hdr));
+    len += out.write((const uint8_t*)lines, count * sizeof(LyricLine));
+    len += out.write((const uint8_t*)words, word_count * sizeof(LyricWord));
+    len += out.write((const uint8_t*)body, body_len);
+    if(len != sizeof(hdr) + count * sizeof(LyricLine) + word_count * sizeof(LyricWord) + body_len) {
+        return 0;
+    }
+    return len;
+}
+
+// Load a timeline written by serialize()
+bool LyricTimeline::deserialize(Stream& in) {
+    uint16_t hdr[3];
+    clear();
+    if(in.readBytes((uint8_t*)hdr, sizeof(hdr)) != sizeof(hdr) || !hdr[0]) {
+        return false;
+    }
+    lines = (LyricLine*)malloc(hdr[0] * sizeof(LyricLine));
+    words = (LyricWord*)malloc((hdr[2] ? hdr[2] : 1) * sizeof(LyricWord));
+    body = (char*)malloc(hdr[1] ? hdr[1] : 1);
+    if(!lines || !words || !body) {
+        clear();
+        return false;
+    }
+    count = lines_cap = hdr[0];
+    body_len = body_cap = hdr[1];
+    word_count = words_cap = word_first = hdr[2];
+    if(in.readBytes((uint8_t*)lines, count * sizeof(LyricLine)) != count * sizeof(LyricLine) ||
+       in.readBytes((uint8_t*)words, word_count * sizeof(LyricWord)) != word_count * sizeof(LyricWord) ||
+       in.readBytes((uint8_t*)body, body_len) != body_len) {
+        clear();
+        return false;
+    }
+    for(size_t i=0; i<count; i++) {
+        if(lines[i].offset + lines[i].len > body_len) {
+            clear();
+            return false;
+        }
+    }
+    for(size_t i=0; i<word_count; i++) {
+        if(words[i].offset + words[i].len > body_len) {
+            clear();
+            return false;
+        }
+    }
+    if(!layout()) {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+// Returns the index of the line being sung at the given position,
+// or -1 if the first line has not started yet.
+int LyricTimeline::find(uint32_t progress_ms) const {
+    size_t lo = 0;
+    size_t hi = count;
+    while(lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if(lines[mid].time_ms <= progress_ms) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return (int)lo - 1;
+}
+
+// Returns the index of the page to show at the given position,
+// or -1 if the first line has not started yet.
+int LyricTimeline::findPage(uint32_t progress_ms) const {
+    size_t lo = 0;
+    size_t hi = page_count;
+    while(lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if(page_list[mid].time_ms <= progress_ms) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return (int)lo - 1;
+}
+
+// Returns the index of the last word started at the given position,
+// or -1 if none has.
+int LyricTimeline::findWord(uint32_t progress_ms) const {
+    size_t lo = 0;
+    size_t hi = word_count;
+    while(lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if(words[mid].time_ms <= progress_ms) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return (int)lo - 1;
+}
+
+// Find the display cell of a text offset on a page.
+// Returns false if the page doesn't show it.
+bool LyricTimeline::locate(size_t page_idx, uint16_t offset, uint8_t& col, uint8_t& row) const {
+    const LyricPage& page = page_list[page_idx];
+    for(uint8_t r=0; r<LYRIC_PAGE_ROWS; r++) {
+        if(offset >= page.start[r] && offset < page.start[r] + page.len[r]) {
+            col = offset - page.start[r];
+            row = r;
+            return true;
+        }
+    }
+    return false;
+}
+
+LyricExtractor::LyricExtractor(const char* key) : key(key) {
+    lyrics = NULL;
+    reset();
+}
+
+// Start extracting a new response into the timeline
+void LyricExtractor::begin(LyricTimeline& timeline) {
+    lyrics = &timeline;
+    lyrics->clear();
+    reset();
+}
+
+void LyricExtractor::reset() {
+    state = STATE_SEARCH;
+    match = 0;
+    surrogate = 0;
+}
+
+// Returns true if a lyric body was found and loaded
+bool LyricExtractor::finish() {
+    if(state != STATE_DONE) {
+        lyrics->clear();
+        return false;
+    }
+    return lyrics->finish();
+}
+
+void LyricExtractor::putCodepoint(uint32_t cp) {
+    char utf8[4];
+    uint8_t len = utf8Encode(cp, utf8);
+    for(uint8_t i=0; i<len; i++) {
+        if(!lyrics->append(utf8[i])) {
+            state = STATE_ERROR;
+            return;
+        }
+    }
+}
+
+size_t LyricExtractor::write(const uint8_t* buf, size_t len) {
+    for(size_t i=0; i<len; i++) {
+        write(buf[i]);
+    }
+    return len;
+}
+
+size_t LyricExtractor::write(uint8_t c) {
+    switch(state) {
+        case STATE_SEARCH: {
+            // Look for "key". The key can't appear with unescaped quotes
+            // inside another string, so no JSON tokenizing is required.
+            size_t key_len = strlen(key);
+            char expected = (match == 0 || match == key_len + 1) ? '"' : key[match-1];
+            if(c == expected) {
+                if(++match == key_len + 2) {
+                    state = STATE_COLON;
+                }
+            } else {
+                match = (c == '"') ? 1 : 0;
+            }
+            break;
+        }
+        case STATE_COLON:
+            if(c == ':') {
+                state = STATE_QUOTE;
+            } else if(!isspace(c)) {
+                reset();
+            }
+            break;
+        case STATE_QUOTE:
+            if(c == '"') {
+                lyrics->begin();
+                state = STATE_VALUE;
+            } else if(!isspace(c)) {
+                reset(); // null or other non-string value
+            }
+            break;
+        case STATE_VALUE:
+            if(c == '"') {
+                state = STATE_DONE;
+            } else if(c == '\\') {
+                state = STATE_ESCAPE;
+            } else if(!lyrics->append(c)) {
+                state = STATE_ERROR;
+            }
+            break;
+        case STATE_ESCAPE:
+            state = STATE_VALUE;
+            switch(c) {
+                case 'n': putCodepoint('\n'); break;
+                case 'r': putCodepoint('\r'); break;
+                case 't': putCodepoint(' '); break;
+                case 'b':
+                case 'f': break;
+                case 'u':
+                    hex = 0;
+                    hex_len = 0;
+                    state = STATE_UNICODE;
+                    break;
+                default: putCodepoint(c); break; // \" \\ \/
+            }
+            break;
+        case STATE_UNICODE:
+            hex <<= 4;
+            if(c >= '0' && c <= '9') hex |= c - '0';
+            else if(c >= 'a' && c <= 'f') hex |= c - 'a' + 10;
+            else if(c >= 'A' && c <= 'F') hex |= c - 'A' + 10;
+            if(++hex_len == 4) {
+                state = STATE_VALUE;
+                if(hex >= 0xD800 && hex < 0xDC00) {
+                    surrogate = hex;
+                } else if(hex >= 0xDC00 && hex < 0xE000) {
+                    if(surrogate) {
+                        putCodepoint(0x10000 + ((uint32_t)(surrogate - 0xD800) << 10) + (hex - 0xDC00));
+                    }
+                    surrogate = 0;
+                } else {
+                    putCodepoint(hex);
+                }
+            }
+            break;
+        default:
+            break;
+    }
+    return 1;
+}
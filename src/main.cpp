@@ -28,56 +28,104 @@ SOFTWARE.
 #include <LittleFS.h>
 #include <ESP8266mDNS.h>
 #include <ESP8266WebServer.h>
-#include <ArduinoJson.h>
-#include <ESP8266HTTPClient.h>
 #include <Ticker.h>
+#include <WiFiUdp.h>
 
 #include "secrets.h"
 #include "lcd2004.h"
+#include "lyrics.h"
+#include "lyric_cache.h"
+#include "async_http.h"
+#include "playback_clock.h"
+#include "text_layout.h"
+#include "glyphs.h"
+#include "heap_stats.h"
+#include "json_fields.h"
+#include "lyric_provider.h"
+#include "lyric_fetcher.h"
+#include "lyric_file.h"
+#include "profiler.h"
+#include "lyric_display.h"
+#include "token_cache.h"
+#include "lyric_feed.h"
+#include "trace_log.h"
+#include "wifi_cache.h"
+#include "lyric_link.h"
 
-#define PLAYBACK_REFRSH_INTERVAL        2000
 #define PLAYBACK_RETRY_INTERVAL         250
-#define REQUEST_TIMEOUT_MS              500
+#define PREFETCH_DELAY_MS               5000
+#define TOKEN_REFRESH_MARGIN_MS         300000  // Refresh the access token this long before it expires
+#define TOKEN_RETRY_MS                  10000
+#define TLS_SESSION_FILE                "/tls.bin"
+#define PLAYING_FILE                    "/playing.txt"
+#define PLAYING_SAVE_DELAY_MS           30000   // Tracks skipped sooner aren't saved
+#define FEED_PROGRESS_MS                1000    // Progress updates to event stream clients
 
 LCD2004 lcd(2);
 Ticker displayTicker;
 ESP8266WebServer server(80);
 
+// Fixed field sizes, so playback state never reallocates
+#define SP_TOKEN_MAX                    400     // Access tokens are about 300 characters
+#define TRACK_ID_MAX                    24      // Spotify IDs are 22 characters
+#define TRACK_NAME_MAX                  128
+#define ARTIST_NAME_MAX                 96
+
 typedef struct {
-    String accessToken;
-    String refreshToken;
+    char accessToken[SP_TOKEN_MAX];
+    char refreshToken[SP_TOKEN_MAX];
 } SpotifyToken;
 SpotifyToken auth;
+unsigned long token_refresh_ms;     // When to refresh the access token
+bool token_saved = false;           // Refresh token in flash matches auth
 
 typedef struct {
     unsigned long millis;
+    unsigned int latency;
     unsigned int progress;
     unsigned int duration;
-    String track_name;
-    String album_name;
-    String artist_name;
-    String track_id;
+    char track_name[TRACK_NAME_MAX];
+    char album_name[TRACK_NAME_MAX];
+    char artist_name[ARTIST_NAME_MAX];  // First artist, used to find lyrics
+    char artists[ARTIST_NAME_MAX];      // All artists, for the display
+    char track_id[TRACK_ID_MAX];
     bool playing;
 } SpotifyPlayback;
 SpotifyPlayback playback;
+SpotifyPlayback polled;         // Response being received, copied to playback if complete
+PlaybackClock playbackClock;
 
-String lastTrack;
+char lastTrack[TRACK_ID_MAX];
+unsigned long track_start_ms;       // When lastTrack started playing
+char playingSaved[TRACK_ID_MAX];    // Track in PLAYING_FILE
 
-StaticJsonDocument<12288> lyricDoc;
-const char* p_lyric_start;
-const char* p_lyric_next = NULL;
-const char* p_lyric_current = NULL;
-unsigned int next_lyric_ms;
+// Copy a (possibly null) JSON string into a fixed field, truncating if needed
+template<size_t N> void setField(char (&field)[N], const char* str) {
+    strlcpy(field, str ? str : "", N);
+}
 
-String spotifyAuth() {
-    String oneWayCode = "";
-
-    if(!MDNS.begin(MDNS_HOSTNAME)) {
-        Serial.println(F("FATAL: MDNS error"));
-        while(1) yield();
-    }
-    Serial.println(F("mDNS started"));
+AsyncHttp spotifyHttp;  // api.spotify.com, kept open between polls
+AsyncHttp auxHttp;      // accounts.spotify.com and lyric providers
+TraceLog traceLog;
+
+LyricTimeline lyrics;
+LyricCache lyricCache;
+LyricFileProvider lyricFiles;
+MusixmatchProvider musixmatch(MM_TOKEN);
+LrclibProvider lrclib("lrclib.net");
+LyricProviderList lyricProviders;
+LyricFetcher lyricFetcher(auxHttp, lyricProviders);
+int lyric_printed = -1;         // Line last echoed over serial
+LyricDisplay lyricDisplay(lcd, lyrics);
+LyricFeed lyricFeed(lyrics);
+WiFiClient feedClients[FEED_CLIENTS_MAX];
+unsigned long feed_progress_ms = 0;
+WiFiUDP linkUdp;
+LyricHub lyricHub(linkUdp, lyrics);
+
+String authCode;
 
+String spotifyAuth() {
     // Redirect user to Spotify authorization (login) page
     server.on("/", []() {
         server.sendHeader("Location", F("https://accounts.spotify.com/authorize/?client_id=" SP_CLIENT_ID \
@@ -87,392 +135,585 @@ String spotifyAuth() {
     });
 
     // Retrieve auth code returned by Spotify
-    server.on ("/callback/", [&oneWayCode](){
+    server.on ("/callback/", [](){
         if(!server.hasArg("code")) {
             server.send(500, "text/plain", "BAD ARGS");
         } else {
-            oneWayCode = server.arg("code");
+            authCode = server.arg("code");
             server.send (200, "text/html", F("Spotify authorization complete. You can close this window."));
         }
     });
 
-    server.begin();
-    Serial.println(F("HTTP server started"));
-
-    while(oneWayCode == "") {
+    while(authCode == "") {
         server.handleClient();
         MDNS.update();
         yield();
     }
-    server.stop();
-    MDNS.close();
-    return oneWayCode;
+    return authCode;
 }
 
-void getToken(bool refresh, String code) {
-    WiFiClientSecure client;
-    client.setInsecure();
-    const char* host = "accounts.spotify.com";
-    const int port = 443;
-    String url = "/api/token";
-    if (!client.connect(host, port)) {
-        Serial.println("connection failed");
-        return;
-    }
-
-    String codeParam = "code";
-    String grantType = "authorization_code";
-    if (refresh) {
-        grantType = codeParam = "refresh_token";
-    }
-    String authorization = base64::encode(F(SP_CLIENT_ID ":" SP_CLIENT_SECRET), false);
-    // This will send the request to the server
-    String content = "grant_type=" + grantType + "&" + codeParam + "=" + code + "&redirect_uri=" SP_REDIRECT_URI;
-    String request = String("POST ") + url + " HTTP/1.1\r\n" +
-                             "Host: " + host + "\r\n" +
-                             "Authorization: Basic " + authorization + "\r\n" +
-                             "Content-Length: " + String(content.length()) + "\r\n" +
-                             "Content-Type: application/x-www-form-urlencoded\r\n" +
-                             "Connection: close\r\n\r\n" +
-                             content;
-    client.print(request);
-
-    unsigned long req_start = millis();
-    while(!client.available()) {
-        if(millis() - req_start > REQUEST_TIMEOUT_MS) {
-            Serial.println(F("Request Timeout"));
-            return;
+// Sends Print output to the current web server client in chunks
+class ServerPrint : public Print
+{
+    public:
+        ServerPrint() : len(0) {}
+        ~ServerPrint() { flush(); }
+        size_t write(uint8_t c) override {
+            buf[len++] = c;
+            if(len == sizeof(buf)) {
+                flush();
+            }
+            return 1;
         }
-        delay(10);
-    }
-
-    while (client.connected()) {
-        String line = client.readStringUntil('\n');
-        if (line == "\r") {
-                break;
+        void flush() override {
+            if(len) {
+                server.sendContent(buf, len);
+                len = 0;
+            }
         }
+    private:
+        char buf[256];
+        size_t len;
+};
+
+void handleMetrics() {
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, "text/plain; version=0.0.4", "");
+    {
+        ServerPrint out;
+        profilePrintMetrics(out);
+        heapPrintMetrics(out);
+        lyricProviders.printMetrics(out);
+        lyricFeed.printMetrics(out);
     }
+    server.sendContent("");
+}
+
+// Page showing the lyric feed from /events
+static const char feed_page[] PROGMEM =
+    "<!DOCTYPE html><html><head><meta charset=utf-8><meta name=viewport content='width=device-width'>"
+    "<title>Lyrics</title><style>body{font:2em sans-serif;text-align:center;background:#111;color:#eee}"
+    "#t,#p{font-size:.5em;color:#888;white-space:pre-line}</style></head><body>"
+    "<div id=t></div><p id=l></p><div id=p></div><script>"
+    "var s=new EventSource('/events');"
+    "s.addEventListener('track',function(e){t.textContent=e.data;l.textContent=''});"
+    "s.addEventListener('line',function(e){l.textContent=e.data});"
+    "s.addEventListener('progress',function(e){var d=JSON.parse(e.data),s=Math.floor(d.progress_ms/1000);"
+    "p.textContent=Math.floor(s/60)+':'+('0'+s%60).slice(-2)+(d.playing?'':' (paused)')});"
+    "</script></body></html>";
+
+void handleFeedPage() {
+    server.send_P(200, "text/html", feed_page);
+}
 
-    StaticJsonDocument<32> filter;
-    filter["access_token"] = true;
-    filter["refresh_token"] = true;
-    StaticJsonDocument<512> doc;
-    DeserializationError error = deserializeJson(doc, client, DeserializationOption::Filter(filter));
-    if (error) {
-        Serial.print(F("deserializeJson() failed: "));
-        Serial.println(error.f_str());
+// Hand the connection over to the lyric feed, which keeps it open
+void handleEvents() {
+    int slot = lyricFeed.freeSlot();
+    if(slot < 0) {
+        server.send(503, "text/plain", "Too many clients");
         return;
     }
-    auth.accessToken = (const char*)doc["access_token"];
-    auth.refreshToken = (const char*)doc["refresh_token"];
+    feedClients[slot] = server.client();
+    feedClients[slot].setNoDelay(true);
+    lyricFeed.attach(slot, feedClients[slot]);
 }
 
-int updatePlayback() {
-    int ret_code = 0;
-    WiFiClientSecure client;
-    client.setInsecure();
-
-    String host = "api.spotify.com";
-    const int port = 443;
-    String url = "/v1/me/player/currently-playing";
-    if (!client.connect(host.c_str(), port)) {
-        Serial.println(F("Connection failed"));
-        return ret_code;
+// Download the trace captured since /trace/start
+void handleTrace() {
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, "application/octet-stream", "");
+    {
+        ServerPrint out;
+        traceLog.copyTo(out);
     }
+    server.sendContent("");
+}
 
-    String request = "GET " + url + " HTTP/1.1\r\n" +
-                             "Host: " + host + "\r\n" +
-                             "Authorization: Bearer " + auth.accessToken + "\r\n" +
-                             "Connection: close\r\n\r\n";
-    client.print(request);
-
-    unsigned long req_start = millis();
-    while(!client.available()) {
-        if(millis() - req_start > REQUEST_TIMEOUT_MS) {
-            Serial.println(F("Request Timeout"));
-            return ret_code;
-        }
-        delay(10);
-    }
+void startLyric(bool force);
 
-    // Discard header, get HTTP code
-    while (client.connected()) {
-        String line = client.readStringUntil('\n');
-        if(line.startsWith(F("HTTP/1"))) {
-            ret_code = line.substring(9, line.indexOf(' ', 9)).toInt();
-        }
-        if(line == "\r") {
-                break;
-        }
+void handleTraceStart() {
+    if(!traceLog.start()) {
+        server.send(500, "text/plain", "Can't create trace file");
+        return;
     }
-
-    if(ret_code == 200) {
-        StaticJsonDocument<192> filter;
-        filter["progress_ms"] = true;
-        filter["is_playing"] = true;
-        JsonObject filter_item = filter.createNestedObject("item");
-        filter_item["name"] = true;
-        filter_item["album"]["name"] = true;
-        filter_item["duration_ms"] = true;
-        filter_item["id"] = true;
-        filter_item["artists"][0]["name"] = true;
-        StaticJsonDocument<512> doc;
-
-        DeserializationError error = deserializeJson(doc, client, DeserializationOption::Filter(filter));
-        if (error) {
-            Serial.print(F("deserializeJson() failed: "));
-            Serial.println(error.f_str());
-            return false;
-        }
-
-        playback.progress = doc["progress_ms"];
-
-        JsonObject item = doc["item"];
-        playback.album_name = (const char*)item["album"]["name"];
-        playback.artist_name = (const char*)item["artists"][0]["name"];
-        playback.duration = item["duration_ms"];
-        playback.track_id = (const char*)item["id"];
-        playback.track_name = (const char*)item["name"];
-        playback.playing = doc["is_playing"];
-
-        playback.millis = millis();
+    // Give the trace the lyrics and position the display starts from
+    if(lyrics.size() && playback.playing) {
+        startLyric(true);
     }
-
-    return ret_code;
+    server.send(200, "text/plain", "Tracing");
 }
 
-// From https://github.com/plageoj/urlencode
-String urlEncode(const char *msg)
-{
-    const char *hex = "0123456789ABCDEF";
-    String encodedMsg;
-    encodedMsg.reserve(strlen(msg) + 16);
-    encodedMsg = "";
-
-    while (*msg != '\0') {
-        if (('a' <= *msg && *msg <= 'z') || ('A' <= *msg && *msg <= 'Z') || ('0' <= *msg && *msg <= '9') || *msg == '-' || *msg == '_' || *msg == '.' || *msg == '~') {
-            encodedMsg += *msg;
-        } else {
-            encodedMsg += '%';
-            encodedMsg += hex[*msg >> 4];
-            encodedMsg += hex[*msg & 0xf];
-        }
-        msg++;
-    }
-    return encodedMsg;
-}
-
-void getLyrics() {
-    static String mxmCookie;
-    WiFiClientSecure client;
-    HTTPClient http;
-    p_lyric_next = p_lyric_current = p_lyric_start = NULL;
-    client.setInsecure(); //Bad!
-    String track = urlEncode(playback.track_name.c_str());
-    String artist = urlEncode(playback.artist_name.c_str());
-    String uri = "https://apic-desktop.musixmatch.com/ws/1.1/macro.subtitles.get?format=json&namespace=lyrics_synched&subtitle_format=lrc&app_id=web-desktop-app-v1.0&usertoken=" MM_TOKEN \
-        "&q_track="+ track +
-        "&q_artist=" + artist +
-        "&q_duration=" + playback.duration;
-    Serial.println(uri);
-
-    http.begin(client, uri);
-    const char* headers[] = {"Set-Cookie"};
-    http.collectHeaders(headers, 1);
-
-    if(mxmCookie != "") {
-        http.addHeader("Cookie", mxmCookie);
-    }
-
-    int code = http.GET();
-    Serial.print("Response code: ");
-    Serial.println(code);
-    if(code == 301) {
-        // Redirect: save the cookies and send them back.
-        mxmCookie = http.header("Set-Cookie");
-        delay(100);
-        http.addHeader("Cookie", mxmCookie);
-        code = http.GET();
-        Serial.print("Response code: ");
-        Serial.println(code);
-    } else if(code != 200) {
-        return;
-    }
+void handleTraceStop() {
+    traceLog.stop();
+    server.send(200, "text/plain", "Stopped");
+}
 
-    StaticJsonDocument<192> filter;
+// Boot phase timing, printed as each phase ends
+unsigned long boot_phase_ms = 0;
+bool boot_polled = false;
+bool boot_shown = false;
 
-    JsonObject lyric_filter = filter["message"]["body"]["macro_calls"]["track.subtitles.get"].createNestedObject("message");
-    lyric_filter["header"]["available"] = true;
-    lyric_filter["body"]["subtitle_list"][0]["subtitle"]["subtitle_body"] = true;
+void bootPhase(const __FlashStringHelper* name) {
+    unsigned long now = millis();
+    Serial.print(F("Boot: "));
+    Serial.print(name);
+    Serial.print(' ');
+    Serial.print(now - boot_phase_ms);
+    Serial.print(F(" ms (at "));
+    Serial.print(now);
+    Serial.println(F(" ms)"));
+    boot_phase_ms = now;
+}
 
-    DeserializationError error = deserializeJson(lyricDoc, client, DeserializationOption::Filter(filter), DeserializationOption::NestingLimit(12));
-    if (error) {
-        Serial.print(F("deserializeJson() failed: "));
-        Serial.println(error.f_str());
+// Write the tokens to flash, only if the refresh token changed. The access
+// token is written along with it so that a cold boot can start polling
+// without waiting for a new one; if it has expired, the first poll gets a
+// 401 and refreshes it. A new access token alone only goes to RTC memory,
+// so the hourly refresh doesn't wear the flash.
+void saveTokens() {
+    if(token_saved) {
         return;
     }
-
-    int lyric_available = lyricDoc["message"]["body"]["macro_calls"]["track.subtitles.get"]["message"]["header"]["available"];
-    if(lyric_available) {
-        p_lyric_start = lyricDoc["message"]["body"]["macro_calls"]["track.subtitles.get"]["message"]["body"]["subtitle_list"][0]["subtitle"]["subtitle_body"];
-        p_lyric_next = p_lyric_start;
-    }
-
-    http.end();
-}
-
-void saveRefreshToken(String refreshToken) {
     File f = LittleFS.open(F("/sptoken.txt"), "w");
     if (!f) {
         Serial.println(F("Failed to write sptoken"));
         return;
     }
-    f.println(refreshToken);
+    f.println(auth.refreshToken);
+    f.println(auth.accessToken);
     f.close();
+    token_saved = true;
     Serial.println(F("Saved token"));
 }
 
-String loadRefreshToken() {
+// Read one line of the token file
+static void readTokenLine(File& f, char* token, size_t size) {
+    size_t len = f.readBytesUntil('\r', token, size - 1);
+    token[len] = '\0';
+    if(f.peek() == '\n') {
+        f.read();
+    }
+}
+
+// Read the saved tokens into auth. Returns false if there is no refresh token.
+bool loadTokens() {
+    auth.refreshToken[0] = auth.accessToken[0] = '\0';
     File f = LittleFS.open(F("/sptoken.txt"), "r");
     if (!f) {
         Serial.println(F("Failed to read sptoken"));
-        return "";
+        return false;
     }
-    while(f.available()) {
-        String token = f.readStringUntil('\r');
+    readTokenLine(f, auth.refreshToken, sizeof(auth.refreshToken));
+    readTokenLine(f, auth.accessToken, sizeof(auth.accessToken));
+    f.close();
+    if(auth.refreshToken[0]) {
         Serial.println(F("Loaded token"));
+    }
+    return auth.refreshToken[0];
+}
+
+void loadTlsSession() {
+    File f = LittleFS.open(F(TLS_SESSION_FILE), "r");
+    if(f) {
+        if(spotifyHttp.loadSession(f, "api.spotify.com")) {
+            Serial.println(F("Loaded TLS session"));
+        }
         f.close();
-        return token;
     }
-    return "";
 }
 
-unsigned int parseInt(const char* ptr) {
-    unsigned int ret = 0;
-    while(*ptr >= '0' && *ptr <= '9') {
-        ret *= 10;
-        ret += (*ptr++ - '0');
+void saveTlsSession() {
+    File f = LittleFS.open(F(TLS_SESSION_FILE), "w");
+    if(f) {
+        spotifyHttp.saveSession(f);
+        f.close();
     }
-    return ret;
 }
 
-// Advance the lyric pointer to the next line to be displayed
-//[MM:SS.TT] Lyric Line\n
-bool nextLyric() {
-    unsigned int lyric_min = 0;
-    unsigned int lyric_sec = 0;
-    unsigned int lyric_ms = 0;
-    if(p_lyric_next && *p_lyric_next++ == '[') {
-        lyric_min = parseInt(p_lyric_next);
-        while(*p_lyric_next++ != ':');
-        lyric_sec = parseInt(p_lyric_next);
-        while(*p_lyric_next++ != '.');
-        lyric_ms = parseInt(p_lyric_next);
-        while(*p_lyric_next++ != ' ');
+// Base64 encode a PROGMEM string
+void printBase64(Print& out, PGM_P str) {
+    static const char table[] PROGMEM = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t len = strlen_P(str);
+    for(size_t i=0; i<len; i+=3) {
+        uint32_t val = (uint32_t)pgm_read_byte(str + i) << 16;
+        if(i + 1 < len) {
+            val |= pgm_read_byte(str + i + 1) << 8;
+        }
+        if(i + 2 < len) {
+            val |= pgm_read_byte(str + i + 2);
+        }
+        out.write(pgm_read_byte(&table[(val >> 18) & 0x3F]));
+        out.write(pgm_read_byte(&table[(val >> 12) & 0x3F]));
+        out.write(i + 1 < len ? pgm_read_byte(&table[(val >> 6) & 0x3F]) : '=');
+        out.write(i + 2 < len ? pgm_read_byte(&table[val & 0x3F]) : '=');
+    }
+}
+
+void composeTokenRequest(Print& out, bool refresh, const char* code) {
+    const char* param = refresh ? "refresh_token" : "code";
+    const char* grant = refresh ? "refresh_token" : "authorization_code";
+    static const char redirect[] PROGMEM = "&redirect_uri=" SP_REDIRECT_URI;
+    size_t content_len = strlen("grant_type=&=") + strlen(grant) + strlen(param) + strlen(code) + strlen_P(redirect);
+    out.print(F("POST /api/token HTTP/1.1\r\n"
+                "Host: accounts.spotify.com\r\n"
+                "Authorization: Basic "));
+    printBase64(out, PSTR(SP_CLIENT_ID ":" SP_CLIENT_SECRET));
+    out.print(F("\r\nContent-Length: "));
+    out.print(content_len);
+    out.print(F("\r\nContent-Type: application/x-www-form-urlencoded\r\n"
+                "Connection: close\r\n\r\n"
+                "grant_type="));
+    out.print(grant);
+    out.print('&');
+    out.print(param);
+    out.print('=');
+    out.print(code);
+    out.print(FPSTR(redirect));
+}
+
+// Token response, streamed in apart from auth so a failed request keeps
+// the old tokens
+SpotifyToken received;
+unsigned int received_expires_s;
+static const JsonField token_fields[] = {
+    { "access_token", JSON_FIELD_STRING, received.accessToken, sizeof(received.accessToken) },
+    { "refresh_token", JSON_FIELD_STRING, received.refreshToken, sizeof(received.refreshToken) },
+    { "expires_in", JSON_FIELD_UINT, &received_expires_s, 0 }
+};
+JsonFieldExtractor tokenExtractor(token_fields);
+
+// Take the tokens of a finished token request
+void onToken(int code) {
+    token_refresh_ms = millis() + TOKEN_RETRY_MS;
+    if(code != 200 || !tokenExtractor.finish() || !received.accessToken[0]) {
+        Serial.print(F("Token request failed: "));
+        Serial.println(code);
+        return;
+    }
+    setField(auth.accessToken, received.accessToken);
+    // A refresh doesn't always come with a new refresh token
+    if(received.refreshToken[0] && strcmp(received.refreshToken, auth.refreshToken)) {
+        setField(auth.refreshToken, received.refreshToken);
+        token_saved = false;
+    }
+    unsigned long expires_ms = received_expires_s;
+    expires_ms = (expires_ms ? expires_ms : 3600) * 1000;
+    token_refresh_ms = millis() + (expires_ms > 2 * TOKEN_REFRESH_MARGIN_MS ? expires_ms - TOKEN_REFRESH_MARGIN_MS : expires_ms / 2);
+    tokenCacheStore(auth.accessToken, auth.refreshToken);
+}
 
-        next_lyric_ms = lyric_min*60000 + lyric_sec*1000 + lyric_ms;
+// Release the Spotify TLS buffers if both connections can't be open at once
+void makeRoomForAux() {
+    if(!spotifyHttp.smallBuffers()) {
+        spotifyHttp.stop();
+    }
+}
+
+// Blocking token request, used during startup
+void getToken(bool refresh, const char* code) {
+    auxHttp.collectCookies(NULL);
+    composeTokenRequest(auxHttp.compose(), refresh, code);
+    tokenExtractor.begin();
+    auxHttp.begin("accounts.spotify.com", &tokenExtractor, onToken);
+    if(auxHttp.wait() < 0) {
+        Serial.println("connection failed");
+    }
+}
+
+// Get a new access token in the background
+void refreshAccessToken() {
+    makeRoomForAux();
+    auxHttp.collectCookies(NULL);
+    composeTokenRequest(auxHttp.compose(), true, auth.refreshToken);
+    tokenExtractor.begin();
+    bool started = auxHttp.begin("accounts.spotify.com", &tokenExtractor, [](int code) {
+        onToken(code);
+        saveTokens();
+    });
+    if(!started) {
+        token_refresh_ms = millis() + TOKEN_RETRY_MS;
+    }
+}
 
-        if(!*p_lyric_next) { // The last lyric is an empty string.
-            p_lyric_next = NULL;
-            next_lyric_ms = UINT_MAX;
+typedef struct {
+    unsigned long total_ms;
+    unsigned int count;
+} PollLatency;
+PollLatency pollNew;
+PollLatency pollReused;
+unsigned long poll_start;
+unsigned long last_poll = 0;
+unsigned long poll_interval = 0;
+
+void printPollLatency() {
+    Serial.print(F("Avg poll latency: new "));
+    Serial.print(pollNew.count ? pollNew.total_ms / pollNew.count : 0);
+    Serial.print(F(" ms, reused "));
+    Serial.print(pollReused.count ? pollReused.total_ms / pollReused.count : 0);
+    Serial.println(F(" ms"));
+}
+
+// Fields of the currently-playing response, streamed straight into polled
+static const JsonField playback_fields[] = {
+    { "progress_ms", JSON_FIELD_UINT, &polled.progress, 0 },
+    { "is_playing", JSON_FIELD_BOOL, &polled.playing, 0 },
+    { "item.id", JSON_FIELD_STRING, polled.track_id, sizeof(polled.track_id) },
+    { "item.name", JSON_FIELD_STRING, polled.track_name, sizeof(polled.track_name) },
+    { "item.duration_ms", JSON_FIELD_UINT, &polled.duration, 0 },
+    { "item.album.name", JSON_FIELD_STRING, polled.album_name, sizeof(polled.album_name) },
+    { "item.artists[].name", JSON_FIELD_STRING, polled.artist_name, sizeof(polled.artist_name) },
+    { "item.artists[].name", JSON_FIELD_LIST, polled.artists, sizeof(polled.artists) }
+};
+JsonFieldExtractor playbackExtractor(playback_fields);
+
+// Take the polled state if the whole response arrived
+bool parsePlayback() {
+    if(!playbackExtractor.finish()) {
+        Serial.println(F("Incomplete playback response"));
+        return false;
+    }
+    // Spotify read the position about halfway through the round trip
+    unsigned long rtt = spotifyHttp.firstByteMillis() - spotifyHttp.sentMillis();
+    polled.latency = rtt / 2;
+    polled.millis = spotifyHttp.sentMillis() + polled.latency;
+    playback = polled;
+    return true;
+}
+
+void onPlayback(int ret_code);
+
+// Write a Web API request for the kept-alive api.spotify.com connection
+void composeSpotifyGet(const __FlashStringHelper* path) {
+    Print& out = spotifyHttp.compose();
+    out.print(F("GET "));
+    out.print(path);
+    out.print(F(" HTTP/1.1\r\n"
+                "Host: api.spotify.com\r\n"
+                "Authorization: Bearer "));
+    out.print(auth.accessToken);
+    out.print(F("\r\nConnection: keep-alive\r\n\r\n"));
+}
+
+void updatePlayback() {
+    composeSpotifyGet(F("/v1/me/player/currently-playing"));
+    poll_start = millis();
+    playbackExtractor.begin();
+    spotifyHttp.begin("api.spotify.com", &playbackExtractor, [](int ret_code) {
+        PollLatency& stat = spotifyHttp.reusedConnection() ? pollReused : pollNew;
+        stat.total_ms += millis() - poll_start;
+        stat.count++;
+        if(ret_code == 200 && !parsePlayback()) {
+            ret_code = 0;
+        }
+        onPlayback(ret_code);
+    });
+}
+
+typedef struct {
+    char id[TRACK_ID_MAX];
+    char name[TRACK_NAME_MAX];
+    char artist[ARTIST_NAME_MAX];
+    char album[TRACK_NAME_MAX];
+    unsigned int duration;
+} TrackInfo;
+
+TrackInfo lyricTrack;           // Track the lyric request is for
+LyricTimeline* lyricTarget = &lyrics;
+bool lyric_fetching = false;
+bool lyric_pending = false;     // Lyrics need to be fetched when the connection is free
+
+// Prefetched lyrics for the next track in the queue
+LyricTimeline nextLyrics;
+char nextLyricsTrack[TRACK_ID_MAX];
+TrackInfo queuedTrack;
+bool prefetch_done = false;
+
+void onLyrics(bool found) {
+    lyric_fetching = false;
+    if(found) {
+        lyricCache.store(lyricTrack.id, *lyricTarget);
+    }
+    if(lyricTarget == &nextLyrics) {
+        if(!found) {
+            nextLyrics.clear();
+        }
+        if(strcmp(lyricTrack.id, playback.track_id)) {
+            if(found) {
+                setField(nextLyricsTrack, lyricTrack.id);
+            }
+            return;
+        }
+        // The track started while its lyrics were being prefetched
+        lyrics.swap(nextLyrics);
+        nextLyrics.clear();
+    } else if(strcmp(lyricTrack.id, playback.track_id)) {
+        lyrics.clear(); // Track changed while fetching
+        return;
+    }
+    if(found) {
+        lyricHub.lyricsChanged();
+        if(playback.playing) {
+            startLyric(true);
         }
-        return true;
     } else {
-        p_lyric_next = NULL;
-        next_lyric_ms = UINT_MAX;
-        return false; //error
+        lyrics.clear();
+        Serial.println(F("No synced lyrics"));
+        lcd.setCursor(0,3);
+        lcd.print("(No Synced Lyrics)");
     }
 }
 
-// Print the string to the LCD with word wrapping.
-// The diplayed string is truncated if it is too long.
-// Returns the length of the string.
-size_t printWrap(const char* str, const char end) {
-    lcd.clear();
-    char c;
-    size_t len = 0;
-    unsigned int col = 0;
-    unsigned int line = 0;
-    while((c = *str++) != end) {
-        len++;
-        unsigned int wcnt = 1;
-        if(c == ' ') {
-            const char* tmp = str;
-            while(*tmp && *tmp != ' ' && *tmp++ != end) {
-                wcnt++;
-            }
-            if(col == 0) {
-                continue;
-            } else if(col + wcnt > LCD_COLS && wcnt < LCD_COLS) {
-                lcd.setCursor(0, ++line);
-                col = 0;
-                continue;
-            }
+// Start fetching lyrics for a track in the background
+void fetchLyrics(const TrackInfo& track, LyricTimeline& target) {
+    lyricFetcher.abort();
+    makeRoomForAux();
+    lyricTrack = track;
+    lyricTarget = &target;
+    LyricQuery query = { lyricTrack.id, lyricTrack.name, lyricTrack.artist, lyricTrack.album, lyricTrack.duration };
+    lyric_fetching = lyricFetcher.fetch(query, target, onLyrics);
+}
+
+// Fields of the first track in the queue. The rest of the queue is skipped.
+static const JsonField queue_fields[] = {
+    { "queue[].id", JSON_FIELD_STRING, queuedTrack.id, sizeof(queuedTrack.id) },
+    { "queue[].name", JSON_FIELD_STRING, queuedTrack.name, sizeof(queuedTrack.name) },
+    { "queue[].artists[].name", JSON_FIELD_STRING, queuedTrack.artist, sizeof(queuedTrack.artist) },
+    { "queue[].album.name", JSON_FIELD_STRING, queuedTrack.album, sizeof(queuedTrack.album) },
+    { "queue[].duration_ms", JSON_FIELD_UINT, &queuedTrack.duration, 0 },
+    { "queue[]", JSON_FIELD_END, NULL, 0 }
+};
+JsonFieldExtractor queueExtractor(queue_fields);
+
+// Look up the next track in the queue and get its lyrics ready
+void prefetchNext() {
+    composeSpotifyGet(F("/v1/me/player/queue"));
+    queueExtractor.begin();
+    spotifyHttp.begin("api.spotify.com", &queueExtractor, [](int ret_code) {
+        if(ret_code != 200 || !queueExtractor.finish()) {
+            queuedTrack.id[0] = '\0';
         }
-        if(col < LCD_COLS && line < LCD_LINES) {
-            lcd.write(c);
+        if(!queuedTrack.id[0] || !strcmp(queuedTrack.id, playback.track_id) || !strcmp(queuedTrack.id, nextLyricsTrack)) {
+            return;
         }
-        if(++col == LCD_COLS) {
-            lcd.setCursor(0, ++line);
-            col = 0;
+        Serial.print(F("Prefetching: "));
+        Serial.println(queuedTrack.name);
+        nextLyricsTrack[0] = '\0';
+        if(lyricCache.load(queuedTrack.id, nextLyrics)) {
+            setField(nextLyricsTrack, queuedTrack.id);
+        } else if(!auxHttp.busy()) {
+            fetchLyrics(queuedTrack, nextLyrics);
         }
-    }
-    return len;
+    });
 }
 
-void displayLyric() {
-    p_lyric_current = p_lyric_next;
-    size_t len = printWrap(p_lyric_next, '\n');
-    p_lyric_next+= (len+1);
-    if(nextLyric()) {
-        unsigned int lyric_delay = next_lyric_ms - ((unsigned int)(millis() - playback.millis) + playback.progress);
-        displayTicker.once_ms(lyric_delay, displayLyric);
-    }
+unsigned int playbackProgress() {
+    return playbackClock.progress(millis());
 }
 
+// Called from displayTicker: the only place the lyric display runs
+void displayTick() {
+    lyricDisplay.tick();
+}
+
+// Have the display follow the current playback position. It shows the
+// page at that position if it differs from what is shown (or always, if
+// force is set), and schedules the following ones.
 void startLyric(bool force) {
-    unsigned int progress_ms = (millis() - playback.millis) + playback.progress;
-    const char* last_lyric = NULL;
-    while(progress_ms > next_lyric_ms) {
-        last_lyric = p_lyric_next;
-        while(*p_lyric_next++ != '\n'); // skip
-        if(!nextLyric() || !p_lyric_next) {
-            break;
-        }
+    unsigned int progress_ms = playbackProgress();
+    if(force || lyrics.findPage(progress_ms) != lyricDisplay.page()) {
+        Serial.print(F("<RESYNC> +/-"));
+        Serial.print(playbackClock.errorBudget(millis()));
+        Serial.println(F(" ms"));
     }
-    // Display the last lyric
-    if(force || p_lyric_current != last_lyric) {
-        Serial.println("<RESYNC>");
-        if(last_lyric) {
-            printWrap(last_lyric, '\n');
-        } else if(!force) {
-            lcd.clear();
-        }
-        p_lyric_current = last_lyric;
+    if(force) {
+        traceLog.lyrics(lyrics);
+    }
+    lyricHub.beacon();
+    if(!lyricDisplay.sync(progress_ms, force)) {
+        Serial.println(F("Display queue full"));
+    }
+}
+
+// Remember the track being played, to have its lyrics ready after a reboot.
+// It is only written once it has played for a while, so skipping through
+// a playlist doesn't write the flash for every track.
+void savePlayingTrack() {
+    if(!strcmp(lastTrack, playingSaved) || millis() - track_start_ms < PLAYING_SAVE_DELAY_MS) {
+        return;
     }
-    // Schedule the next lyric
-    if(p_lyric_next) {
-        unsigned int lyric_delay = next_lyric_ms - progress_ms;
-        displayTicker.once_ms(lyric_delay, displayLyric);
+    File f = LittleFS.open(F(PLAYING_FILE), "w");
+    if(f) {
+        f.print(lastTrack);
+        f.close();
+        setField(playingSaved, lastTrack);
+    }
+}
+
+// Load the lyrics of the track that was playing before the reboot as if
+// they had been prefetched, while the first poll finds out what is playing
+void preloadPlayingTrack() {
+    char track_id[TRACK_ID_MAX];
+    File f = LittleFS.open(F(PLAYING_FILE), "r");
+    if(!f) {
+        return;
+    }
+    size_t len = f.readBytes(track_id, sizeof(track_id) - 1);
+    track_id[len] = '\0';
+    f.close();
+    setField(playingSaved, track_id);
+    if(len && lyricCache.load(track_id, nextLyrics)) {
+        setField(nextLyricsTrack, track_id);
+        Serial.println(F("Preloaded lyrics of the last track"));
     }
 }
 
 void setup() {
     Serial.begin(115200);
+    bootPhase(F("reset"));
     if(!LittleFS.begin()) {
         Serial.println(F("FATAL: filesystem error"));
         while(1) yield();
     }
-    lcd.begin();
+    lyricCache.begin();
+    lyricProviders.add(lyricFiles);
+    lyricProviders.add(musixmatch);
+    lyricProviders.add(lrclib);
+    spotifyHttp.setSmallBuffers(true);
+    // Only the lyric providers: currently-playing responses refer back
+    // further than the decoder's window
+    auxHttp.setGzip(true);
+#ifdef LYRIC_HUB
+    lyricHub.begin();
+#endif
+    spotifyHttp.setTrace(&traceLog, TRACE_CHANNEL_SPOTIFY);
+    auxHttp.setTrace(&traceLog, TRACE_CHANNEL_AUX);
+    lyricDisplay.setTrace(&traceLog);
+    lcd.begin(true);
+    lcd.setGlyphs(GLYPH_BASE, GLYPH_COUNT, glyph_bitmaps, glyph_fallback);
+    displayTicker.attach_ms(DISPLAY_TICK_MS, displayTick);
     lcd.clear();
     lcd.print("Connecting to");
     lcd.setCursor(0,1);
     lcd.print(WIFI_SSID);
-    WiFi.begin(WIFI_SSID, WIFI_PASS);
-    while(WiFi.status() != WL_CONNECTED) {
-        delay(1000);
-        Serial.print('.');
+    wifiBegin(WIFI_SSID, WIFI_PASS);
+
+    // While associating, get everything ready that doesn't need the network
+    if(tokenCacheLoad(auth.accessToken, sizeof(auth.accessToken), auth.refreshToken, sizeof(auth.refreshToken))) {
+        // Warm boot: the refresh token is already in flash
+        Serial.println(F("Loaded token from RTC memory"));
+        token_saved = true;
+    } else if(loadTokens()) {
+        token_saved = true;
     }
+    // Start with the old access token, if there is one, and refresh it
+    // once the first track is up
+    token_refresh_ms = millis() + TOKEN_RETRY_MS;
+    loadTlsSession();
+    preloadPlayingTrack();
+    bootPhase(F("storage"));
+
+    wifiWait(WIFI_SSID, WIFI_PASS);
+    bootPhase(F("wifi"));
     Serial.println(F("Connected"));
     Serial.println(WiFi.localIP());
     lcd.clear();
@@ -480,99 +721,201 @@ void setup() {
     lcd.setCursor(0,1);
     lcd.print(WiFi.localIP());
 
-    String refreshToken = loadRefreshToken();
-    if (refreshToken == "") {
+    if(!MDNS.begin(MDNS_HOSTNAME)) {
+        Serial.println(F("FATAL: MDNS error"));
+        while(1) yield();
+    }
+    Serial.println(F("mDNS started"));
+    server.on("/metrics", handleMetrics);
+    server.on("/lyrics", handleFeedPage);
+    server.on("/events", handleEvents);
+    server.on("/trace", handleTrace);
+    server.on("/trace/start", handleTraceStart);
+    server.on("/trace/stop", handleTraceStop);
+    server.begin();
+    Serial.println(F("HTTP server started"));
+    bootPhase(F("services"));
+
+    if(auth.accessToken[0]) {
+        Serial.println(F("Using saved access token"));
+    } else if(auth.refreshToken[0]) {
+        getToken(true, auth.refreshToken);
+    } else {
         lcd.setCursor(0,0);
         lcd.print("Please visit");
         lcd.setCursor(0,2);
         lcd.print("in your web browser");
-        String authCode = spotifyAuth();
-        getToken(false, authCode);
+        getToken(false, spotifyAuth().c_str());
         lcd.clear();
         lcd.print("Connected!");
-    } else {
-        getToken(true, refreshToken);
     }
-    if (auth.refreshToken != "") {
-        saveRefreshToken(auth.refreshToken);
-    } else if(auth.accessToken == "") {
+    if (auth.refreshToken[0]) {
+        saveTokens();
+    }
+    if(!auth.accessToken[0]) {
         Serial.println(F("Auth failed! Please check API credentials."));
         lcd.clear();
         lcd.print("Spotify auth failed!");
         LittleFS.remove(F("/sptoken.txt"));
         while(1) yield();
     }
+    bootPhase(F("token"));
 }
 
-void loop() {
-    static unsigned long last_update = 0;
-    unsigned long now = millis();
-    unsigned int progress_ms = (unsigned int)(now - playback.millis) + playback.progress;
-    static const char* last_printed = NULL;
-        static int flag = 0;
-
-    if(now - last_update > PLAYBACK_REFRSH_INTERVAL || progress_ms > playback.duration) {
-        int ret_code = updatePlayback();
-        last_update = millis();
-        if(ret_code == 200) {
-            // Serial.print("UpdateTime: ");
-            // Serial.println(last_update-now);
-
-            displayTicker.detach();
-            if(playback.playing) {
-                // If current track changed, reload lyrics
-                if(playback.track_id != lastTrack) {
-                    Serial.println();
-                    Serial.println(playback.track_name);
-                    Serial.println(playback.artist_name);
-                    char line_buf[21];
-                    lcd.clear();
-                    snprintf(line_buf, sizeof(line_buf), playback.track_name.c_str());
-                    lcd.print(line_buf);
-                    snprintf(line_buf, sizeof(line_buf), playback.artist_name.c_str());
-                    lcd.setCursor(0,1);
-                    lcd.print(line_buf);
-                    lastTrack = playback.track_id;
-                    progress_ms = playback.progress;
-                    getLyrics();
-                    if(!nextLyric()) {
-                        lcd.setCursor(0,3);
-                        lcd.print("(No Synced Lyrics)");
-                    } else {
-                        startLyric(true);
-                    }
-                } else if(p_lyric_start) {
-                    // Re-sync lyrics
-                    p_lyric_next = p_lyric_start;
-                    if(nextLyric()) {
-                        startLyric(false);
+void onPlayback(int ret_code) {
+    last_poll = millis();
+    heapSample();
+    poll_interval = PLAYBACK_RETRY_INTERVAL;
+    if(ret_code == 200) {
+        if(!boot_polled) {
+            boot_polled = true;
+            bootPhase(F("first poll"));
+            if(!spotifyHttp.reusedConnection()) {
+                saveTlsSession();
+            }
+        }
+        playbackClock.update(playback.millis, playback.progress, playback.duration, playback.playing, !strcmp(playback.track_id, lastTrack), playback.latency);
+        poll_interval = playbackClock.nextPoll();
+        if(playback.playing) {
+            // If current track changed, reload lyrics
+            if(strcmp(playback.track_id, lastTrack)) {
+                lyricDisplay.reset();
+                Serial.println();
+                Serial.println(playback.track_name);
+                Serial.println(playback.artists);
+                lcd.frameClear();
+                frameText(lcd, 0, playback.track_name);
+                frameText(lcd, 1, playback.artists);
+                lcd.noCursor();
+                lcd.flush();
+                lyricFeed.track(playback.track_name, playback.artists);
+                lyricHub.track(playback.track_name, playback.artists);
+                setField(lastTrack, playback.track_id);
+                track_start_ms = millis();
+                printPollLatency();
+                spotifyHttp.printStats(Serial, F("api.spotify.com"));
+                auxHttp.printStats(Serial, F("Lyric providers"));
+                playbackClock.printStats(Serial);
+                profilePrintSummary(Serial);
+                heapPrintSummary(Serial);
+                lyricProviders.printStats(Serial);
+                lyricFeed.printStats(Serial);
+                lyricHub.printStats(Serial);
+                lyric_printed = -1;
+                prefetch_done = false;
+                if(!strcmp(nextLyricsTrack, playback.track_id)) {
+                    // Prefetched while the previous track was playing
+                    Serial.println(F("Using prefetched lyrics"));
+                    lyrics.swap(nextLyrics);
+                    lyric_pending = false;
+                    lyricHub.lyricsChanged();
+                    startLyric(true);
+                } else if(lyric_fetching && lyricTarget == &nextLyrics && !strcmp(lyricTrack.id, playback.track_id)) {
+                    // Prefetch still running, it will be used when done
+                    lyrics.clear();
+                    lyric_pending = false;
+                } else if(lyricCache.load(playback.track_id, lyrics)) {
+                    Serial.println(F("Lyrics loaded from cache"));
+                    lyric_pending = false;
+                    if(lyric_fetching) {
+                        lyricFetcher.abort();
+                        lyric_fetching = false;
                     }
+                    lyricHub.lyricsChanged();
+                    startLyric(true);
+                } else {
+                    lyrics.clear();
+                    lyric_pending = true;
                 }
-            } else {
-                Serial.println("<PAUSED>");
-            }
-        } else if(ret_code == 401) { // Unauthorized (access token expired)
-            String refreshToken = loadRefreshToken();
-            getToken(true, refreshToken);
-            if(auth.refreshToken != "") {
-                saveRefreshToken(auth.refreshToken);
+                // Drop a prefetch for a track that turned out not to be next
+                nextLyrics.clear();
+                nextLyricsTrack[0] = '\0';
+            } else if(lyrics.size() && !(lyric_fetching && lyricTarget == &lyrics)) {
+                // Re-sync lyrics
+                startLyric(false);
             }
-        } else if(ret_code == 204) { // No Content (nothing playing)
-            Serial.println("<STOPPED>");
-            displayTicker.detach();
-            lcd.clear();
-            lcd.print("Playback Stopped.");
+            savePlayingTrack();
         } else {
-            Serial.print("Retry ");
-            Serial.println(ret_code);
-            last_update += PLAYBACK_REFRSH_INTERVAL - PLAYBACK_RETRY_INTERVAL;
+            lyricDisplay.stop();
+            lyricHub.beacon();
+            Serial.println("<PAUSED>");
         }
-    } else if(p_lyric_current && p_lyric_current != last_printed && !flag) {
-        const char* c = p_lyric_current;
-        while(*c != '\n') {
-            Serial.write(*c++);
+    } else if(ret_code == 401) { // Unauthorized (access token expired)
+        poll_interval = POLL_INTERVAL_MIN;
+        if(!auxHttp.busy()) {
+            refreshAccessToken();
         }
+    } else if(ret_code == 204) { // No Content (nothing playing)
+        poll_interval = POLL_INTERVAL_PAUSED;
+        Serial.println("<STOPPED>");
+        lyricDisplay.reset();
+        lcd.clear();
+        lcd.print("Playback Stopped.");
+    } else {
+        Serial.print("Retry ");
+        Serial.println(ret_code);
+    }
+}
+
+void loop() {
+    unsigned long now = millis();
+        static int flag = 0;
+
+    spotifyHttp.poll();
+    auxHttp.poll();
+    server.handleClient();
+    MDNS.update();
+    if(now - feed_progress_ms >= FEED_PROGRESS_MS) {
+        feed_progress_ms = now;
+        lyricFeed.progress(playbackProgress(), playback.playing);
+    }
+    lyricFeed.poll();
+    lyricHub.poll(playbackProgress(), playback.playing);
+    DisplayShown shown;
+    while(lyricDisplay.shown(shown)) {
+        TraceDisplay rec = { shown.progress_ms, shown.page };
+        traceLog.record(TRACE_PAGE, 0, &rec, sizeof(rec));
+        if(!boot_shown) {
+            boot_shown = true;
+            bootPhase(F("first lyric"));
+        }
+    }
+
+    // A lyric request replaces one for a previous track, but waits for
+    // anything else using the connection.
+    if(lyric_pending && (lyric_fetching || !auxHttp.busy())) {
+        TrackInfo track;
+        setField(track.id, playback.track_id);
+        setField(track.name, playback.track_name);
+        setField(track.artist, playback.artist_name);
+        setField(track.album, playback.album_name);
+        track.duration = playback.duration;
+        lyric_pending = false;
+        fetchLyrics(track, lyrics);
+    }
+
+    // Refresh the access token before it expires, while both connections
+    // are idle, so polling never waits for it
+    if((long)(now - token_refresh_ms) >= 0 && !lyric_pending && !auxHttp.busy() && !spotifyHttp.busy()) {
+        refreshAccessToken();
+    }
+
+    // Once the track has settled, get the next track's lyrics ready
+    if(!prefetch_done && !lyric_pending && !lyric_fetching && !auxHttp.busy() && !spotifyHttp.busy() &&
+       playback.playing && !strcmp(playback.track_id, lastTrack) && playbackProgress() > PREFETCH_DELAY_MS) {
+        prefetch_done = true;
+        prefetchNext();
+    }
+
+    // Keep polling while a lyric request is running, if memory allows
+    bool can_poll = !spotifyHttp.busy() && (!auxHttp.busy() || spotifyHttp.smallBuffers());
+    if(can_poll && now - last_poll >= poll_interval) {
+        updatePlayback();
+    } else if(lyricDisplay.page() >= 0 && (size_t)lyricDisplay.page() < lyrics.pages() &&
+              lyrics.page(lyricDisplay.page()).line != lyric_printed && !flag) {
+        lyric_printed = lyrics.page(lyricDisplay.page()).line;
+        lyricFeed.line(lyric_printed);
+        glyphPrint(Serial, lyrics.text(lyric_printed), lyrics.length(lyric_printed));
         Serial.write('\n');
-        last_printed = p_lyric_current;
     }
 }
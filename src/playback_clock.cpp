@@ -0,0 +1,179 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "playback_clock.h"
+
+#include <inttypes.h>
+#include <math.h>
+
+#define SYNC_DRIFT_GAIN         0.05f
+#define SYNC_DRIFT_LIMIT        0.002f  // Max believable drift (2 ms per second)
+#define SYNC_ERROR_GAIN         0.2f
+#define SYNC_SEEK_WINDOW_MIN    5.0f    // Seek rate averaging window (minutes)
+#define SYNC_PROCESS_NOISE      0.5f    // Position variance gained per ms of playback (ms^2)
+#define SYNC_SAMPLE_JITTER      20      // Server side position granularity (ms)
+
+// Upper edges of the prediction error histogram bins (ms).
+// The last bin has no upper edge.
+static const int16_t hist_edges[SYNC_HISTOGRAM_BINS - 1] = {
+    -800, -400, -200, -100, -50, 0, 50, 100, 200, 400, 800
+};
+
+PlaybackClock::PlaybackClock() {
+    sample_ms = 0;
+    sample_progress = 0;
+    duration = 0;
+    playing = false;
+    valid = false;
+    unstable = POLL_UNSTABLE_COUNT;
+    drift = 0;
+    error_avg = 0;
+    seek_rate = 0;
+    variance = 0;
+    last_error = 0;
+    seeks = 0;
+    memset(error_hist, 0, sizeof(error_hist));
+}
+
+int32_t PlaybackClock::binEdge(uint8_t bin) {
+    return bin < SYNC_HISTOGRAM_BINS - 1 ? hist_edges[bin] : INT32_MAX;
+}
+
+// Add a poll result taken at local time sample_ms, give or take uncertainty ms
+void PlaybackClock::update(unsigned long new_ms, unsigned int new_progress, unsigned int new_duration, bool new_playing, bool same_track, unsigned int uncertainty) {
+    bool changed = !valid || !same_track || new_playing != playing;
+    // The sample time is spread evenly over +/- uncertainty
+    float sample_var = (float)uncertainty * uncertainty / 3 + SYNC_SAMPLE_JITTER * SYNC_SAMPLE_JITTER;
+    unsigned int estimate = new_progress;
+    if(!changed && playing) {
+        unsigned long dt = new_ms - sample_ms;
+        int32_t err = (int32_t)new_progress - (int32_t)progress(new_ms);
+        int32_t abs_err = err < 0 ? -err : err;
+        float minutes = dt / 60000.0f;
+        float decay = minutes < SYNC_SEEK_WINDOW_MIN ? 1.0f - minutes / SYNC_SEEK_WINDOW_MIN : 0.0f;
+        last_error = err;
+
+        seek_rate *= decay;
+        if(abs_err > SYNC_SEEK_THRESHOLD) {
+            seeks++;
+            seek_rate += 1.0f / SYNC_SEEK_WINDOW_MIN;
+            changed = true;
+        } else {
+            uint8_t bin = 0;
+            while(bin < SYNC_HISTOGRAM_BINS - 1 && err >= hist_edges[bin]) bin++;
+            error_hist[bin]++;
+            error_avg += SYNC_ERROR_GAIN * (abs_err - error_avg);
+            if(abs_err > SYNC_ERROR_TOLERANCE && unstable < 1) {
+                unstable = 1;
+            }
+
+            // Weigh the sample against the prediction
+            float predicted_var = variance + SYNC_PROCESS_NOISE * dt;
+            float gain = predicted_var / (predicted_var + sample_var);
+            estimate = progress(new_ms) + (int32_t)(gain * err);
+            variance = (1.0f - gain) * predicted_var;
+            if(dt) {
+                drift += SYNC_DRIFT_GAIN * gain * ((float)err / dt);
+                drift = constrain(drift, -SYNC_DRIFT_LIMIT, SYNC_DRIFT_LIMIT);
+            }
+        }
+    }
+
+    if(changed) {
+        unstable = POLL_UNSTABLE_COUNT;
+        variance = sample_var;
+    } else if(unstable) {
+        unstable--;
+    }
+
+    sample_ms = new_ms;
+    sample_progress = estimate;
+    duration = new_duration;
+    playing = new_playing;
+    valid = true;
+}
+
+// Predicted playback position at local time now
+unsigned int PlaybackClock::progress(unsigned long now) const {
+    if(!playing) {
+        return sample_progress;
+    }
+    unsigned long elapsed = now - sample_ms;
+    return sample_progress + elapsed + (int32_t)(elapsed * drift);
+}
+
+// Expected error (ms, one standard deviation) of progress(now)
+unsigned int PlaybackClock::errorBudget(unsigned long now) const {
+    float var = variance;
+    if(playing) {
+        var += SYNC_PROCESS_NOISE * (now - sample_ms);
+    }
+    return (unsigned int)sqrtf(var);
+}
+
+// How long after the last sample the next poll should happen (ms)
+unsigned long PlaybackClock::nextPoll() const {
+    if(!valid || !playing) {
+        return POLL_INTERVAL_PAUSED;
+    }
+    if(unstable) {
+        return POLL_INTERVAL_MIN;
+    }
+    float interval = POLL_INTERVAL_MAX;
+    if(error_avg > SYNC_ERROR_TOLERANCE) {
+        interval *= SYNC_ERROR_TOLERANCE / error_avg;
+    }
+    interval /= 1.0f + seek_rate;
+    interval = constrain(interval, (float)POLL_INTERVAL_MIN, (float)POLL_INTERVAL_MAX);
+
+    // Catch the next track soon after this one ends
+    if(duration > sample_progress) {
+        float remaining = (duration - sample_progress) / (1.0f + drift) + POLL_TRACK_END_MARGIN;
+        if(remaining < interval) {
+            interval = remaining;
+        }
+    } else {
+        interval = POLL_TRACK_END_MARGIN;
+    }
+    return (unsigned long)interval;
+}
+
+void PlaybackClock::printStats(Print& out) const {
+    out.print(F("Sync: err avg "));
+    out.print((int)error_avg);
+    out.print(F(" ms, budget "));
+    out.print((int)sqrtf(variance));
+    out.print(F(" ms, last "));
+    out.print(last_error);
+    out.print(F(" ms, drift "));
+    out.print((int)(drift * 1e6f));
+    out.print(F(" ppm, seeks "));
+    out.print(seeks);
+    out.print(F(", hist"));
+    for(uint8_t i=0; i<SYNC_HISTOGRAM_BINS; i++) {
+        out.print(' ');
+        out.print(error_hist[i]);
+    }
+    out.println();
+}
@@ -0,0 +1,132 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "profiler.h"
+
+#include <inttypes.h>
+
+typedef struct {
+    uint32_t count;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t bins[PROFILE_BINS];
+} ProfileHistogram;
+
+static ProfileHistogram probes[PROFILE_PROBES];
+
+static const char probe_names[PROFILE_PROBES][14] PROGMEM = {
+    "tls_connect",
+    "http_headers",
+    "json_parse",
+    "lyric_frame",
+    "lcd_flush",
+    "ticker_late"
+};
+
+void IRAM_ATTR profileRecord(uint8_t probe, uint32_t cycles) {
+    ProfileHistogram& h = probes[probe];
+    int bin = cycles ? 32 - __builtin_clz(cycles) - PROFILE_BIN_SHIFT : 0;
+    if(bin < 0) {
+        bin = 0;
+    } else if(bin >= PROFILE_BINS) {
+        bin = PROFILE_BINS - 1;
+    }
+    h.bins[bin]++;
+    h.count++;
+    h.sum += cycles;
+    if(cycles > h.max) {
+        h.max = cycles;
+    }
+}
+
+// Upper edge of a bin in cycles
+static uint32_t binEdge(uint8_t bin) {
+    return (uint32_t)1 << (bin + PROFILE_BIN_SHIFT);
+}
+
+// Prometheus text exposition format. Lines must end in a bare '\n', so
+// println() (which ends them with "\r\n") isn't used.
+void profilePrintMetrics(Print& out) {
+    double cycles_per_s = ESP.getCpuFreqMHz() * 1e6;
+    out.print(F("# HELP karaoke_duration_seconds Time spent in instrumented code paths\n"
+                "# TYPE karaoke_duration_seconds histogram\n"));
+    for(uint8_t p=0; p<PROFILE_PROBES; p++) {
+        const ProfileHistogram& h = probes[p];
+        const __FlashStringHelper* name = FPSTR(probe_names[p]);
+        uint32_t cumulative = 0;
+        for(uint8_t i=0; i<PROFILE_BINS; i++) {
+            cumulative += h.bins[i];
+            out.print(F("karaoke_duration_seconds_bucket{probe=\""));
+            out.print(name);
+            out.print(F("\",le=\""));
+            if(i < PROFILE_BINS - 1) {
+                out.print(binEdge(i) / cycles_per_s, 9);
+            } else {
+                out.print(F("+Inf"));
+            }
+            out.print(F("\"} "));
+            out.print(cumulative);
+            out.print('\n');
+        }
+        out.print(F("karaoke_duration_seconds_sum{probe=\""));
+        out.print(name);
+        out.print(F("\"} "));
+        out.print(h.sum / cycles_per_s, 6);
+        out.print('\n');
+        out.print(F("karaoke_duration_seconds_count{probe=\""));
+        out.print(name);
+        out.print(F("\"} "));
+        out.print(h.count);
+        out.print('\n');
+    }
+}
+
+// One line per probe with samples: count, average, 90th percentile
+// (upper bin edge) and maximum, in microseconds
+void profilePrintSummary(Print& out) {
+    uint32_t mhz = ESP.getCpuFreqMHz();
+    for(uint8_t p=0; p<PROFILE_PROBES; p++) {
+        const ProfileHistogram& h = probes[p];
+        if(!h.count) {
+            continue;
+        }
+        uint32_t target = h.count - h.count / 10;
+        uint32_t cumulative = 0;
+        uint8_t bin = 0;
+        while(bin < PROFILE_BINS - 1 && (cumulative += h.bins[bin]) < target) {
+            bin++;
+        }
+        out.print(F("Prof: "));
+        out.print(FPSTR(probe_names[p]));
+        out.print(F(" n="));
+        out.print(h.count);
+        out.print(F(" avg="));
+        out.print((uint32_t)(h.sum / h.count / mhz));
+        out.print(F(" p90<"));
+        out.print((bin < PROFILE_BINS - 1 ? min(binEdge(bin), h.max) : h.max) / mhz);
+        out.print(F(" max="));
+        out.print(h.max / mhz);
+        out.println(F(" us"));
+    }
+}
@@ -0,0 +1,74 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "text_layout.h"
+#include "profiler.h"
+
+#include <inttypes.h>
+
+// Print the string to the LCD with word wrapping.
+// The diplayed string is truncated if it is too long.
+// Only the characters that differ from the current display are sent.
+void printWrap(LCD2004& lcd, const char* str, size_t len) {
+    {
+        ProfileScope scope(PROFILE_LYRIC_FRAME);
+        const char* end = str + len;
+        const char* row;
+        uint8_t row_len;
+        lcd.frameClear();
+        for(uint8_t r=0; r<LCD_LINES && wrapRow(str, end, LCD_COLS, row, row_len); r++) {
+            for(uint8_t col=0; col<row_len; col++) {
+                lcd.frameWrite(col, r, row[col]);
+            }
+        }
+    }
+    lcd.flush();
+}
+
+// Show a page laid out when the lyrics were loaded
+void printPage(LCD2004& lcd, const LyricTimeline& lyrics, size_t idx) {
+    uint32_t glyphs;
+    {
+        ProfileScope scope(PROFILE_LYRIC_FRAME);
+        const LyricPage& page = lyrics.page(idx);
+        lcd.frameClear();
+        for(uint8_t r=0; r<LCD_LINES; r++) {
+            const char* row = lyrics.row(idx, r);
+            for(uint8_t col=0; col<page.len[r]; col++) {
+                lcd.frameWrite(col, r, row[col]);
+            }
+        }
+        glyphs = page.glyphs;
+    }
+    lcd.flush(glyphs);
+}
+
+// Put a UTF-8 string on a row of the frame, truncated to fit
+void frameText(LCD2004& lcd, uint8_t row, const char* utf8) {
+    char buf[LCD_COLS + 1];
+    size_t len = glyphEncode(utf8, buf, sizeof(buf));
+    for(uint8_t col=0; col<len; col++) {
+        lcd.frameWrite(col, row, buf[col]);
+    }
+}
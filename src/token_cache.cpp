@@ -0,0 +1,87 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "token_cache.h"
+
+#include <inttypes.h>
+
+#define TOKEN_CACHE_MAGIC       0x314B5054 // "TPK1"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t checksum;      // Of everything after this field
+    uint16_t access_len;    // 0 if the access token didn't fit
+    uint16_t refresh_len;
+    char data[TOKEN_CACHE_SIZE - 12];   // Refresh token, then access token
+} TokenCacheBlock;
+
+static_assert(sizeof(TokenCacheBlock) == TOKEN_CACHE_SIZE, "Token cache block must fill its RTC area");
+
+// FNV-1a
+static uint32_t checksum(const TokenCacheBlock& block) {
+    const uint8_t* p = (const uint8_t*)&block.access_len;
+    const uint8_t* end = (const uint8_t*)block.data + block.refresh_len + block.access_len;
+    uint32_t hash = 2166136261u;
+    while(p != end) {
+        hash = (hash ^ *p++) * 16777619u;
+    }
+    return hash;
+}
+
+// Read the tokens saved before the last reset. Returns false if there
+// are none (e.g. after power-on); the access token may still be empty.
+bool tokenCacheLoad(char* access, size_t access_size, char* refresh, size_t refresh_size) {
+    TokenCacheBlock block;
+    access[0] = refresh[0] = '\0';
+    if(!ESP.rtcUserMemoryRead(TOKEN_CACHE_RTC_OFFSET, (uint32_t*)&block, sizeof(block)) ||
+       block.magic != TOKEN_CACHE_MAGIC || !block.refresh_len ||
+       (size_t)block.refresh_len + block.access_len > sizeof(block.data) ||
+       block.refresh_len >= refresh_size || block.access_len >= access_size || block.checksum != checksum(block)) {
+        return false;
+    }
+    memcpy(refresh, block.data, block.refresh_len);
+    refresh[block.refresh_len] = '\0';
+    memcpy(access, block.data + block.refresh_len, block.access_len);
+    access[block.access_len] = '\0';
+    return true;
+}
+
+bool tokenCacheStore(const char* access, const char* refresh) {
+    TokenCacheBlock block;
+    size_t refresh_len = strlen(refresh);
+    size_t access_len = strlen(access);
+    if(refresh_len > sizeof(block.data)) {
+        return false;
+    }
+    if(refresh_len + access_len > sizeof(block.data)) {
+        access_len = 0;
+    }
+    block.magic = TOKEN_CACHE_MAGIC;
+    block.access_len = access_len;
+    block.refresh_len = refresh_len;
+    memcpy(block.data, refresh, refresh_len);
+    memcpy(block.data + refresh_len, access, access_len);
+    block.checksum = checksum(block);
+    return ESP.rtcUserMemoryWrite(TOKEN_CACHE_RTC_OFFSET, (uint32_t*)&block, sizeof(block));
+}
@@ -0,0 +1,88 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "trace.h"
+
+// Counts what is written to it
+class SizePrint : public Print
+{
+    public:
+        SizePrint() : len(0) {}
+        size_t write(uint8_t) override { len++; return 1; }
+        size_t write(const uint8_t*, size_t size) override { len += size; return size; }
+        size_t len;
+};
+
+bool TraceWriter::record(uint8_t type, uint8_t channel, const void* data, size_t len) {
+    if(len > UINT16_MAX) {
+        return false;
+    }
+    TraceRecord rec = { (uint32_t)millis(), type, channel, (uint16_t)len };
+    Print* out = reserve(sizeof(rec) + len);
+    if(!out) {
+        return false;
+    }
+    out->write((const uint8_t*)&rec, sizeof(rec));
+    return out->write((const uint8_t*)data, len) == len;
+}
+
+bool TraceWriter::lyrics(const LyricTimeline& lyrics) {
+    SizePrint size;
+    if(!lyrics.serialize(size) || size.len > UINT16_MAX) {
+        return false;
+    }
+    TraceRecord rec = { (uint32_t)millis(), TRACE_LYRICS, 0, (uint16_t)size.len };
+    Print* out = reserve(sizeof(rec) + size.len);
+    if(!out) {
+        return false;
+    }
+    out->write((const uint8_t*)&rec, sizeof(rec));
+    return lyrics.serialize(*out) == size.len;
+}
+
+bool TraceReader::begin() {
+    uint32_t magic;
+    remaining = 0;
+    return in.readBytes((uint8_t*)&magic, sizeof(magic)) == sizeof(magic) && magic == TRACE_MAGIC;
+}
+
+bool TraceReader::next(TraceRecord& rec) {
+    while(remaining) {
+        uint8_t buf[64];
+        if(!read(buf, min(remaining, sizeof(buf)))) {
+            return false;
+        }
+    }
+    if(in.readBytes((uint8_t*)&rec, sizeof(rec)) != sizeof(rec)) {
+        return false;
+    }
+    remaining = rec.len;
+    return true;
+}
+
+size_t TraceReader::read(void* buf, size_t len) {
+    size_t n = in.readBytes((uint8_t*)buf, min(len, remaining));
+    remaining = n < min(len, remaining) ? 0 : remaining - n;
+    return n;
+}
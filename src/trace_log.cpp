@@ -0,0 +1,90 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "trace_log.h"
+
+#include <LittleFS.h>
+
+// Start a new trace, discarding any previous one
+bool TraceLog::start() {
+    stop();
+    LittleFS.remove(F(TRACE_FILE_OLD));
+    tracing = open();
+    return tracing;
+}
+
+void TraceLog::stop() {
+    if(tracing) {
+        file.close();
+        tracing = false;
+    }
+}
+
+bool TraceLog::open() {
+    file = LittleFS.open(F(TRACE_FILE), "w");
+    uint32_t magic = TRACE_MAGIC;
+    return file && file.write((const uint8_t*)&magic, sizeof(magic)) == sizeof(magic);
+}
+
+Print* TraceLog::reserve(size_t len) {
+    if(!tracing) {
+        return NULL;
+    }
+    if(file.size() + len > TRACE_FILE_MAX && file.size() > sizeof(uint32_t)) {
+        file.close();
+        LittleFS.remove(F(TRACE_FILE_OLD));
+        LittleFS.rename(TRACE_FILE, TRACE_FILE_OLD);
+        if(!open()) {
+            Serial.println(F("Trace file error"));
+            tracing = false;
+            return NULL;
+        }
+    }
+    return &file;
+}
+
+void TraceLog::copyTo(Print& out) {
+    if(tracing) {
+        file.flush();
+    }
+    uint8_t buf[256];
+    bool skip_magic = false;
+    const char* const paths[] = { TRACE_FILE_OLD, TRACE_FILE };
+    for(const char* path : paths) {
+        File f = LittleFS.open(path, "r");
+        if(!f) {
+            continue;
+        }
+        if(skip_magic) {
+            f.seek(sizeof(uint32_t));
+        }
+        skip_magic = true;
+        size_t n;
+        while((n = f.read(buf, sizeof(buf))) > 0) {
+            out.write(buf, n);
+            yield();
+        }
+        f.close();
+    }
+}
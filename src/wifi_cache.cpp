@@ -0,0 +1,114 @@
+/*
+MIT License
+
+Copyright (c) 2022 Dolen Le
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "wifi_cache.h"
+
+#include <ESP8266WiFi.h>
+#include <LittleFS.h>
+#include <inttypes.h>
+
+#define WIFI_CACHE_MAGIC        0x31495157 // "WQI1"
+
+typedef struct {
+    uint32_t magic;
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t reserved;
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t mask;
+    uint32_t dns;
+} WifiCache;
+
+static WifiCache saved;
+static bool quick = false;      // Trying the saved settings
+
+static bool wifiCacheLoad(WifiCache& cache) {
+    File f = LittleFS.open(F(WIFI_CACHE_FILE), "r");
+    if(!f) {
+        return false;
+    }
+    bool ok = f.read((uint8_t*)&cache, sizeof(cache)) == sizeof(cache) && cache.magic == WIFI_CACHE_MAGIC;
+    f.close();
+    return ok;
+}
+
+// Save the current connection, if it differs from what was loaded
+static void wifiCacheStore() {
+    WifiCache cache;
+    memset(&cache, 0, sizeof(cache));
+    cache.magic = WIFI_CACHE_MAGIC;
+    const uint8_t* bssid = WiFi.BSSID();
+    if(bssid) {
+        memcpy(cache.bssid, bssid, sizeof(cache.bssid));
+    }
+    cache.channel = WiFi.channel();
+    cache.ip = WiFi.localIP();
+    cache.gateway = WiFi.gatewayIP();
+    cache.mask = WiFi.subnetMask();
+    cache.dns = WiFi.dnsIP();
+    if(!memcmp(&cache, &saved, sizeof(cache))) {
+        return;
+    }
+    File f = LittleFS.open(F(WIFI_CACHE_FILE), "w");
+    if(!f) {
+        return;
+    }
+    f.write((const uint8_t*)&cache, sizeof(cache));
+    f.close();
+    saved = cache;
+}
+
+void wifiBegin(const char* ssid, const char* pass) {
+    WiFi.persistent(false);     // The SDK would write its config to flash on every begin()
+    WiFi.mode(WIFI_STA);
+    quick = wifiCacheLoad(saved);
+    if(quick) {
+        WiFi.config(IPAddress(saved.ip), IPAddress(saved.gateway), IPAddress(saved.mask), IPAddress(saved.dns));
+        WiFi.begin(ssid, pass, saved.channel, saved.bssid);
+    } else {
+        memset(&saved, 0, sizeof(saved));
+        WiFi.begin(ssid, pass);
+    }
+}
+
+void wifiWait(const char* ssid, const char* pass) {
+    unsigned long start = millis();
+    unsigned long dot = start;
+    while(WiFi.status() != WL_CONNECTED) {
+        delay(WIFI_WAIT_POLL_MS);
+        if(quick && millis() - start >= WIFI_QUICK_TIMEOUT_MS) {
+            Serial.println(F("Quick connect failed, scanning"));
+            quick = false;
+            WiFi.disconnect();
+            WiFi.config(IPAddress(0u), IPAddress(0u), IPAddress(0u));     // Back to DHCP
+            WiFi.begin(ssid, pass);
+        }
+        if(millis() - dot >= 1000) {
+            dot = millis();
+            Serial.print('.');
+        }
+    }
+    wifiCacheStore();
+}